@@ -0,0 +1,27 @@
+/*
+  CaptiveDns - UDP port 53 on the provisioning AP, answering every name with the portal.
+
+  Phones probe a known URL right after joining a WiFi network; with every lookup pointing at
+  the portal, that probe reaches our HTTP server (which redirects it to "/") and the phone pops
+  up the setup page on its own instead of the user having to find 192.168.4.1. The reply itself
+  is built by dnsAnswerA() (lib/BeeperCore/DnsAnswer.h).
+
+  The receive loop runs in its own task and blocks in recvfrom(), so it costs nothing between
+  queries.
+*/
+#pragma once
+
+#include <Arduino.h>
+
+class CaptiveDns {
+public:
+  // `ipv4` in address order, e.g. {192, 168, 4, 1}
+  bool begin(const uint8_t ipv4[4], UBaseType_t priority, BaseType_t core);
+
+private:
+  static void taskEntry(void* self);
+  void run();
+
+  uint8_t ip_[4] = {};
+  int sock_ = -1;
+};
@@ -0,0 +1,99 @@
+/*
+  EspNowRelay - one beeper (the gateway) keeps the Adafruit IO session and forwards triggers to
+  the others (leaves) over ESP-NOW, so leaves never associate with the AP or run TLS.
+
+  Every frame carries a truncated HMAC-SHA256 keyed from the provisioned AIO key and feed key,
+  so only units provisioned for the same feed accept each other's frames. Triggers are addressed
+  to one leaf's MAC or broadcast. Because leaves sleep between short listen windows, the gateway
+  repeats each trigger every repeatIntervalMs for repeatCount sends. The gateway also broadcasts
+  a beacon so leaves can find its channel, which is whatever channel the AP is on.
+
+  Freshness: the signed frame names its gateway (source) and carries (session, seq), where the
+  session is a boot counter the gateway keeps in NVS and seq counts triggers within the boot.
+  Leaves accept a trigger only if session:seq is above the mark they hold for that gateway in a
+  ReplayWindow, so repeats and frames recorded earlier (even before either side rebooted) are
+  both dropped, and a new session only counts if it is higher than the last.
+*/
+#pragma once
+
+#include <Arduino.h>
+#include "esp_timer.h"
+#include "FrameAuth.h"
+#include "ReplayWindow.h"
+
+class EspNowRelay {
+public:
+  // Called from the WiFi task for every authentic trigger addressed to this node
+  typedef void (*TriggerFn)(uint32_t triggerId, uint8_t melody, int64_t rxUs);
+  // Called from the WiFi task after an accepted trigger has moved the replay marks; too early
+  // for flash writes, so note it and save from a task.
+  typedef void (*WindowFn)(const ReplayWindow& window);
+
+  static const uint32_t BEACON_INTERVAL_MS = 2000;
+
+  // Derives the frame key from the provisioned secrets; call before begin().
+  void setKey(const char* aioKey, const char* feedKey);
+  void setRepeat(uint32_t intervalMs, uint8_t count) { repeatIntervalMs_ = intervalMs; repeatCount_ = count; }
+  // Gateway: this boot's session, higher than every earlier boot's (0 = none). Leaf: the replay
+  // marks, owned by the caller so they outlive a restart. begin() refuses to start without its one.
+  void setSession(uint32_t bootCount) { session_ = bootCount; }
+  void setReplayWindow(ReplayWindow* window, WindowFn onChanged) { window_ = window; onWindowChanged_ = onChanged; }
+
+  // WiFi must already be in STA mode. The gateway starts beaconing on its current channel.
+  bool begin(bool gateway, TriggerFn onTrigger);
+
+  // Gateway: relay a trigger to `target` (6-byte MAC) or to every leaf if target is nullptr.
+  // `melody` is passed through to the leaf. A newer trigger replaces one that is still repeating.
+  void relayTrigger(const uint8_t* target, uint32_t triggerId, uint8_t melody);
+
+  // Leaf: hop channels 1..13 until a gateway beacon is heard; stays on that channel.
+  bool findGateway(uint32_t dwellMs);
+  uint8_t channel() const { return channel_; }
+  int64_t lastHeardUs() const { return lastHeardUs_; }
+
+  // Called from the ESP-NOW receive callback
+  void onReceive(const uint8_t* data, int len);
+
+private:
+  struct __attribute__((packed)) Frame {
+    uint8_t magic;
+    uint8_t type;
+    uint8_t channel;     // gateway's channel, in beacons
+    uint8_t melody;      // index into the firmware's melody table, in triggers
+    uint8_t target[6];   // all 0xFF = broadcast
+    uint8_t source[6];   // the gateway's MAC
+    uint32_t session;    // gateway boot counter
+    uint32_t seq;
+    uint32_t triggerId;
+    uint8_t mac[8];
+  };
+
+  void sign(Frame& f) const;
+  bool authentic(const Frame& f) const;
+  void send(const Frame& f);
+
+  static void repeatCb(void* self);
+  static void beaconCb(void* self);
+
+  FrameAuth auth_;
+  bool gateway_ = false;
+  TriggerFn onTrigger_ = nullptr;
+  uint8_t ownMac_[6] = {};
+
+  // gateway
+  uint32_t session_ = 0;
+  uint32_t seq_ = 0;
+  Frame pending_ = {};
+  uint8_t repeatsLeft_ = 0;
+  uint32_t repeatIntervalMs_ = 50;
+  uint8_t repeatCount_ = 24;
+  esp_timer_handle_t repeatTimer_ = nullptr;
+  esp_timer_handle_t beaconTimer_ = nullptr;
+  portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+
+  // leaf
+  volatile uint8_t channel_ = 0;
+  volatile int64_t lastHeardUs_ = 0;
+  ReplayWindow* window_ = nullptr;
+  WindowFn onWindowChanged_ = nullptr;
+};
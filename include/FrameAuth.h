@@ -0,0 +1,26 @@
+/*
+  FrameAuth - the key and truncated HMAC-SHA256 tags that authenticate LAN datagrams
+  (LanTrigger.h) and ESP-NOW frames (EspNowRelay.h).
+
+  The key is SHA-256(label || AIO key || ":" || feed key), with a label per transport, so a tag
+  made for one is worthless on the other. An empty AIO key leaves no key at all: the rest of
+  the secret is not secret (share links carry the feed key), and anyone could make tags.
+*/
+#pragma once
+
+#include <Arduino.h>
+
+class FrameAuth {
+public:
+  void setKey(const char* label, const char* aioKey, const char* feedKey);
+  bool haveKey() const { return haveKey_; }
+
+  // First tagLen (at most 32) bytes of HMAC-SHA256 over data[0, len)
+  bool sign(const void* data, size_t len, uint8_t* tag, size_t tagLen) const;
+  // Whether tag is data's; compared in constant time, so it can't be guessed byte by byte
+  bool verify(const void* data, size_t len, const uint8_t* tag, size_t tagLen) const;
+
+private:
+  uint8_t key_[32] = {};
+  bool haveKey_ = false;
+};
@@ -0,0 +1,62 @@
+/*
+  LanTrigger - authenticated UDP trigger endpoint for senders on the same network.
+
+  A ping through Adafruit IO crosses the internet twice and a TLS record each way. A sender on
+  the LAN can instead send one UDP datagram straight to the beeper (found via mDNS as
+  "_beeper._udp"):
+
+      true seq=<n> id=<n> src=<name> mac=<hex>
+
+  mac is the first 16 bytes of HMAC-SHA256 over everything before " mac=", keyed with
+  SHA-256("beeper-lan:" + ADA_KEY + ":" + FEED_KEY), so anyone who can ping the feed can ping
+  the LAN port and nobody else can. seq must increase with every datagram from the same src (the
+  sender's clock in milliseconds is best, see ReplayWindow.h), and replays are dropped. The
+  marks are kept per src in a window the caller persists, so a datagram captured before a
+  reboot stays stale. The beeper answers "ack id=<n> rxb=<us>" once the pattern has started.
+  Field parsing is in lib/BeeperCore/LanDatagram.h.
+
+  The receive loop runs in its own task and hands accepted triggers to a callback; this class
+  does no beeping itself.
+*/
+#pragma once
+
+#include <Arduino.h>
+#include "FrameAuth.h"
+#include "LanDatagram.h"
+#include "ReplayWindow.h"
+
+class LanTrigger {
+public:
+  // Called from the LAN task for every authenticated trigger
+  typedef void (*TriggerFn)(uint32_t triggerId, int64_t rxUs);
+
+  // Called from the LAN task after each accepted trigger, with the replay marks it moved. Runs
+  // after the trigger is dispatched and should return quickly (defer any flash write).
+  typedef void (*WindowFn)(const ReplayWindow& window);
+
+  // Derives the key from the provisioned secrets; call before begin().
+  void setKey(const char* aioKey, const char* feedKey);
+  // The replay marks, owned by the caller so it can keep them across restarts; call before
+  // begin(), which refuses to start without them.
+  void setReplayWindow(ReplayWindow* window, WindowFn onChanged) { window_ = window; onWindowChanged_ = onChanged; }
+  bool begin(uint16_t port, TriggerFn onTrigger, UBaseType_t priority, BaseType_t core);
+
+  // Replies to whoever sent the most recent accepted trigger
+  void sendAck(uint32_t triggerId, uint32_t rxToBeepUs);
+
+private:
+  // True if the datagram is well formed and authentic (freshness is the window's business)
+  bool verify(const char* msg, size_t len, LanDatagram& out) const;
+  static void taskEntry(void* self);
+  void run();
+
+  FrameAuth auth_;
+  int sock_ = -1;
+  TriggerFn onTrigger_ = nullptr;
+
+  ReplayWindow* window_ = nullptr;
+  WindowFn onWindowChanged_ = nullptr;
+  uint32_t replyAddr_ = 0;   // network byte order
+  uint16_t replyPort_ = 0;   // network byte order
+  portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+};
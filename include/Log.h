@@ -0,0 +1,65 @@
+/*
+  Log - leveled logging that never waits on the UART.
+
+  LOGE/LOGW/LOGI/LOGD format into a fixed slot of a lock-free ring (a bounded MPMC queue in the
+  style of D. Vyukov's, used here with any number of producers and one consumer) and return;
+  a low-priority task drains the ring to Serial. When the ring is full the line is dropped and
+  counted rather than blocking the caller. Levels above BEEPER_LOG_LEVEL compile to nothing,
+  arguments included (they sit behind if (0) so formats are still checked and nothing that only
+  feeds a log line warns as unused).
+
+  WARN and ERROR lines are also kept in a small "recent" buffer that the network task can
+  publish to the log feed (logTakeRecent()).
+
+  Not for use from ISRs.
+*/
+#pragma once
+
+#include <Arduino.h>
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef BEEPER_LOG_LEVEL
+#define BEEPER_LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+void logWrite(uint8_t level, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+#if BEEPER_LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOGE(...) logWrite(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOGE(...) do { if (0) logWrite(0, __VA_ARGS__); } while (0)
+#endif
+#if BEEPER_LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOGW(...) logWrite(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOGW(...) do { if (0) logWrite(0, __VA_ARGS__); } while (0)
+#endif
+#if BEEPER_LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOGI(...) logWrite(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOGI(...) do { if (0) logWrite(0, __VA_ARGS__); } while (0)
+#endif
+#if BEEPER_LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOGD(...) logWrite(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOGD(...) do { if (0) logWrite(0, __VA_ARGS__); } while (0)
+#endif
+
+// Starts the UART drain task. Lines logged earlier wait in the ring.
+void logBegin(UBaseType_t priority, BaseType_t core);
+
+// Waits (up to half a second) for the drain task to write out what is queued, then flushes the
+// UART. Call from a task before a restart or deep sleep, never from a timer callback or ISR.
+void logFlush();
+
+// Copies the WARN/ERROR lines collected since the last call into buf (newline separated) and
+// clears them. Returns the length, 0 if there was nothing new.
+size_t logTakeRecent(char* buf, size_t len);
+
+// Lines dropped because the ring was full
+uint32_t logDropped();
@@ -0,0 +1,62 @@
+/*
+  OtaUpdater - pulls a zlib-compressed firmware image over HTTPS and flashes it into the
+  inactive app partition, all from its own task so the MQTT session keeps running.
+
+  The image is requested as one streaming GET. The compressed bytes go straight through a
+  streaming inflate (the ROM's miniz, with a 32 KB window) into esp_ota_write(), so no full copy
+  is ever held. If the connection drops, the download resumes with "Range: bytes=<received>-" and
+  the inflater carries on where it stopped. This survives lost connections, but not a reboot.
+
+  The request carries an ECDSA P-256 signature over "version=<n> size=<n> sha256=<hex>", checked
+  against the public key compiled in from include/ota_signing_key.h before anything is
+  downloaded; an unsigned or badly signed request is refused. The feed key is no secret (share
+  links carry it), so the signature is what says the image is ours. The URL is left out of the
+  signed text so the image can be hosted anywhere.
+
+  A signed request stays valid forever, so it is also refused unless its version is above
+  BEEPER_FIRMWARE_VERSION (include/firmware_version.h), and when its SHA-256 matches the running
+  partition's: replaying an old line can neither downgrade a unit nor keep re-flashing the image
+  it already runs.
+
+  The decompressed image must match the signed size and SHA-256; esp_ota_end() then checks the
+  image itself. Only after both pass is the boot partition switched, which is a single otadata
+  write, so a power cut at any point leaves the old firmware bootable.
+
+  Make the compressed image with scripts/pack_ota.py, which also signs and prints the request to
+  send (generate the key pair once with --keygen).
+*/
+#pragma once
+
+#include <Arduino.h>
+
+#include "OtaRequest.h"
+
+class OtaUpdater {
+public:
+  typedef OtaRequest Request;  // parsed by otaRequestParse()
+
+  // Called from the OTA task when it ends. On success the new image is set to boot next;
+  // the caller picks the moment to restart.
+  typedef void (*DoneFn)(bool ok);
+  // Held for the duration of the update (e.g. a PM lock for full CPU clock during TLS)
+  typedef void (*HoldFn)(bool hold);
+
+  // Starts the update task. False if one is already running or there is not enough heap. The
+  // task checks the signature and version first; a refused request ends in onDone(false).
+  bool start(const Request& req, DoneFn onDone, HoldFn hold, UBaseType_t priority, BaseType_t core);
+  bool busy() const { return busy_; }
+
+  // Call once the running image has proven itself (connected to the broker); cancels the
+  // bootloader's rollback if it is enabled.
+  static void confirmRunningImage();
+
+private:
+  static bool signatureValid(const Request& req);
+  static void taskEntry(void* self);
+  bool run();
+
+  Request req_ = {};
+  DoneFn onDone_ = nullptr;
+  HoldFn hold_ = nullptr;
+  volatile bool busy_ = false;
+};
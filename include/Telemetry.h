@@ -0,0 +1,74 @@
+/*
+  Telemetry - fixed-size latency and health counters for the beeper.
+
+  Each metric keeps the last TELEMETRY_WINDOW samples in a ring buffer; percentiles are computed
+  on demand from a scratch copy, so recording is O(1) and nothing is allocated after boot.
+  formatSummary() renders a compact JSON line that the network task publishes to the
+  diagnostics feed (lib/BeeperCore/TelemetrySummary.h: whole JSON or nothing, whatever the
+  values).
+
+  record() and count() may be called from any task or WiFi event callback.
+*/
+#pragma once
+
+#include <Arduino.h>
+
+enum TelemetryMetric : uint8_t {
+  TM_WIFI_ASSOC_MS,     // WiFi.begin() -> associated
+  TM_DHCP_MS,           // associated -> got IP
+  TM_TLS_HANDSHAKE_MS,
+  TM_MQTT_CONNECT_MS,   // MQTT CONNECT/CONNACK after the handshake
+  TM_MQTT_SUBSCRIBE_MS, // SUBSCRIBE written -> its SUBACK next in line to be read
+  TM_RX_TO_BEEP_US,     // message in mqttCallback -> buzzer on
+  TM_CLEAR_RTT_MS,      // clear publish -> its echo back from the broker. Only acks that clear
+                        // the trigger feed come back, so with ACK_SEPARATE_FEED (and no duty
+                        // cycling) it never has samples and "rtt" is absent from the summary.
+  TM_BOOT_TO_READY_MS,
+  TM_METRIC_COUNT
+};
+
+enum TelemetryCounter : uint8_t {
+  TC_WIFI_RECONNECTS,
+  TC_MQTT_RECONNECTS,
+  TC_TRIGGERS,
+  TC_DUPLICATES,        // repeats dropped by TriggerDedupe
+  TC_COUNTER_COUNT
+};
+
+const uint8_t TELEMETRY_WINDOW = 32;
+
+struct TelemetryPercentiles {
+  uint32_t p50;
+  uint32_t p90;
+  uint32_t p99;
+  uint32_t max;
+  uint8_t n;
+};
+
+class Telemetry {
+public:
+  void record(TelemetryMetric m, uint32_t value);
+  void count(TelemetryCounter c, uint32_t n = 1);
+
+  TelemetryPercentiles percentiles(TelemetryMetric m);
+  uint32_t counter(TelemetryCounter c) const { return counters_[c]; }
+
+  // Compact JSON summary with the metrics that fit; returns the length written, 0 if not even
+  // the fixed fields fit. Network task only.
+  size_t formatSummary(char* buf, size_t len);
+
+  static const char* metricName(TelemetryMetric m);
+
+private:
+  struct Ring {
+    uint32_t samples[TELEMETRY_WINDOW];
+    uint8_t next;
+    uint8_t count;
+  };
+
+  Ring rings_[TM_METRIC_COUNT] = {};
+  volatile uint32_t counters_[TC_COUNTER_COUNT] = {};
+  portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+};
+
+extern Telemetry telemetry;
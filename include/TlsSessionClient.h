@@ -0,0 +1,101 @@
+/*
+  TlsSessionClient - a small mbedTLS Client for PubSubClient that keeps the TLS session
+  between connections.
+
+  WiFiClientSecure runs a full handshake on every connect() and offers no hook to offer a
+  previous session. This client caches the negotiated session (session ID or ticket) after
+  each handshake and presents it on the next connect(), so a reconnect does the abbreviated
+  handshake instead of a full certificate exchange and key agreement. The session can also
+  be serialized into RTC memory so it survives deep sleep.
+
+  Trust is pinned to the DER roots passed to setTrustAnchors(); there is no insecure mode.
+*/
+#pragma once
+
+#include <Arduino.h>
+#include <Client.h>
+#include "mbedtls/ssl.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/x509_crt.h"
+
+class TlsSessionClient : public Client {
+public:
+  TlsSessionClient();
+  ~TlsSessionClient();
+
+  // DER-encoded root certificates. The arrays must stay valid; they are parsed on first connect.
+  void setTrustAnchors(const uint8_t* const* ders, const size_t* lens, size_t count);
+  void setHandshakeTimeout(uint32_t ms) { handshakeTimeoutMs_ = ms; }
+  // Ask the server for records of at most `bytes` (512, 1024, 2048 or 4096; RFC 6066). Takes
+  // effect on the first connect; with a dynamic-buffer mbedTLS build it shrinks the record
+  // buffers, otherwise it only caps the peer's record size.
+  void setMaxFragmentLength(uint16_t bytes) { maxFragmentLen_ = bytes; }
+
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char* host, uint16_t port) override;
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buf, size_t size) override;
+  int peek() override;
+  void flush() override {}
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override { return connected(); }
+
+  // For callers that block in select(): the socket while connected (else -1), and whether
+  // decrypted bytes are already buffered, which select() on the socket would not report.
+  int socketFd() const { return connected_ ? sock_ : -1; }
+  bool hasBuffered() const;
+
+  // Result of the most recent handshake
+  uint32_t lastHandshakeMs() const { return lastHandshakeMs_; }
+  bool lastHandshakeResumed() const { return lastResumed_; }
+  int lastError() const { return lastError_; }
+
+  // Session cache persistence (e.g. into RTC_DATA_ATTR memory). saveSession() returns the
+  // number of bytes written, or 0 if there is no session or it does not fit.
+  size_t saveSession(uint8_t* buf, size_t len) const;
+  bool loadSession(const uint8_t* buf, size_t len);
+  void clearSession();
+
+private:
+  bool initContext();
+  int connectTo(const IPAddress& ip, uint16_t port);
+  int handshake();
+  int connectSocket(const IPAddress& ip, uint16_t port);
+  void closeSocket();
+
+  static int bioSend(void* ctx, const unsigned char* buf, size_t len);
+  static int bioRecv(void* ctx, unsigned char* buf, size_t len);
+
+  // Certificates
+  const uint8_t* const* caDers_ = nullptr;
+  const size_t* caLens_ = nullptr;
+  size_t caCount_ = 0;
+
+  // mbedTLS state; set up once and reset between connections so the record buffers
+  // are allocated a single time.
+  bool ctxReady_ = false;
+  mbedtls_ssl_context ssl_;
+  mbedtls_ssl_config conf_;
+  mbedtls_x509_crt ca_;
+  mbedtls_entropy_context entropy_;
+  mbedtls_ctr_drbg_context drbg_;
+
+  mbedtls_ssl_session session_;
+  bool haveSession_ = false;
+
+  int sock_ = -1;
+  bool connected_ = false;
+  int peeked_ = -1;
+  char host_[64] = "";
+
+  uint32_t handshakeTimeoutMs_ = 10000;
+  uint16_t maxFragmentLen_ = 0;
+  uint32_t lastHandshakeMs_ = 0;
+  bool lastResumed_ = false;
+  int lastError_ = 0;
+};
@@ -0,0 +1,80 @@
+// Generated by scripts/embed_config_page.py from web/config_page.html -- do not edit.
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// 2205 bytes of HTML, 1112 gzipped
+const uint8_t CONFIG_PAGE_GZ[] = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x7d, 0x56, 0x5f, 0x6f, 0xdb, 0x36,
+  0x10, 0x7f, 0xf7, 0xa7, 0xb8, 0x30, 0xd8, 0x20, 0xa3, 0x8e, 0xe4, 0x36, 0x58, 0x3b, 0xd8, 0xb2,
+  0x8b, 0xb4, 0x49, 0x81, 0x60, 0xc3, 0x12, 0xd4, 0x19, 0x8a, 0x3d, 0x0d, 0xb4, 0x74, 0xb2, 0x38,
+  0x53, 0xa4, 0x46, 0x52, 0x71, 0xbc, 0xc0, 0x6f, 0xfb, 0x24, 0xfb, 0x68, 0xfb, 0x24, 0x3b, 0x92,
+  0x72, 0xe2, 0xac, 0x49, 0x1f, 0x62, 0x51, 0xc7, 0xbb, 0xdf, 0xdd, 0xfd, 0xee, 0x8f, 0x92, 0x1f,
+  0x9d, 0x5f, 0x7d, 0xbc, 0xf9, 0xed, 0xfa, 0x02, 0x6a, 0xd7, 0xc8, 0xf9, 0x20, 0xdf, 0x3f, 0x90,
+  0x97, 0xf4, 0x68, 0xd0, 0x71, 0x50, 0xbc, 0xc1, 0x19, 0xbb, 0x15, 0xb8, 0x69, 0xb5, 0x71, 0x0c,
+  0x0a, 0xad, 0x1c, 0x2a, 0x37, 0x63, 0x1b, 0x51, 0xba, 0x7a, 0x56, 0xe2, 0xad, 0x28, 0xf0, 0x24,
+  0xbc, 0x8c, 0x40, 0x28, 0xe1, 0x04, 0x97, 0x27, 0xb6, 0xe0, 0x12, 0x67, 0xaf, 0x19, 0x81, 0x38,
+  0xe1, 0x24, 0xce, 0x3f, 0x20, 0xb6, 0x68, 0x60, 0x81, 0xae, 0x6b, 0xf3, 0x2c, 0xca, 0x06, 0xb9,
+  0x75, 0x5b, 0x7a, 0xc2, 0x52, 0x97, 0xdb, 0xfb, 0x8a, 0x70, 0x4f, 0x2a, 0xde, 0x08, 0xb9, 0x9d,
+  0x9c, 0x19, 0x02, 0x99, 0xb6, 0xbc, 0x2c, 0x85, 0x5a, 0x4d, 0x5e, 0x8f, 0xdb, 0xbb, 0x1d, 0x41,
+  0xb7, 0x9d, 0xbb, 0x0f, 0x7e, 0x48, 0x32, 0xfe, 0xee, 0xe1, 0xfa, 0xc7, 0xf6, 0x6e, 0xda, 0x70,
+  0xb3, 0x12, 0x6a, 0xf2, 0xb6, 0xbd, 0x83, 0xf1, 0x0e, 0x96, 0x9d, 0x73, 0x5a, 0xdd, 0x1f, 0xda,
+  0x4f, 0x0f, 0x0c, 0x97, 0xbc, 0x58, 0xaf, 0x8c, 0xee, 0x54, 0x39, 0x39, 0x1e, 0x8f, 0xdf, 0x2d,
+  0xab, 0x6a, 0x5a, 0x68, 0xa9, 0xcd, 0xe4, 0xb8, 0xa2, 0xe3, 0x52, 0x9b, 0x12, 0xcd, 0x44, 0x69,
+  0x85, 0x3b, 0xc8, 0xb3, 0x18, 0xe2, 0x20, 0xcf, 0x7a, 0x4e, 0x7c, 0xac, 0x9e, 0xa1, 0xd3, 0x39,
+  0xfb, 0x45, 0x3b, 0x38, 0x83, 0x45, 0xa3, 0xd7, 0x08, 0xe7, 0xe8, 0xb0, 0x70, 0xda, 0xfc, 0xfb,
+  0xf7, 0x3f, 0x0c, 0xce, 0x4a, 0x5e, 0x99, 0x4e, 0x38, 0xb8, 0xbc, 0xda, 0x67, 0x4c, 0xfa, 0x83,
+  0xbc, 0xd2, 0xa6, 0x01, 0x5e, 0x38, 0xa1, 0xd5, 0x8c, 0x65, 0x96, 0xdf, 0x22, 0x03, 0xe2, 0xb8,
+  0xd6, 0xe5, 0x8c, 0x5d, 0x5f, 0x2d, 0x6e, 0x3c, 0x5d, 0x92, 0x2f, 0x51, 0xce, 0xbf, 0x88, 0x4f,
+  0x02, 0x16, 0x8b, 0xcb, 0xf3, 0x3c, 0x8b, 0x82, 0x3c, 0xa4, 0xdf, 0x17, 0xc3, 0x5a, 0x51, 0x32,
+  0x90, 0xc2, 0x52, 0x15, 0x14, 0x3a, 0xcb, 0x80, 0x77, 0x4e, 0x17, 0xba, 0x69, 0x25, 0x85, 0x31,
+  0x63, 0xba, 0xaa, 0x7a, 0x11, 0x6f, 0x85, 0xe3, 0x52, 0xfc, 0x45, 0x42, 0x9f, 0x10, 0x03, 0x83,
+  0x7f, 0x76, 0xc2, 0xa0, 0xcf, 0xa4, 0xe4, 0xfe, 0xca, 0x3a, 0x10, 0x65, 0x0f, 0x33, 0xcf, 0xb3,
+  0xbd, 0xd0, 0x17, 0xa7, 0xe1, 0x52, 0x86, 0x4b, 0xaa, 0xa6, 0x62, 0xf3, 0x9f, 0xb5, 0x5e, 0x13,
+  0x9d, 0x40, 0x59, 0x00, 0xa9, 0x6f, 0xb4, 0x59, 0xdb, 0x34, 0x4d, 0x21, 0xe7, 0x50, 0x1b, 0xac,
+  0x66, 0xec, 0x98, 0x05, 0x6d, 0x83, 0x51, 0xdf, 0xff, 0x02, 0x5f, 0x71, 0xa1, 0xf2, 0x8c, 0x13,
+  0x74, 0xc0, 0x7b, 0x9a, 0xe1, 0x35, 0xb7, 0x96, 0x70, 0xca, 0x67, 0xb3, 0x6c, 0xe9, 0xd2, 0x33,
+  0x52, 0x9b, 0x07, 0xa3, 0x43, 0x62, 0x7f, 0xb5, 0x68, 0xbc, 0xe2, 0xb3, 0xb6, 0xbc, 0xe4, 0xbf,
+  0x77, 0xa4, 0xc0, 0xe0, 0x96, 0xcb, 0x8e, 0x04, 0x4f, 0x32, 0xff, 0x1a, 0xec, 0x8c, 0xfe, 0x7e,
+  0xc2, 0xed, 0x8b, 0x58, 0x6b, 0xdc, 0x7e, 0x0b, 0xea, 0x13, 0x62, 0xe9, 0xed, 0x21, 0xc1, 0x74,
+  0x95, 0xc2, 0x32, 0x34, 0xfb, 0xf0, 0x59, 0xb4, 0x8a, 0x54, 0x9f, 0xc0, 0x45, 0xe5, 0x27, 0xa0,
+  0xb1, 0x7f, 0xc1, 0x6d, 0x5b, 0x5f, 0xec, 0x6e, 0xd9, 0x08, 0xc7, 0xe6, 0x0b, 0x6a, 0x17, 0xf8,
+  0x1e, 0x3e, 0xe3, 0x52, 0x6b, 0x97, 0x67, 0x51, 0xc7, 0x37, 0xa6, 0xef, 0x2a, 0x7a, 0xb6, 0xf3,
+  0x33, 0xb0, 0x54, 0x1f, 0x89, 0xc1, 0x3f, 0x35, 0x16, 0x57, 0x16, 0xb6, 0xba, 0x83, 0xda, 0x5b,
+  0xba, 0xce, 0x28, 0x0a, 0xd2, 0xc3, 0xd6, 0x08, 0x71, 0x6a, 0x81, 0xab, 0x12, 0x88, 0x80, 0x9a,
+  0x5b, 0x3f, 0xd6, 0x8a, 0x3a, 0x98, 0x54, 0x9c, 0x0e, 0x2a, 0x7d, 0x89, 0x8f, 0xf2, 0xac, 0x0d,
+  0xe8, 0x37, 0x9a, 0x42, 0xb4, 0xe8, 0x42, 0xfd, 0x69, 0x2d, 0xe0, 0x06, 0x42, 0x0d, 0x7b, 0xbd,
+  0x11, 0xb4, 0x74, 0x6d, 0x83, 0xe9, 0xe7, 0x8b, 0xc5, 0xc5, 0x4d, 0x3f, 0x85, 0xe9, 0xde, 0xfe,
+  0x4d, 0x08, 0xcb, 0xfe, 0x3f, 0xae, 0x42, 0x8a, 0x62, 0xed, 0xbd, 0x92, 0x5d, 0xc4, 0x8f, 0x76,
+  0x0f, 0x7e, 0x4f, 0x9f, 0xb7, 0xa3, 0x15, 0x84, 0xc4, 0x16, 0x58, 0x3f, 0x5f, 0xd0, 0xe8, 0x12,
+  0x47, 0xb0, 0xa9, 0x45, 0x51, 0x83, 0xf0, 0x41, 0xd0, 0x0f, 0xf5, 0xfb, 0x03, 0xc8, 0x97, 0x1a,
+  0x55, 0xb0, 0xf5, 0x43, 0x37, 0x0a, 0xce, 0x22, 0xef, 0xe0, 0x8c, 0xc0, 0x18, 0xf5, 0x61, 0x36,
+  0x50, 0x09, 0x43, 0x93, 0xe1, 0xf9, 0x71, 0x28, 0x65, 0xef, 0x97, 0x1c, 0x82, 0xa8, 0x22, 0x3b,
+  0x54, 0x4c, 0x20, 0x22, 0xda, 0xbe, 0x83, 0xbd, 0xd7, 0x8d, 0xd1, 0x6a, 0xd5, 0xe7, 0x6b, 0x0b,
+  0x23, 0x5a, 0x9a, 0x22, 0xa2, 0x95, 0x70, 0xfc, 0x74, 0xc1, 0x0c, 0x4a, 0x5d, 0x74, 0x0d, 0x05,
+  0x9e, 0xae, 0xd0, 0x5d, 0x48, 0xf4, 0xc7, 0x0f, 0xdb, 0xcb, 0x32, 0x89, 0xd3, 0x37, 0x1c, 0x41,
+  0x18, 0x99, 0x6f, 0xe8, 0x85, 0xc1, 0x1a, 0x4e, 0x07, 0x55, 0xa7, 0xc2, 0x16, 0x81, 0x25, 0x37,
+  0x36, 0x31, 0xb4, 0x0f, 0x86, 0x70, 0x4f, 0xf4, 0xf9, 0x22, 0x83, 0x7f, 0x85, 0x39, 0x9c, 0xbc,
+  0x1d, 0xc3, 0x7b, 0x60, 0xd6, 0xf9, 0xa8, 0x18, 0x4c, 0x1e, 0xe4, 0xef, 0x7e, 0xf0, 0x72, 0xbd,
+  0xf6, 0x32, 0xb6, 0x41, 0xbe, 0x66, 0x53, 0xd8, 0x3d, 0x42, 0x4a, 0xcd, 0xcb, 0x84, 0xe6, 0x99,
+  0x8a, 0x51, 0x13, 0xea, 0x00, 0xa0, 0x42, 0x57, 0xd4, 0x7b, 0x91, 0xb7, 0xcd, 0x7c, 0x1c, 0xef,
+  0x7b, 0x01, 0x6d, 0x79, 0x0f, 0x94, 0xc5, 0xd8, 0x52, 0x22, 0x47, 0x25, 0x06, 0x66, 0x73, 0x30,
+  0xe9, 0x1f, 0x56, 0xab, 0x64, 0xd8, 0xcb, 0xc2, 0xaa, 0x21, 0xb1, 0x47, 0x84, 0xc0, 0x48, 0x6a,
+  0xb0, 0x95, 0xbc, 0xc0, 0x8f, 0xb5, 0x90, 0xa5, 0x21, 0x15, 0xda, 0x26, 0x5e, 0x2b, 0x6d, 0x78,
+  0x9b, 0xa8, 0x47, 0x5d, 0x80, 0xc8, 0xa2, 0x3e, 0xa4, 0xa6, 0x30, 0xc8, 0x1d, 0xf6, 0xec, 0x24,
+  0x4c, 0xb7, 0x3e, 0x78, 0xcf, 0x4d, 0xb4, 0xd0, 0x69, 0x18, 0x2f, 0xb2, 0x50, 0xa9, 0x5f, 0x97,
+  0x8f, 0xf2, 0x30, 0x93, 0x24, 0x0f, 0xd4, 0xa9, 0x34, 0x92, 0xf7, 0x0a, 0xe8, 0xa8, 0x5b, 0x6a,
+  0x12, 0x4a, 0x6f, 0x04, 0xfe, 0x14, 0xb2, 0x7a, 0x04, 0xec, 0xc9, 0xd5, 0xf1, 0x7d, 0x37, 0xec,
+  0x2f, 0x7c, 0xd6, 0x69, 0x68, 0x96, 0x90, 0x45, 0xea, 0xf0, 0xce, 0x7d, 0x8c, 0x5f, 0x48, 0xf2,
+  0x11, 0xb2, 0x91, 0xa8, 0x56, 0xce, 0xf3, 0x76, 0xf8, 0xf6, 0x0a, 0xd8, 0xc3, 0x12, 0xa5, 0x89,
+  0xa2, 0x6f, 0x51, 0x0a, 0xc1, 0xe3, 0x4b, 0x5b, 0x96, 0x45, 0x7f, 0xd4, 0x7e, 0xc9, 0xd1, 0x01,
+  0xd0, 0xd0, 0x0f, 0xc0, 0x8d, 0x68, 0x50, 0x77, 0x2e, 0xf1, 0xa5, 0x1b, 0xc1, 0x9b, 0xf1, 0x78,
+  0x1c, 0xa2, 0xdb, 0x0d, 0xd3, 0x82, 0xfb, 0xd2, 0x25, 0x43, 0x4f, 0xe6, 0xf3, 0x8a, 0xa4, 0xb9,
+  0x1b, 0xbc, 0xd8, 0x70, 0xfd, 0x2e, 0x1f, 0xa6, 0x5a, 0x85, 0x41, 0xa5, 0x9c, 0x30, 0x14, 0x06,
+  0x30, 0xa5, 0x79, 0xbf, 0x25, 0xc5, 0x73, 0xac, 0x78, 0x27, 0x5d, 0x32, 0x9c, 0xc6, 0xd6, 0x71,
+  0xa6, 0x43, 0x3a, 0x7f, 0xe5, 0xed, 0x34, 0x84, 0x05, 0xbb, 0xe9, 0x20, 0xa8, 0x55, 0x5c, 0x5a,
+  0xd2, 0xa3, 0xfd, 0xb5, 0x1f, 0x15, 0xda, 0x69, 0xf1, 0xdb, 0x9a, 0xc5, 0xff, 0x42, 0xfe, 0x03,
+  0x4c, 0x31, 0x5c, 0xaa, 0x9d, 0x08, 0x00, 0x00,
+};
+const size_t CONFIG_PAGE_GZ_LEN = sizeof(CONFIG_PAGE_GZ);
+#define CONFIG_PAGE_ETAG "\"4b4365fb884efcc6\""
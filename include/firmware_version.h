@@ -0,0 +1,6 @@
+// Release number of this firmware. It is signed into every OTA request (scripts/pack_ota.py
+// reads it from here), and a unit only takes an update numbered above its own, so an old
+// signed request can't be replayed to downgrade it. Bump it for every release.
+#pragma once
+
+#define BEEPER_FIRMWARE_VERSION 1
@@ -0,0 +1,11 @@
+// Generated by scripts/pack_ota.py --keygen -- do not edit.
+// Public half of the OTA signing key (DER SubjectPublicKeyInfo, ECDSA P-256). Empty means
+// no key was generated yet, and every OTA request is refused.
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+const uint8_t OTA_SIGNING_KEY[] = {
+  0x00,
+};
+const size_t OTA_SIGNING_KEY_LEN = 0;
@@ -0,0 +1,147 @@
+/*
+  BeepPatterns - every sound the beeper makes, as one compile-time table.
+
+  A pattern is a list of notes (frequency, on time, silence after) played `repeat` times, with
+  the LED optionally mirroring the buzzer. The pattern engine in main.cpp only ever reads
+  PATTERNS[id]; adding a status sound or a melody means adding an id and a table row.
+
+  Plain C++ with no Arduino dependency, so timings can be checked on the host (several are
+  pinned below with static_assert, the rest by test/test_patterns). PatternCursor is the
+  engine's note sequencing without the LEDC and timer calls, so the same code is what is tested.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct BeepStep {
+  uint16_t freqHz; // ignored for an active buzzer, which is just switched on
+  uint16_t onMs;
+  uint16_t offMs;  // silence after this step (also the gap before the next repeat/pattern)
+};
+
+enum PatternId : uint8_t {
+  PAT_PING,          // ready / someone beeped; also what a plain "true" plays
+  PAT_NEEDS_CONFIG,  // setup mode (config portal is up)
+  PAT_RESET,         // reset button pressed
+  PAT_CHIME,
+  PAT_COIN,
+  PAT_DOORBELL,
+  PAT_ALARM,
+  PAT_FANFARE,
+  PAT_COUNT
+};
+
+struct BeepPattern {
+  PatternId id;
+  const char* name;    // "melody=<name>" in a ping
+  const BeepStep* steps;
+  uint8_t stepCount;
+  uint8_t repeat;      // times the whole step list is played, >= 1
+  bool mirrorLed;      // drive LED_PIN together with the buzzer
+  bool selectable;     // may be chosen by a ping's melody=
+};
+
+constexpr uint16_t NOTE_C5 = 523;
+constexpr uint16_t NOTE_E5 = 659;
+constexpr uint16_t NOTE_G5 = 784;
+constexpr uint16_t NOTE_B5 = 988;
+constexpr uint16_t NOTE_C6 = 1047;
+constexpr uint16_t NOTE_E6 = 1319;
+constexpr uint16_t NOTE_G6 = 1568;
+constexpr uint16_t TONE_ALERT_HI = 2700; // near the resonance of the usual 12 mm passive buzzers
+constexpr uint16_t TONE_ALERT_LO = 2000;
+
+constexpr BeepStep PING_STEPS[] = { {TONE_ALERT_HI, 100, 100} };
+constexpr BeepStep NEEDS_CONFIG_STEPS[] = { {TONE_ALERT_LO, 50, 200} };
+constexpr BeepStep RESET_STEPS[] = { {NOTE_C6, 50, 250} };
+constexpr BeepStep CHIME_STEPS[] = { {NOTE_E6, 200, 40}, {NOTE_C6, 400, 100} };
+constexpr BeepStep COIN_STEPS[] = { {NOTE_B5, 80, 0}, {NOTE_E6, 400, 100} };
+constexpr BeepStep DOORBELL_STEPS[] = { {NOTE_G5, 150, 20}, {NOTE_E5, 150, 20}, {NOTE_C5, 150, 20}, {NOTE_G5, 300, 100} };
+constexpr BeepStep ALARM_STEPS[] = { {TONE_ALERT_HI, 150, 0}, {TONE_ALERT_LO, 150, 0} };
+constexpr BeepStep FANFARE_STEPS[] = { {NOTE_C6, 100, 20}, {NOTE_E6, 100, 20}, {NOTE_G6, 100, 20}, {NOTE_C6, 50, 20}, {NOTE_G6, 300, 100} };
+
+template <size_t N>
+constexpr BeepPattern makePattern(PatternId id, const char* name, const BeepStep (&steps)[N], uint8_t repeat,
+                                  bool mirrorLed, bool selectable) {
+  static_assert(N > 0 && N <= 255, "pattern needs 1..255 steps");
+  return BeepPattern{ id, name, steps, (uint8_t)N, repeat, mirrorLed, selectable };
+}
+
+constexpr BeepPattern PATTERNS[] = {
+  makePattern(PAT_PING, "ping", PING_STEPS, 1, true, true),
+  makePattern(PAT_NEEDS_CONFIG, "needs-config", NEEDS_CONFIG_STEPS, 3, false, false),
+  makePattern(PAT_RESET, "reset", RESET_STEPS, 2, false, false),
+  makePattern(PAT_CHIME, "chime", CHIME_STEPS, 1, true, true),
+  makePattern(PAT_COIN, "coin", COIN_STEPS, 1, true, true),
+  makePattern(PAT_DOORBELL, "doorbell", DOORBELL_STEPS, 1, true, true),
+  makePattern(PAT_ALARM, "alarm", ALARM_STEPS, 3, true, true),
+  makePattern(PAT_FANFARE, "fanfare", FANFARE_STEPS, 1, true, true),
+};
+
+// Total playing time including every trailing silence
+constexpr uint32_t patternDurationMs(const BeepPattern& p) {
+  uint32_t oneRepeat = 0;
+  for (uint8_t i = 0; i < p.stepCount; i++) oneRepeat += (uint32_t)p.steps[i].onMs + p.steps[i].offMs;
+  return oneRepeat * p.repeat;
+}
+
+constexpr bool patternTableValid() {
+  if (sizeof(PATTERNS) / sizeof(PATTERNS[0]) != PAT_COUNT) return false;
+  for (uint8_t i = 0; i < PAT_COUNT; i++) {
+    if (PATTERNS[i].id != i || PATTERNS[i].repeat == 0 || PATTERNS[i].stepCount == 0) return false;
+  }
+  return true;
+}
+
+static_assert(patternTableValid(), "PATTERNS must list every PatternId once, in order, with repeat >= 1");
+// The status codes people learn by ear; changing them changes the README
+static_assert(patternDurationMs(PATTERNS[PAT_PING]) == 200, "ping is one 100 ms beep");
+static_assert(patternDurationMs(PATTERNS[PAT_NEEDS_CONFIG]) == 750, "needs-config is three short beeps");
+static_assert(patternDurationMs(PATTERNS[PAT_RESET]) == 600, "reset is two short beeps");
+
+// Where playback is within one pattern. The engine applies each PatternEdge (buzzer on at freqHz
+// or off) and arms its timer for edge.ms; a step with no silence after it runs straight into
+// the next note.
+struct PatternEdge {
+  bool on;
+  uint16_t freqHz;
+  uint16_t ms;
+};
+
+struct PatternCursor {
+  const BeepPattern* pattern;
+  uint8_t step;
+  uint8_t repeat;
+  bool on;
+};
+
+inline PatternEdge patternCursorEdge(const PatternCursor& c) {
+  const BeepStep& s = c.pattern->steps[c.step];
+  return c.on ? PatternEdge{ true, s.freqHz, s.onMs } : PatternEdge{ false, 0, s.offMs };
+}
+
+// First edge of `p` (always a note)
+inline PatternEdge patternCursorBegin(PatternCursor& c, const BeepPattern* p) {
+  c = PatternCursor{ p, 0, 0, true };
+  return patternCursorEdge(c);
+}
+
+// Called when the current edge's time is up. Sets `next` and returns true, or returns false
+// once the last note (and its silence) is over.
+inline bool patternCursorAdvance(PatternCursor& c, PatternEdge& next) {
+  if (c.on) {
+    c.on = false;
+    if (c.pattern->steps[c.step].offMs > 0) {
+      next = patternCursorEdge(c);
+      return true;
+    }
+  }
+  if (++c.step >= c.pattern->stepCount) {
+    c.step = 0;
+    if (++c.repeat >= c.pattern->repeat) return false;
+  }
+  c.on = true;
+  next = patternCursorEdge(c);
+  return true;
+}
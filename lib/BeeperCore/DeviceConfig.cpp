@@ -0,0 +1,111 @@
+#include "DeviceConfig.h"
+
+#include <string.h>
+
+#if defined(ESP_PLATFORM)
+#include "esp_rom_crc.h"
+
+uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t len) {
+  return esp_rom_crc32_le(crc, data, len);
+}
+#else
+// Bitwise; the blob is a few hundred bytes and is only checked at boot and on save
+uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t len) {
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+  }
+  return ~crc;
+}
+#endif
+
+uint32_t configCrc(const DeviceConfig& c) {
+  return crc32Update(0, (const uint8_t*)&c, offsetof(DeviceConfig, crc));
+}
+
+void configEncode(DeviceConfig& c) {
+  c.magic = CONFIG_MAGIC;
+  c.version = CONFIG_VERSION;
+  c.size = sizeof(DeviceConfig);
+  c.crc = configCrc(c);
+}
+
+static bool decodeV1(const void* blob, DeviceConfig& out) {
+  DeviceConfigV1 v1;
+  memcpy(&v1, blob, sizeof(v1));
+  if (v1.magic != CONFIG_MAGIC || v1.version != 1 || v1.size != sizeof(v1) ||
+      v1.crc != crc32Update(0, (const uint8_t*)&v1, offsetof(DeviceConfigV1, crc))) {
+    return false;
+  }
+  DeviceConfig c = {};
+  c.magic = v1.magic;
+  c.version = v1.version;
+  c.size = sizeof(c);
+  // same field sizes in both layouts
+  memcpy(c.networks[0].ssid, v1.ssid, sizeof(v1.ssid));
+  memcpy(c.networks[0].pass, v1.pass, sizeof(v1.pass));
+  memcpy(c.adaUser, v1.adaUser, sizeof(v1.adaUser));
+  memcpy(c.adaKey, v1.adaKey, sizeof(v1.adaKey));
+  memcpy(c.feedKey, v1.feedKey, sizeof(v1.feedKey));
+  c.fastConnect = v1.fastConnect;
+  c.crc = configCrc(c);
+  out = c;
+  return true;
+}
+
+bool configDecode(const void* blob, size_t len, DeviceConfig& out) {
+  if (len == sizeof(DeviceConfigV1)) return decodeV1(blob, out);
+  if (len != sizeof(DeviceConfig)) return false;
+  DeviceConfig c;
+  memcpy(&c, blob, sizeof(c));
+  if (c.magic != CONFIG_MAGIC || c.version != CONFIG_VERSION || c.size != sizeof(c) || c.crc != configCrc(c)) {
+    return false;
+  }
+  out = c;
+  return true;
+}
+
+uint32_t configNetworkKey(const SavedNetwork& n) {
+  uint32_t crc = crc32Update(0, (const uint8_t*)n.ssid, strnlen(n.ssid, sizeof(n.ssid)));
+  crc = crc32Update(crc, (const uint8_t*)"", 1); // so "ab"+"c" and "a"+"bc" differ
+  return crc32Update(crc, (const uint8_t*)n.pass, strnlen(n.pass, sizeof(n.pass)));
+}
+
+uint8_t configNetworkCount(const DeviceConfig& c) {
+  uint8_t n = 0;
+  while (n < CONFIG_MAX_NETWORKS && c.networks[n].ssid[0] != '\0') n++;
+  return n;
+}
+
+void configRememberNetwork(DeviceConfig& c, const char* ssid, const char* pass) {
+  SavedNetwork net = {};
+  copyField(net.ssid, sizeof(net.ssid), ssid);
+  copyField(net.pass, sizeof(net.pass), pass);
+  if (net.ssid[0] == '\0') return;
+  if (memcmp(&net, &c.networks[0], sizeof(net)) == 0) return;
+
+  // shift everything in front of the old entry (or the last slot) down by one
+  uint8_t count = configNetworkCount(c);
+  uint8_t at = count < CONFIG_MAX_NETWORKS ? count : CONFIG_MAX_NETWORKS - 1;
+  for (uint8_t i = 0; i < count; i++) {
+    if (strcmp(c.networks[i].ssid, net.ssid) == 0) {
+      at = i;
+      break;
+    }
+  }
+  for (uint8_t i = at; i > 0; i--) c.networks[i] = c.networks[i - 1];
+  c.networks[0] = net;
+  memset(&c.fastConnect, 0, sizeof(c.fastConnect)); // belongs to the previous first network
+}
+
+void configPromoteNetwork(DeviceConfig& c, uint8_t index) {
+  if (index == 0 || index >= CONFIG_MAX_NETWORKS) return;
+  SavedNetwork net = c.networks[index];
+  configRememberNetwork(c, net.ssid, net.pass);
+}
+
+void copyField(char* dst, size_t len, const char* src) {
+  strncpy(dst, src, len - 1);
+  dst[len - 1] = '\0';
+}
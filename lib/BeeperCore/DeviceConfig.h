@@ -0,0 +1,94 @@
+/*
+  DeviceConfig - everything provisioned, as the single NVS blob ("cfg") main.cpp stores.
+
+  The blob is the struct itself behind a magic, a layout version, its size and a CRC-32, so it is
+  read with one getBytes() and written atomically: a power cut mid-save leaves the old record or
+  the new one, never a mix. Encoding and checking live here, away from Preferences, so
+  test/test_config can round-trip and corrupt records on the host.
+
+  Bump CONFIG_VERSION when the layout changes, keep the old layout below, and teach
+  configDecode() to convert it.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Last good association (of networks[0]), kept in the blob and mirrored in RTC memory so a wake
+// from deep sleep doesn't even need the NVS read.
+const uint32_t FAST_CONNECT_MAGIC = 0xFA57C0DE;
+struct FastConnectCache {
+  uint32_t magic;
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+};
+
+// Every network the portal has been given, so a unit that moves between sites (or loses one AP
+// of a mesh) has somewhere else to go. Kept most recently working first, without gaps.
+const uint8_t CONFIG_MAX_NETWORKS = 4;
+struct SavedNetwork {
+  char ssid[33];             // "" = free slot
+  char pass[65];
+};
+
+const uint32_t CONFIG_MAGIC = 0xBEE9C0F1;
+const uint16_t CONFIG_VERSION = 2;
+struct DeviceConfig {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t size;             // sizeof(DeviceConfig) when written
+  SavedNetwork networks[CONFIG_MAX_NETWORKS];
+  char adaUser[65];
+  char adaKey[65];
+  char feedKey[65];
+  FastConnectCache fastConnect;
+  uint32_t crc;              // CRC-32 of every byte before this field
+};
+
+// Version 1: a single network. Only ever read, to be converted.
+struct DeviceConfigV1 {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t size;
+  char ssid[33];
+  char pass[65];
+  char adaUser[65];
+  char adaKey[65];
+  char feedKey[65];
+  FastConnectCache fastConnect;
+  uint32_t crc;
+};
+
+// Standard (zlib) CRC-32; the ROM routine on the ESP32
+uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t len);
+
+uint32_t configCrc(const DeviceConfig& c);
+
+// Fills in magic, version, size and crc, making `c` ready to be stored as is
+void configEncode(DeviceConfig& c);
+
+// Takes `len` stored bytes into `out` if they are a complete, intact record of this version or
+// an older one (converted; its `version` field still says which, so the caller can store the new
+// layout). On false `out` is left untouched.
+bool configDecode(const void* blob, size_t len, DeviceConfig& out);
+
+// CRC-32 of one network's name and password: tells whether a fast-connect record kept
+// elsewhere (RTC memory) was made for it
+uint32_t configNetworkKey(const SavedNetwork& n);
+
+// Saved networks in use (they fill networks[] from the front)
+uint8_t configNetworkCount(const DeviceConfig& c);
+
+// Makes `ssid` the network to try first, replacing a saved entry of that name; a full list
+// drops its last one. fastConnect is cleared unless networks[0] stays exactly as it was.
+void configRememberNetwork(DeviceConfig& c, const char* ssid, const char* pass);
+
+// A fallback worked: move networks[index] to the front (see configRememberNetwork)
+void configPromoteNetwork(DeviceConfig& c, uint8_t index);
+
+// strncpy that always terminates; `src` is cut to fit
+void copyField(char* dst, size_t len, const char* src);
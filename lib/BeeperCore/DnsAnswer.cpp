@@ -0,0 +1,59 @@
+#include "DnsAnswer.h"
+
+#include <string.h>
+
+static const size_t DNS_HEADER_LEN = 12;
+static const uint16_t DNS_TYPE_A = 1;
+static const uint16_t DNS_TYPE_ANY = 255;
+static const uint16_t DNS_CLASS_IN = 1;
+
+static uint16_t readU16(const uint8_t* p) {
+  return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint8_t* writeU16(uint8_t* p, uint16_t v) {
+  p[0] = (uint8_t)(v >> 8);
+  p[1] = (uint8_t)v;
+  return p + 2;
+}
+
+size_t dnsAnswerA(const uint8_t* query, size_t len, const uint8_t ipv4[4], uint8_t* out, size_t outLen) {
+  if (len < DNS_HEADER_LEN) return 0;
+  uint16_t flags = readU16(query + 2);
+  bool isResponse = (flags & 0x8000) != 0;
+  uint8_t opcode = (flags >> 11) & 0x0F;
+  if (isResponse || opcode != 0 || readU16(query + 4) != 1) return 0;
+
+  // QNAME: labels up to a zero byte; queries never use compression pointers
+  size_t pos = DNS_HEADER_LEN;
+  while (pos < len && query[pos] != 0) {
+    if (query[pos] > 63) return 0;
+    pos += 1 + query[pos];
+  }
+  if (pos + 5 > len) return 0; // the zero byte, QTYPE and QCLASS
+  uint16_t qtype = readU16(query + pos + 1);
+  uint16_t qclass = readU16(query + pos + 3);
+  size_t questionEnd = pos + 5;
+
+  bool answer = (qtype == DNS_TYPE_A || qtype == DNS_TYPE_ANY) && qclass == DNS_CLASS_IN;
+  size_t replyLen = questionEnd + (answer ? 16 : 0);
+  if (replyLen > outLen) return 0;
+
+  memcpy(out, query, questionEnd); // header and question as asked; EDNS and the like are dropped
+  // QR, opcode 0, AA, RD echoed, RA, NOERROR
+  writeU16(out + 2, (uint16_t)(0x8000 | 0x0400 | (flags & 0x0100) | 0x0080));
+  writeU16(out + 6, answer ? 1 : 0); // ANCOUNT
+  writeU16(out + 8, 0);              // NSCOUNT
+  writeU16(out + 10, 0);             // ARCOUNT
+  if (!answer) return replyLen;
+
+  uint8_t* p = out + questionEnd;
+  p = writeU16(p, 0xC000 | DNS_HEADER_LEN); // name: pointer to the question's
+  p = writeU16(p, DNS_TYPE_A);
+  p = writeU16(p, DNS_CLASS_IN);
+  p = writeU16(p, (uint16_t)(DNS_ANSWER_TTL_S >> 16));
+  p = writeU16(p, (uint16_t)DNS_ANSWER_TTL_S);
+  p = writeU16(p, 4);
+  memcpy(p, ipv4, 4);
+  return replyLen;
+}
@@ -0,0 +1,21 @@
+/*
+  DnsAnswer - the one reply a captive-portal DNS server gives: "every name is me".
+
+  While the provisioning AP is up, each query for an A record is answered with the portal's
+  address, so a phone's connectivity check lands on the portal and the OS opens the setup page
+  by itself. Other record types (AAAA, HTTPS, ...) get an empty NOERROR answer, which makes
+  clients fall back to A straight away instead of waiting out a timeout.
+
+  Plain C++; the socket side is CaptiveDns in src/, the parsing is tested by test/test_dns.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+const uint32_t DNS_ANSWER_TTL_S = 10; // short, so nothing caches the portal once provisioning is done
+
+// Builds the reply to `query` in `out`, answering A/ANY questions with `ipv4` (in address
+// order, e.g. {192, 168, 4, 1}). Returns the reply length, or 0 for anything that shouldn't be
+// answered (responses, non-QUERY opcodes, not exactly one question, truncated packets).
+size_t dnsAnswerA(const uint8_t* query, size_t len, const uint8_t ipv4[4], uint8_t* out, size_t outLen);
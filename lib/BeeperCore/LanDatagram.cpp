@@ -0,0 +1,31 @@
+#include "LanDatagram.h"
+
+#include <string.h>
+
+#include "Payload.h"
+
+bool lanDatagramParse(const char* msg, size_t len, LanDatagram& out) {
+  static const char MAC_TAG[] = " mac=";
+  const size_t tagLen = sizeof(MAC_TAG) - 1;
+  const size_t macHex = 2 * LanDatagram::MAC_BYTES;
+  if (len < 4 + tagLen + macHex || memcmp(msg, "true", 4) != 0) return false;
+
+  size_t macAt = len - macHex;
+  out.signedLen = macAt - tagLen;
+  if (memcmp(msg + out.signedLen, MAC_TAG, tagLen) != 0) return false;
+  if (!payloadHexBytes(msg + macAt, out.mac, LanDatagram::MAC_BYTES)) return false;
+
+  size_t n;
+  const char* v = payloadField(msg, out.signedLen, "seq", n);
+  if (!v || !payloadDecimal(v, n, 19, out.seq)) return false;
+  uint64_t id = 0;
+  v = payloadField(msg, out.signedLen, "id", n);
+  if (v && !payloadDecimal(v, n, 19, id)) return false;
+  out.triggerId = (uint32_t)id;
+  out.src = payloadField(msg, out.signedLen, "src", out.srcLen);
+  if (!out.src) {
+    out.src = msg;
+    out.srcLen = 0;
+  }
+  return true;
+}
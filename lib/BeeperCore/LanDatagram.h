@@ -0,0 +1,28 @@
+/*
+  LanDatagram - splits a LAN trigger datagram (see include/LanTrigger.h) into its fields:
+
+      true seq=<n> id=<n> src=<name> mac=<32 hex>
+
+  The mac is always last; id and src are optional, and src names the sender for its replay
+  window (ReplayWindow.h). Scans the receive buffer in place, which need not be NUL-terminated.
+  Checking the MAC needs mbedTLS and stays in LanTrigger; this part runs on the host in
+  test/test_lan_datagram.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct LanDatagram {
+  static const size_t MAC_BYTES = 16;
+  size_t signedLen;          // what the mac covers: everything before " mac="
+  uint8_t mac[MAC_BYTES];
+  uint64_t seq;
+  uint32_t triggerId;        // 0 if none
+  const char* src;           // into the datagram, srcLen bytes; empty if none
+  size_t srcLen;
+};
+
+// False if the datagram is cut short or malformed: no "true" start, no full " mac=" trailer,
+// no seq.
+bool lanDatagramParse(const char* msg, size_t len, LanDatagram& out);
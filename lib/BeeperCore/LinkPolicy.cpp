@@ -0,0 +1,44 @@
+#include "LinkPolicy.h"
+
+// "Equal jitter": half of the (capped, doubling) window is fixed, half is random, so retries
+// still back off but devices that failed together don't retry together.
+uint32_t backoffNextDelayMs(Backoff& b, uint32_t random) {
+  uint64_t window = (uint64_t)b.baseMs << (b.attempt < 20 ? b.attempt : 20);
+  if (window > b.capMs) window = b.capMs;
+  if (b.attempt < 255) b.attempt++;
+  uint32_t half = (uint32_t)(window / 2);
+  return half + random % (half + 1);
+}
+
+uint16_t keepAliveNextProbe(uint16_t good, uint16_t bad, const KeepAliveLimits& lim) {
+  uint32_t next = bad ? (good + bad) / 2u : (uint32_t)good * 2u;
+  if (next > lim.maxS) next = lim.maxS;
+  if (next <= good || next - good < lim.resolutionS) return 0;
+  return (uint16_t)next;
+}
+
+bool keepAliveProbeHeld(KeepAliveProbe& p, const KeepAliveLimits& lim) {
+  p.goodS = p.tryingS;
+  uint16_t next = keepAliveNextProbe(p.goodS, p.badS, lim);
+  if (next == 0) {
+    p.settled = true;
+    return false;
+  }
+  p.tryingS = next;
+  return true;
+}
+
+void keepAliveProbeTimedOut(KeepAliveProbe& p, const KeepAliveLimits& lim) {
+  uint16_t failed = p.tryingS;
+  p.badS = failed;
+  if (failed <= p.goodS) {
+    // the path changed under a value that used to hold: halve and search again from there
+    p.goodS = failed / 2 > lim.floorS ? failed / 2 : lim.floorS;
+    p.tryingS = p.goodS;
+    p.settled = false;
+  } else {
+    uint16_t next = keepAliveNextProbe(p.goodS, failed, lim);
+    p.tryingS = next ? next : p.goodS;
+    p.settled = next == 0;
+  }
+}
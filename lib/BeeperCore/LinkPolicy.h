@@ -0,0 +1,49 @@
+/*
+  LinkPolicy - the timing decisions of the link supervisor, without the radio.
+
+  Backoff spaces out WiFi and broker reconnect attempts; KeepAliveProbe is the search for the
+  longest MQTT keepalive the path's NAT tolerates (see ENABLE_ADAPTIVE_KEEPALIVE in main.cpp).
+  main.cpp owns the state, its timestamps and the random source; these functions only compute
+  what to do next, so test/test_link_policy can drive them through whole reconnect histories.
+*/
+#pragma once
+
+#include <stdint.h>
+
+struct Backoff {
+  uint32_t baseMs;
+  uint32_t capMs;
+  uint8_t attempt;
+};
+
+// Delay before the next attempt, and counts the attempt. `random` is any uniformly random
+// 32-bit value (esp_random() on the device).
+uint32_t backoffNextDelayMs(Backoff& b, uint32_t random);
+
+inline void backoffReset(Backoff& b) {
+  b.attempt = 0;
+}
+
+struct KeepAliveLimits {
+  uint16_t floorS;      // never go below this (and where a search restarts)
+  uint16_t maxS;
+  uint16_t resolutionS; // stop once the untested gap is smaller than this
+};
+
+struct KeepAliveProbe {
+  uint32_t magic;
+  uint16_t goodS;     // longest keepalive that has held
+  uint16_t badS;      // shortest keepalive that has timed out, 0 = none yet
+  uint16_t tryingS;   // keepalive of the current / next connection
+  bool settled;       // search finished; tryingS == goodS
+};
+
+// Next value to try after `good` held and `bad` (0 = none yet) failed; 0 when the search is done
+uint16_t keepAliveNextProbe(uint16_t good, uint16_t bad, const KeepAliveLimits& lim);
+
+// tryingS has held long enough. Moves on to the next value and returns true (the caller
+// reconnects with it), or settles and returns false.
+bool keepAliveProbeHeld(KeepAliveProbe& p, const KeepAliveLimits& lim);
+
+// The connection went idle-dead after at least one full tryingS interval.
+void keepAliveProbeTimedOut(KeepAliveProbe& p, const KeepAliveLimits& lim);
@@ -0,0 +1,40 @@
+#include "OtaRequest.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Payload.h"
+
+bool otaRequestParse(const char* msg, size_t len, OtaRequest& out) {
+  size_t urlLen, versionLen, sizeLen, shaLen, sigLen;
+  const char* url = payloadField(msg, len, "url", urlLen);
+  const char* version = payloadField(msg, len, "version", versionLen);
+  const char* size = payloadField(msg, len, "size", sizeLen);
+  const char* sha = payloadField(msg, len, "sha256", shaLen);
+  const char* sig = payloadField(msg, len, "sig", sigLen);
+  if (!url || !version || !size || !sha || !sig) return false;
+  if (urlLen >= sizeof(out.url) || urlLen < 8 || memcmp(url, "https://", 8) != 0) return false;
+  if (shaLen != 2 * sizeof(out.sha256)) return false;
+  if (sigLen == 0 || sigLen % 2 != 0 || sigLen > 2 * sizeof(out.sig)) return false;
+
+  uint64_t v, n; // 9 digits fit in 32 bits
+  if (!payloadDecimal(version, versionLen, 9, v) || v == 0) return false;
+  if (!payloadDecimal(size, sizeLen, 9, n) || n == 0) return false;
+  if (!payloadHexBytes(sha, out.sha256, sizeof(out.sha256))) return false;
+  if (!payloadHexBytes(sig, out.sig, sigLen / 2)) return false;
+  out.version = (uint32_t)v;
+  out.size = (uint32_t)n;
+  out.sigLen = (uint8_t)(sigLen / 2);
+  memcpy(out.url, url, urlLen);
+  out.url[urlLen] = '\0';
+  return true;
+}
+
+size_t otaRequestSignedText(const OtaRequest& req, char* out) {
+  int n = snprintf(out, OtaRequest::SIGNED_TEXT_MAX, "version=%lu size=%lu sha256=", (unsigned long)req.version,
+                   (unsigned long)req.size);
+  for (size_t i = 0; i < sizeof(req.sha256); i++) {
+    n += snprintf(out + n, OtaRequest::SIGNED_TEXT_MAX - n, "%02x", req.sha256[i]);
+  }
+  return (size_t)n;
+}
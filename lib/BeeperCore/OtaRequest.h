@@ -0,0 +1,35 @@
+/*
+  OtaRequest - the over-the-air update request published to the "<FEED_KEY>-ota" feed by
+  scripts/pack_ota.py:
+
+      url=<https url> version=<n> size=<n> sha256=<64 hex> sig=<hex DER>
+
+  Fields in any order, separated by whitespace. The signature covers otaRequestSignedText(),
+  which is rebuilt from the parsed fields, so only the canonical form verifies; the URL is not
+  signed. version is the BEEPER_FIRMWARE_VERSION of the image (include/firmware_version.h).
+  Verifying needs mbedTLS and stays in src/OtaUpdater.cpp; the parsing of this
+  broker-supplied text runs on the host in test/test_ota_request.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct OtaRequest {
+  static const size_t URL_MAX = 256;
+  static const size_t SIG_MAX = 72;       // DER-encoded ECDSA P-256
+  static const size_t SIGNED_TEXT_MAX = 128;
+
+  char url[URL_MAX];     // https:// URL of the .zz image, NUL-terminated
+  uint32_t version;      // BEEPER_FIRMWARE_VERSION of the image
+  uint32_t size;         // decompressed size in bytes
+  uint8_t sha256[32];    // of the decompressed image
+  uint8_t sig[SIG_MAX];  // over otaRequestSignedText()
+  uint8_t sigLen;
+};
+
+// False if a field is missing, too long, or malformed, or version or size is 0
+bool otaRequestParse(const char* msg, size_t len, OtaRequest& out);
+
+// "version=<n> size=<n> sha256=<lowercase hex>" into out (at least SIGNED_TEXT_MAX bytes); returns its length
+size_t otaRequestSignedText(const OtaRequest& req, char* out);
@@ -0,0 +1,119 @@
+#include "Payload.h"
+
+#include <string.h>
+
+bool payloadIsTrigger(const uint8_t* payload, unsigned int length) {
+  static const char NEEDLE[] = "true";
+  const unsigned int needleLen = sizeof(NEEDLE) - 1;
+
+  for (unsigned int i = 0; i + needleLen <= length; i++) {
+    unsigned int j = 0;
+    while (j < needleLen && asciiLower((char)payload[i + j]) == NEEDLE[j]) j++;
+    if (j == needleLen) return true;
+  }
+
+  unsigned int start = 0;
+  unsigned int end = length;
+  while (start < end && isSpace((char)payload[start])) start++;
+  while (end > start && isSpace((char)payload[end - 1])) end--;
+  return end - start == 1 && payload[start] == '1';
+}
+
+uint32_t payloadTriggerId(const uint8_t* payload, unsigned int length) {
+  for (unsigned int i = 0; i + 3 < length; i++) {
+    if (payload[i] != 'i' || payload[i + 1] != 'd' || payload[i + 2] != '=') continue;
+    if (i > 0 && !isSpace((char)payload[i - 1])) continue;
+    uint32_t id = 0;
+    for (unsigned int j = i + 3; j < length && payload[j] >= '0' && payload[j] <= '9'; j++) {
+      id = id * 10 + (uint32_t)(payload[j] - '0');
+    }
+    return id;
+  }
+  return 0;
+}
+
+PatternId patternByName(const uint8_t* name, unsigned int nameLen, PatternId fallback) {
+  for (uint8_t m = 0; m < PAT_COUNT; m++) {
+    if (!PATTERNS[m].selectable) continue;
+    const char* candidate = PATTERNS[m].name;
+    unsigned int j = 0;
+    while (j < nameLen && candidate[j] != '\0' && asciiLower((char)name[j]) == candidate[j]) j++;
+    if (j == nameLen && candidate[j] == '\0') return (PatternId)m;
+  }
+  return fallback;
+}
+
+PatternId payloadMelody(const uint8_t* payload, unsigned int length, PatternId fallback) {
+  static const char KEY[] = "melody=";
+  const unsigned int keyLen = sizeof(KEY) - 1;
+  for (unsigned int i = 0; i + keyLen < length; i++) {
+    if (memcmp(payload + i, KEY, keyLen) != 0 || (i > 0 && !isSpace((char)payload[i - 1]))) continue;
+    const uint8_t* name = payload + i + keyLen;
+    unsigned int nameLen = 0;
+    while (i + keyLen + nameLen < length && !isSpace((char)name[nameLen])) nameLen++;
+    return patternByName(name, nameLen, fallback);
+  }
+  return fallback;
+}
+
+bool payloadTarget(const uint8_t* payload, unsigned int length, uint8_t mac[6]) {
+  static const unsigned int MAC_TEXT_LEN = 17;
+  for (unsigned int i = 0; i + 3 + MAC_TEXT_LEN <= length; i++) {
+    if (payload[i] != 't' || payload[i + 1] != 'o' || payload[i + 2] != '=') continue;
+    if (i > 0 && !isSpace((char)payload[i - 1])) continue;
+    const uint8_t* p = payload + i + 3;
+    for (int b = 0; b < 6; b++) {
+      int hi = hexDigitValue((char)p[b * 3]);
+      int lo = hexDigitValue((char)p[b * 3 + 1]);
+      if (hi < 0 || lo < 0 || (b < 5 && p[b * 3 + 2] != ':')) return false;
+      mac[b] = (uint8_t)((hi << 4) | lo);
+    }
+    return true;
+  }
+  return false;
+}
+
+void payloadTrim(const uint8_t*& payload, unsigned int& length) {
+  while (length > 0 && isSpace((char)payload[0])) { payload++; length--; }
+  while (length > 0 && isSpace((char)payload[length - 1])) length--;
+}
+
+long payloadNumber(const uint8_t*& p, unsigned int& length) {
+  long v = -1;
+  for (unsigned int n = 0; length > 0 && n < 5 && p[0] >= '0' && p[0] <= '9'; n++, p++, length--) {
+    v = (v < 0 ? 0 : v * 10) + (p[0] - '0');
+  }
+  return v;
+}
+
+const char* payloadField(const char* msg, size_t len, const char* name, size_t& valueLen) {
+  size_t nameLen = strlen(name);
+  for (size_t i = 0; i + nameLen + 1 <= len; i++) {
+    if ((i > 0 && !isSpace(msg[i - 1])) || memcmp(msg + i, name, nameLen) != 0 || msg[i + nameLen] != '=') continue;
+    const char* v = msg + i + nameLen + 1;
+    valueLen = 0;
+    while (v + valueLen < msg + len && !isSpace(v[valueLen])) valueLen++;
+    return v;
+  }
+  return nullptr;
+}
+
+bool payloadDecimal(const char* v, size_t len, size_t maxDigits, uint64_t& out) {
+  if (len == 0 || len > maxDigits || len > 19) return false; // 19 digits always fit in 64 bits
+  out = 0;
+  for (size_t i = 0; i < len; i++) {
+    if (v[i] < '0' || v[i] > '9') return false;
+    out = out * 10 + (uint64_t)(v[i] - '0');
+  }
+  return true;
+}
+
+bool payloadHexBytes(const char* hex, uint8_t* out, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    int hi = hexDigitValue(hex[2 * i]);
+    int lo = hexDigitValue(hex[2 * i + 1]);
+    if (hi < 0 || lo < 0) return false;
+    out[i] = (uint8_t)((hi << 4) | lo);
+  }
+  return true;
+}
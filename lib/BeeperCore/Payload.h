@@ -0,0 +1,66 @@
+/*
+  Payload - parsing of the MQTT (and LAN/relay) message bodies the beeper understands.
+
+  Everything here scans the broker's buffer in place: no copies, no allocation, and no
+  assumption that the payload is NUL-terminated. Plain C++ with no Arduino dependency, so it is
+  exercised on the host by test/test_payload and timed by test/test_bench.
+
+    "true", "TRUE please", "1"          a trigger
+    "true id=42"                        a trigger whose ack echoes the id (lib/bench_latency.py)
+    "true melody=chime"                 a trigger playing a selectable pattern
+    "true to=aa:bb:cc:dd:ee:ff"         a trigger for one unit of a cluster
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "BeepPatterns.h"
+
+inline char asciiLower(char c) {
+  return (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c;
+}
+
+inline bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+inline int hexDigitValue(char c) {
+  c = asciiLower(c);
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+// True if the payload contains "true" (case-insensitive) or is exactly "1"
+// after trimming whitespace.
+bool payloadIsTrigger(const uint8_t* payload, unsigned int length);
+
+// Benchmark triggers look like "true id=42". Returns the id, or 0 if there is none.
+uint32_t payloadTriggerId(const uint8_t* payload, unsigned int length);
+
+// The selectable entry of PATTERNS called `name` (case-insensitive), or `fallback`
+PatternId patternByName(const uint8_t* name, unsigned int nameLen, PatternId fallback);
+
+// "melody=<name>" picks a selectable entry of PATTERNS. Returns `fallback` if there is none or
+// the name is unknown.
+PatternId payloadMelody(const uint8_t* payload, unsigned int length, PatternId fallback);
+
+// "to=aa:bb:cc:dd:ee:ff" addresses one unit of a cluster. Returns false if there is none.
+bool payloadTarget(const uint8_t* payload, unsigned int length, uint8_t mac[6]);
+
+// Payload with surrounding whitespace dropped
+void payloadTrim(const uint8_t*& payload, unsigned int& length);
+
+// Leading decimal number of at most 5 digits, consumed from the payload; -1 if there is none
+long payloadNumber(const uint8_t*& p, unsigned int& length);
+
+// Value of "<name>=" at the start of msg[0, len) or after whitespace, up to the next
+// whitespace; sets valueLen. nullptr if absent.
+const char* payloadField(const char* msg, size_t len, const char* name, size_t& valueLen);
+
+// The whole of v[0, len) as a decimal of 1 to maxDigits (no more than 19) digits
+bool payloadDecimal(const char* v, size_t len, size_t maxDigits, uint64_t& out);
+
+// hex[0, 2 * n) into n bytes, either case; false on anything that is not a hex digit
+bool payloadHexBytes(const char* hex, uint8_t* out, size_t n);
@@ -0,0 +1,40 @@
+#include "ReplayWindow.h"
+
+void replayWindowReset(ReplayWindow& w) {
+  w.magic = ReplayWindow::MAGIC;
+  w.count = 0;
+  w.floor = 0;
+}
+
+bool replayWindowAccept(ReplayWindow& w, uint32_t sender, uint64_t seq) {
+  for (uint8_t i = 0; i < w.count; i++) {
+    ReplayWindow::Entry& e = w.entries[i];
+    if (e.sender != sender) continue;
+    if (seq <= e.highSeq) return false;
+    e.highSeq = seq;
+    return true;
+  }
+
+  if (seq <= w.floor) return false;
+  uint8_t slot = w.count;
+  if (w.count < ReplayWindow::SENDERS) {
+    w.count++;
+  } else {
+    slot = 0;
+    for (uint8_t i = 1; i < w.count; i++) {
+      if (w.entries[i].highSeq < w.entries[slot].highSeq) slot = i;
+    }
+    if (w.entries[slot].highSeq > w.floor) w.floor = w.entries[slot].highSeq;
+  }
+  w.entries[slot] = { sender, seq };
+  return true;
+}
+
+uint32_t replaySenderId(const char* name, size_t len) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    h ^= (uint8_t)name[i];
+    h *= 16777619u;
+  }
+  return h;
+}
@@ -0,0 +1,47 @@
+/*
+  ReplayWindow - drops an authenticated message that was already accepted once, per sender.
+
+  The MAC on a LAN datagram (or an ESP-NOW frame) proves who made it, not that it is new: a
+  captured copy verifies just as well. Every sender therefore numbers its messages with a seq
+  that only grows, and a message is fresh only if its seq is above the highest one accepted from
+  that sender. Each sender has its own mark, so two senders with unrelated clocks don't reject
+  each other.
+
+  The table holds SENDERS marks. A new sender in a full table pushes out the lowest one, and
+  that seq becomes `floor`, which any sender without an entry must beat, so pushing a sender out
+  never lets its old messages back in. Seqs that start near the current time (a clock in ms)
+  keep the floor from getting in a new sender's way.
+
+  Plain data with no pointers: the caller keeps it in RTC memory and NVS so captured messages
+  stay stale across a restart, and `magic` tells a kept copy from garbage.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct ReplayWindow {
+  static const uint32_t MAGIC = 0x5E9A11D5;
+  static const uint8_t SENDERS = 8;
+  struct Entry {
+    uint32_t sender;
+    uint64_t highSeq;
+  };
+  uint32_t magic;
+  uint8_t count;
+  uint64_t floor;
+  Entry entries[SENDERS];
+};
+
+void replayWindowReset(ReplayWindow& w);
+
+inline bool replayWindowValid(const ReplayWindow& w) {
+  return w.magic == ReplayWindow::MAGIC && w.count <= ReplayWindow::SENDERS;
+}
+
+// True if `seq` is newer than anything accepted from `sender`, and records it. False for a
+// replay (or a message no newer than the floor from a sender the table has lost track of).
+bool replayWindowAccept(ReplayWindow& w, uint32_t sender, uint64_t seq);
+
+// Sender id for a name (FNV-1a); the empty name is the sender that gave none
+uint32_t replaySenderId(const char* name, size_t len);
@@ -0,0 +1,120 @@
+#include "ScanList.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void scanListAdd(ScanList& list, const char* ssid, int8_t rssi, uint8_t channel, bool open) {
+  if (ssid[0] == '\0') return;
+
+  int at = -1;
+  for (uint8_t i = 0; i < list.count; i++) {
+    if (strcmp(list.entries[i].ssid, ssid) != 0) continue;
+    if (list.entries[i].rssi >= rssi) return;
+    at = i;
+    break;
+  }
+  if (at < 0) {
+    if (list.count < ScanList::MAX) {
+      at = list.count++;
+    } else if (list.entries[ScanList::MAX - 1].rssi < rssi) {
+      at = ScanList::MAX - 1;
+    } else {
+      return;
+    }
+  }
+
+  ScanEntry e = {};
+  strncpy(e.ssid, ssid, sizeof(e.ssid) - 1);
+  e.rssi = rssi;
+  e.channel = channel;
+  e.open = open;
+  // the slot only ever moves up: bubble it into place
+  while (at > 0 && list.entries[at - 1].rssi < rssi) {
+    list.entries[at] = list.entries[at - 1];
+    at--;
+  }
+  list.entries[at] = e;
+}
+
+const ScanEntry* scanListFind(const ScanList& list, const char* ssid) {
+  for (uint8_t i = 0; i < list.count; i++) {
+    if (strcmp(list.entries[i].ssid, ssid) == 0) return &list.entries[i];
+  }
+  return nullptr;
+}
+
+uint8_t scanListRank(const ScanList& list, const char* const* ssids, uint8_t count, uint8_t* order) {
+  uint8_t n = 0;
+  // the list is sorted, so walking it yields the seen names strongest first
+  for (uint8_t e = 0; e < list.count; e++) {
+    for (uint8_t i = 0; i < count; i++) {
+      if (strcmp(list.entries[e].ssid, ssids[i]) == 0) {
+        order[n++] = i;
+        break;
+      }
+    }
+  }
+  uint8_t seen = n;
+  for (uint8_t i = 0; i < count; i++) {
+    bool placed = false;
+    for (uint8_t k = 0; k < seen && !placed; k++) placed = order[k] == i;
+    if (!placed) order[n++] = i;
+  }
+  return seen;
+}
+
+// JSON string body for an SSID (up to 32 arbitrary bytes); returns its length, or 0 if it
+// doesn't fit in `len`.
+static size_t jsonEscape(const char* s, char* out, size_t len) {
+  size_t n = 0;
+  for (; *s; s++) {
+    unsigned char c = (unsigned char)*s;
+    char esc[7];
+    size_t escLen;
+    if (c == '"' || c == '\\') {
+      esc[0] = '\\';
+      esc[1] = (char)c;
+      escLen = 2;
+    } else if (c < 0x20 || c == 0x7F) {
+      escLen = (size_t)snprintf(esc, sizeof(esc), "\\u%04x", c);
+    } else {
+      esc[0] = (char)c;
+      escLen = 1;
+    }
+    if (n + escLen > len) return 0;
+    memcpy(out + n, esc, escLen);
+    n += escLen;
+  }
+  return n;
+}
+
+size_t scanListJson(const ScanList& list, char* out, size_t outLen) {
+  if (outLen < 3) return 0;
+  size_t n = 0;
+  out[n++] = '[';
+  for (uint8_t i = 0; i < list.count; i++) {
+    const ScanEntry& e = list.entries[i];
+    char tail[48];
+    int tailLen = snprintf(tail, sizeof(tail), "\",\"rssi\":%d,\"ch\":%u,\"open\":%s}", e.rssi,
+                           (unsigned)e.channel, e.open ? "true" : "false");
+    size_t start = n;
+    static const char HEAD[] = "{\"ssid\":\"";
+    size_t headLen = (i > 0 ? 1 : 0) + sizeof(HEAD) - 1;
+    // room for the head, the tail and the closing bracket, or stop here
+    if (n + headLen + (size_t)tailLen + 2 > outLen) break;
+    if (i > 0) out[n++] = ',';
+    memcpy(out + n, HEAD, sizeof(HEAD) - 1);
+    n += sizeof(HEAD) - 1;
+    size_t nameLen = jsonEscape(e.ssid, out + n, outLen - n - (size_t)tailLen - 2);
+    if (nameLen == 0) {
+      n = start;
+      break;
+    }
+    n += nameLen;
+    memcpy(out + n, tail, (size_t)tailLen);
+    n += (size_t)tailLen;
+  }
+  out[n++] = ']';
+  out[n] = '\0';
+  return n;
+}
@@ -0,0 +1,44 @@
+/*
+  ScanList - the provisioning portal's cached WiFi scan, and the JSON the setup page reads.
+
+  The portal scans once before anyone joins its AP (a scan takes the radio off channel, which
+  stalls connected phones), keeps one entry per network name, strongest first, and serves the
+  list from memory as GET /scan. The link supervisor's failover scan lands in the same list and
+  ranks the saved networks with it. Plain C++ so test/test_scan_list can check the ordering and
+  the escaping of hostile SSIDs on the host.
+
+    [{"ssid":"home","rssi":-48,"ch":6,"open":false}, ...]
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct ScanEntry {
+  char ssid[33];
+  int8_t rssi;
+  uint8_t channel;
+  bool open;
+};
+
+struct ScanList {
+  static const uint8_t MAX = 20;
+  ScanEntry entries[MAX];   // strongest first
+  uint8_t count;
+};
+
+// Adds one scan result. Repeats of a name (mesh nodes, 2.4 GHz twins) keep the strongest;
+// hidden (empty) names are skipped; a full list drops its weakest entry.
+void scanListAdd(ScanList& list, const char* ssid, int8_t rssi, uint8_t channel, bool open);
+
+// Entry called exactly `ssid`, or nullptr
+const ScanEntry* scanListFind(const ScanList& list, const char* ssid);
+
+// Writes the list as a JSON array into `out` and returns its length. Entries that don't fit are
+// left off, so the result is always complete JSON (outLen must be at least 3 for "[]").
+size_t scanListJson(const ScanList& list, char* out, size_t outLen);
+
+// Order in which to try `count` saved network names: those in the list strongest first, then
+// the rest (hidden networks, or ones the scan missed) as given. Writes all `count` indices into
+// `order` and returns how many of them were in the list.
+uint8_t scanListRank(const ScanList& list, const char* const* ssids, uint8_t count, uint8_t* order);
@@ -0,0 +1,57 @@
+#include "TelemetrySummary.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+// Appends one whole field into buf[used, limit), or nothing; false if it didn't fit
+static bool appendField(char* buf, size_t limit, size_t& used, const char* fmt, ...) __attribute__((format(printf, 4, 5)));
+static bool appendField(char* buf, size_t limit, size_t& used, const char* fmt, ...) {
+  if (used >= limit) return false;
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(buf + used, limit - used, fmt, ap);
+  va_end(ap);
+  if (n < 0 || (size_t)n >= limit - used) {
+    buf[used] = '\0';
+    return false;
+  }
+  used += (size_t)n;
+  return true;
+}
+
+size_t telemetrySummaryJson(const TelemetrySummary& s, char* buf, size_t len) {
+  // what the tail may need after the last metric: ",\"cut\":8}" and the terminator
+  static const size_t TAIL_RESERVE = sizeof(",\"cut\":8}");
+  if (len < TAIL_RESERVE) {
+    if (len > 0) buf[0] = '\0';
+    return 0;
+  }
+  size_t limit = len - TAIL_RESERVE + 1; // appendField's limit includes the NUL
+  size_t used = 0;
+
+  if (!appendField(buf, limit, used, "{\"up\":%lu,\"heap\":[%lu,%lu,%lu]", (unsigned long)s.upS,
+                   (unsigned long)s.heapFree, (unsigned long)s.heapMinFree, (unsigned long)s.heapLargest) ||
+      !appendField(buf, limit, used, ",\"rc\":[%lu,%lu],\"trig\":%lu,\"dup\":%lu", (unsigned long)s.wifiReconnects,
+                   (unsigned long)s.mqttReconnects, (unsigned long)s.triggers, (unsigned long)s.duplicates)) {
+    buf[0] = '\0';
+    return 0;
+  }
+
+  uint8_t cut = 0;
+  uint8_t count = s.metricCount < TelemetrySummary::MAX_METRICS ? s.metricCount : TelemetrySummary::MAX_METRICS;
+  for (uint8_t i = 0; i < count; i++) {
+    const TelemetrySummary::Metric& m = s.metrics[i];
+    if (!appendField(buf, limit, used, ",\"%s\":[%lu,%lu,%lu,%lu,%u]", m.name, (unsigned long)m.p50,
+                     (unsigned long)m.p90, (unsigned long)m.p99, (unsigned long)m.max, (unsigned)m.n)) {
+      cut++;
+    }
+  }
+  // the reserve always has room for this
+  if (cut > 0) {
+    used += (size_t)snprintf(buf + used, len - used, ",\"cut\":%u}", (unsigned)cut);
+  } else {
+    buf[used++] = '}';
+    buf[used] = '\0';
+  }
+  return used;
+}
@@ -0,0 +1,32 @@
+/*
+  TelemetrySummary - the JSON line Telemetry::formatSummary() publishes to the diagnostics feed,
+  rendered from a snapshot so test/test_telemetry can check it on the host.
+
+    {"up":812,"heap":[182340,170112,110580],"rc":[1,2],"trig":14,"dup":0,
+     "rxb_us":[1830,2210,4100,4100,14],...,"cut":1}
+
+  Each metric is [p50, p90, p99, max, n]. The output is always whole JSON or nothing: a metric
+  that doesn't fit is left out (and counted in "cut", which is only there when something was),
+  and a buffer too small for the fixed fields gives 0 rather than a torn line.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct TelemetrySummary {
+  static const uint8_t MAX_METRICS = 8;
+  struct Metric {
+    const char* name;   // a plain key: quoted as is, not escaped
+    uint32_t p50, p90, p99, max;
+    uint8_t n;
+  };
+  uint32_t upS;
+  uint32_t heapFree, heapMinFree, heapLargest;
+  uint32_t wifiReconnects, mqttReconnects, triggers, duplicates;
+  Metric metrics[MAX_METRICS];  // only those with samples
+  uint8_t metricCount;
+};
+
+// Returns the length written (NUL-terminated), or 0 if even the fixed fields don't fit.
+size_t telemetrySummaryJson(const TelemetrySummary& s, char* buf, size_t len);
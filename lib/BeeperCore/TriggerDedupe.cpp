@@ -0,0 +1,29 @@
+#include "TriggerDedupe.h"
+
+#include "Payload.h"
+
+uint32_t triggerKey(const uint8_t* payload, unsigned int length) {
+  payloadTrim(payload, length);
+  uint32_t h = 2166136261u;
+  for (unsigned int i = 0; i < length; i++) {
+    h ^= payload[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+bool triggerDedupeSeen(TriggerDedupe& d, const uint8_t* payload, unsigned int length, uint32_t nowMs,
+                       uint32_t plainWindowMs) {
+  uint32_t key = triggerKey(payload, length);
+  bool numbered = payloadTriggerId(payload, length) != 0;
+  for (uint8_t i = 0; i < d.count; i++) {
+    const TriggerDedupe::Entry& e = d.entries[i];
+    if (e.key != key || e.numbered != numbered) continue;
+    if (numbered || nowMs - e.atMs < plainWindowMs) return true;
+  }
+
+  d.entries[d.next] = { key, nowMs, numbered };
+  d.next = (uint8_t)((d.next + 1) % TriggerDedupe::SIZE);
+  if (d.count < TriggerDedupe::SIZE) d.count++;
+  return false;
+}
@@ -0,0 +1,43 @@
+/*
+  TriggerDedupe - drops a trigger the device has already played when the broker hands it over
+  again.
+
+  With MQTT_RELIABLE_DELIVERY (main.cpp) the same ping can arrive twice: as a QoS 1 redelivery
+  whose PUBACK was lost, and again as the feed's last value fetched through "<feed>/get" after
+  a reconnect. PubSubClient doesn't pass the MQTT packet id to the callback and Adafruit IO
+  doesn't echo one, so the key is the payload itself (FNV-1a, whitespace trimmed), and what
+  counts as "the same" depends on whether the sender numbered it:
+
+    "true id=42"   unique per ping: a repeat anywhere in the ring is a duplicate
+    "true"         every ping looks alike: only a repeat within `plainWindowMs` is one
+
+  A fixed ring of the last SIZE triggers; no allocation, so it can run in the MQTT callback.
+*/
+#pragma once
+
+#include <stdint.h>
+
+struct TriggerDedupe {
+  static const uint8_t SIZE = 8;
+  struct Entry {
+    uint32_t key;
+    uint32_t atMs;
+    bool numbered;
+  };
+  Entry entries[SIZE];
+  uint8_t next;   // slot the next new trigger overwrites
+  uint8_t count;
+};
+
+uint32_t triggerKey(const uint8_t* payload, unsigned int length);
+
+// True if this trigger was already seen. Otherwise records it (overwriting the oldest entry)
+// and returns false. A duplicate doesn't refresh its entry, so a steady stream of plain pings
+// still plays once per window.
+bool triggerDedupeSeen(TriggerDedupe& d, const uint8_t* payload, unsigned int length, uint32_t nowMs,
+                       uint32_t plainWindowMs);
+
+inline void triggerDedupeReset(TriggerDedupe& d) {
+  d.next = 0;
+  d.count = 0;
+}
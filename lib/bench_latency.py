@@ -0,0 +1,272 @@
+"""
+Trigger-to-beep latency benchmark for the beeper.
+
+Publishes N triggers of the form "true id=<n>" to <ADA_USERNAME>/feeds/<FEED_KEY> at a fixed
+rate and waits for the device's ack, which echoes the id and its own receive-to-beep time:
+"false id=<n> rxb=<microseconds>". Acks arrive on the trigger feed or on <FEED_KEY>-ack depending
+on the firmware's ACK_MODE; both are watched. For each rate it reports round-trip p50/p99, the device-side
+rxb p50/p99, loss, and the throughput actually achieved.
+
+Run it once per firmware build (power save on/off, CPU 80 vs 240 MHz, ...) with --label and
+--csv so the rows line up for comparison:
+
+    python3 bench_latency.py --count 20 --rate 0.2 0.4 --label ps-on-80mhz --csv results.csv
+
+Triggers closer together than the firmware's TRIGGER_COALESCE_MS share one ack ("n=<count>"
+tells how many), so ids inside a burst show up as loss; keep the interval above the window when
+measuring latency, and go below it to check that bursts stay within the publish budget.
+
+With --lan the same triggers go straight to the beeper's UDP port instead (signed as described
+in include/LanTrigger.h), which measures the local fast path without the cloud round trip:
+
+    python3 bench_latency.py --lan beeper.local --count 50 --rate 5 --label lan
+
+Adafruit IO throttles free accounts at 30 publishes per minute, and the device's clears count
+too, so rates above ~0.25/s need a paid account. Throttle notices are counted in the report.
+"""
+
+import argparse
+import csv
+import hashlib
+import hmac
+import re
+import socket
+import ssl
+import threading
+import time
+from paho.mqtt import client as mqtt_client
+
+ADA_USERNAME = ""
+ADA_KEY = ""
+FEED_KEY = "beeper"
+
+BROKER = "io.adafruit.com"
+PORT = 8883  # TLS port
+
+LAN_PORT = 4210
+
+ACK_RE = re.compile(r"(?:false|ack) id=(\d+) rxb=(\d+)")
+
+
+def percentile(values, pct):
+    """Nearest-rank percentile, same definition as the firmware's Telemetry."""
+    if not values:
+        return float("nan")
+    ordered = sorted(values)
+    rank = max(1, -(-pct * len(ordered) // 100))
+    return ordered[rank - 1]
+
+
+def lan_key():
+    return hashlib.sha256(f"beeper-lan:{ADA_KEY}:{FEED_KEY}".encode()).digest()
+
+
+# names this sender's replay window on the beeper; must not contain spaces
+LAN_SRC = socket.gethostname().replace(" ", "-")[:32] or "bench"
+
+
+def lan_datagram(key, seq, trigger_id):
+    body = f"true seq={seq} id={trigger_id} src={LAN_SRC}".encode()
+    mac = hmac.new(key, body, hashlib.sha256).digest()[:16]
+    return body + b" mac=" + mac.hex().encode()
+
+
+def summarize(rate, count, got, elapsed):
+    rtt = [g[0] for g in got]
+    rxb = [g[1] for g in got]
+    return {
+        "rate": rate,
+        "sent": count,
+        "acked": len(got),
+        "loss_pct": 100.0 * (count - len(got)) / count,
+        "rtt_p50_ms": percentile(rtt, 50),
+        "rtt_p99_ms": percentile(rtt, 99),
+        "rtt_max_ms": max(rtt) if rtt else float("nan"),
+        "rxb_p50_us": percentile(rxb, 50),
+        "rxb_p99_us": percentile(rxb, 99),
+        "achieved_per_s": len(got) / elapsed if elapsed > 0 else 0.0,
+    }
+
+
+class Bench:
+    def __init__(self, topic, ack_topic):
+        self.topic = topic
+        self.ack_topic = ack_topic
+        self.sent = {}    # id -> perf_counter() at publish
+        self.acks = {}    # id -> (round trip ms, device rxb us)
+        self.throttled = 0
+        self.lock = threading.Lock()
+        self.subscribed = threading.Event()
+
+    def on_connect(self, client, userdata, flags, rc, properties=None):
+        if rc != 0:
+            print("Failed to connect, rc:", rc)
+            return
+        client.subscribe([(self.topic, 0), (self.ack_topic, 0), (f"{ADA_USERNAME}/throttle", 0), (f"{ADA_USERNAME}/errors", 0)])
+
+    def on_subscribe(self, client, userdata, mid, reason_codes, properties=None):
+        self.subscribed.set()
+
+    def on_message(self, client, userdata, msg):
+        now = time.perf_counter()
+        payload = msg.payload.decode(errors="replace")
+        if msg.topic not in (self.topic, self.ack_topic):
+            self.throttled += 1
+            print(f"[{msg.topic}] {payload}")
+            return
+        match = ACK_RE.search(payload)
+        if not match:
+            return
+        trigger_id, rxb_us = int(match.group(1)), int(match.group(2))
+        with self.lock:
+            sent_at = self.sent.get(trigger_id)
+            if sent_at is not None and trigger_id not in self.acks:
+                self.acks[trigger_id] = ((now - sent_at) * 1000.0, rxb_us)
+
+    def run(self, client, first_id, count, rate, timeout):
+        """Fires `count` triggers at `rate` per second; returns a result row."""
+        ids = range(first_id, first_id + count)
+        interval = 1.0 / rate
+        start = time.perf_counter()
+        for i, trigger_id in enumerate(ids):
+            # schedule against the start time so slow publishes don't stretch the interval
+            delay = start + i * interval - time.perf_counter()
+            if delay > 0:
+                time.sleep(delay)
+            with self.lock:
+                self.sent[trigger_id] = time.perf_counter()
+            client.publish(self.topic, f"true id={trigger_id}")
+        send_done = time.perf_counter()
+
+        deadline = send_done + timeout
+        while time.perf_counter() < deadline:
+            with self.lock:
+                if all(i in self.acks for i in ids):
+                    break
+            time.sleep(0.05)
+        elapsed = time.perf_counter() - start
+
+        with self.lock:
+            got = [self.acks[i] for i in ids if i in self.acks]
+        return summarize(rate, count, got, elapsed)
+
+
+class LanBench:
+    """Same measurement over the beeper's UDP port; one socket, acks read back on it."""
+
+    def __init__(self, host, port):
+        self.addr = (socket.gethostbyname(host), port)
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.key = lan_key()
+
+    def run(self, first_id, count, rate, timeout):
+        ids = range(first_id, first_id + count)
+        interval = 1.0 / rate
+        sent, acks = {}, {}
+        start = time.perf_counter()
+        next_send = 0
+        deadline = None
+        while len(acks) < count:
+            now = time.perf_counter()
+            if next_send < count and now >= start + next_send * interval:
+                trigger_id = ids[next_send]
+                sent[trigger_id] = now
+                self.sock.sendto(lan_datagram(self.key, time.time_ns() // 1000000, trigger_id), self.addr)
+                next_send += 1
+                if next_send == count:
+                    deadline = time.perf_counter() + timeout
+                continue
+            if deadline is not None and now >= deadline:
+                break
+            wait = (start + next_send * interval if next_send < count else deadline) - now
+            self.sock.settimeout(max(wait, 0.001))
+            try:
+                data, _ = self.sock.recvfrom(128)
+            except socket.timeout:
+                continue
+            match = ACK_RE.search(data.decode(errors="replace"))
+            if match:
+                trigger_id = int(match.group(1))
+                if trigger_id in sent and trigger_id not in acks:
+                    acks[trigger_id] = ((time.perf_counter() - sent[trigger_id]) * 1000.0, int(match.group(2)))
+        elapsed = time.perf_counter() - start
+        return summarize(rate, count, [acks[i] for i in ids if i in acks], elapsed)
+
+
+def print_row(label, row):
+    print(f"{label:>16} rate {row['rate']:5.2f}/s  acked {row['acked']}/{row['sent']} "
+          f"(loss {row['loss_pct']:.0f}%)  rtt p50 {row['rtt_p50_ms']:.0f} ms p99 {row['rtt_p99_ms']:.0f} ms  "
+          f"rxb p50 {row['rxb_p50_us']:.0f} us p99 {row['rxb_p99_us']:.0f} us  "
+          f"{row['achieved_per_s']:.2f} acks/s")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--count", type=int, default=20, help="triggers per rate")
+    parser.add_argument("--rate", type=float, nargs="+", default=[0.2], help="triggers per second, one run each")
+    parser.add_argument("--timeout", type=float, default=10.0, help="seconds to wait for acks after the last send")
+    parser.add_argument("--label", default="build", help="name of the firmware build under test")
+    parser.add_argument("--csv", help="append result rows to this CSV file")
+    parser.add_argument("--lan", metavar="HOST", help="trigger over the LAN UDP port on HOST instead of MQTT")
+    args = parser.parse_args()
+
+    # ids are unique per run so a late ack from a previous run can't be miscounted
+    next_id = int(time.time()) % 1000000 * 1000
+    rows = []
+
+    if args.lan:
+        lan = LanBench(args.lan, LAN_PORT)
+        for rate in args.rate:
+            row = lan.run(next_id, args.count, rate, args.timeout)
+            next_id += args.count
+            row["label"] = args.label
+            rows.append(row)
+            print_row(args.label, row)
+        write_csv(args.csv, rows)
+        return
+
+    topic = f"{ADA_USERNAME}/feeds/{FEED_KEY}"
+    bench = Bench(topic, f"{topic}-ack")
+
+    client = mqtt_client.Client(mqtt_client.CallbackAPIVersion.VERSION2, client_id=f"py-bench-{int(time.time())}")
+    client.username_pw_set(ADA_USERNAME, ADA_KEY)
+    client.tls_set(cert_reqs=ssl.CERT_REQUIRED)
+    client.on_connect = bench.on_connect
+    client.on_subscribe = bench.on_subscribe
+    client.on_message = bench.on_message
+    client.connect(BROKER, PORT)
+    client.loop_start()
+    if not bench.subscribed.wait(10):
+        print("Timed out waiting for the subscription.")
+        return
+
+    for rate in args.rate:
+        row = bench.run(client, next_id, args.count, rate, args.timeout)
+        next_id += args.count
+        row["label"] = args.label
+        rows.append(row)
+        print_row(args.label, row)
+
+    client.loop_stop()
+    client.disconnect()
+
+    if bench.throttled:
+        print(f"Broker sent {bench.throttled} throttle/error notices; lower --rate for clean numbers.")
+
+    write_csv(args.csv, rows)
+
+
+def write_csv(path, rows):
+    if not path:
+        return
+    fields = ["label", "rate", "sent", "acked", "loss_pct", "rtt_p50_ms", "rtt_p99_ms", "rtt_max_ms",
+              "rxb_p50_us", "rxb_p99_us", "achieved_per_s"]
+    with open(path, "a", newline="") as f:
+        writer = csv.DictWriter(f, fieldnames=fields)
+        if f.tell() == 0:
+            writer.writeheader()
+        writer.writerows(rows)
+
+
+if __name__ == "__main__":
+    main()
@@ -1,12 +1,32 @@
 """
-Simple MQTT publisher to Adafruit IO to trigger the beeper.
+MQTT publisher to Adafruit IO to trigger the beeper.
 
 Topic: <ADA_USERNAME>/feeds/<FEED_KEY>
 Port: 1883 (non-TLS) or 8883 (TLS). We'll use TLS (8883).
+
+From the command line it pings one or more feeds over a single connection:
+
+    python3 send_mqtt_ping.py                  # FEED_KEY below
+    python3 send_mqtt_ping.py kitchen garage   # several beepers at once
+
+From a bot, keep one Publisher around instead of connecting per ping. It holds a single TLS
+session, reconnects by itself, and trigger() returns straight away with a future that completes
+when the broker's PUBACK arrives (QoS 1), so a ping costs one round trip, not a handshake plus
+sleeps:
+
+    pub = Publisher(ADA_USERNAME, ADA_KEY)
+    pub.trigger("beeper").result(timeout=5)
+    Publisher.wait(pub.trigger_many(["kitchen", "garage"], "true melody=chime"))
+    pub.close()
+
+Pings published while the link is down are queued and go out after the reconnect.
 """
 
 import ssl
+import sys
+import threading
 import time
+from concurrent.futures import Future, wait as wait_futures
 from paho.mqtt import client as mqtt_client
 
 ADA_USERNAME = ""
@@ -16,30 +36,100 @@ FEED_KEY = "beeper"
 BROKER = "io.adafruit.com"
 PORT = 8883  # TLS port
 
-topic = f"{ADA_USERNAME}/feeds/{FEED_KEY}"
-client_id = f"py-trigger-{int(time.time())}"
-
-def on_connect(client, userdata, flags, rc):
-    if rc == 0:
-        print("Connected to MQTT broker")
-    else:
-        print("Failed to connect, rc:", rc)
-
-def main():
-    client = mqtt_client.Client(client_id=client_id)
-    client.username_pw_set(ADA_USERNAME, ADA_KEY)
-    client.tls_set()      # Use system CA certs
-    client.tls_insecure_set(False)  # change to True if cert issues
-    client.on_connect = on_connect
-    client.connect(BROKER, PORT)
-    client.loop_start()
-    time.sleep(1)
-    print("Publishing 'true' to", topic)
-    client.publish(topic, "true")
-    time.sleep(1)
-    client.loop_stop()
-    client.disconnect()
+
+class Publisher:
+    def __init__(self, username, key, broker=BROKER, port=PORT, client_id=None):
+        self.username = username
+        self.connected = threading.Event()
+        self._lock = threading.Lock()
+        self._pending = {}  # mid -> Future, until the PUBACK
+        self._early = set()  # PUBACKs that beat the mid being registered
+
+        self.client = mqtt_client.Client(
+            mqtt_client.CallbackAPIVersion.VERSION2,
+            client_id=client_id or f"py-trigger-{int(time.time())}",
+        )
+        self.client.username_pw_set(username, key)
+        self.client.tls_set(cert_reqs=ssl.CERT_REQUIRED)  # system CA certs
+        self.client.reconnect_delay_set(min_delay=1, max_delay=30)
+        self.client.on_connect = self._on_connect
+        self.client.on_disconnect = self._on_disconnect
+        self.client.on_publish = self._on_publish
+        self.client.connect_async(broker, port, keepalive=60)
+        self.client.loop_start()  # network thread; also does the reconnects
+
+    def topic(self, feed):
+        return feed if "/" in feed else f"{self.username}/feeds/{feed}"
+
+    def trigger(self, feed=FEED_KEY, payload="true"):
+        """Publish one ping without blocking. The Future resolves to the seconds until PUBACK."""
+        future = Future()
+        future.sent_at = time.monotonic()
+        # not under self._lock: paho may hold its own lock while it calls _on_publish
+        info = self.client.publish(self.topic(feed), payload, qos=1)
+        if info.rc not in (mqtt_client.MQTT_ERR_SUCCESS, mqtt_client.MQTT_ERR_NO_CONN):
+            future.set_exception(RuntimeError(f"publish to {feed} failed: {mqtt_client.error_string(info.rc)}"))
+            return future
+        with self._lock:
+            if info.mid in self._early:
+                self._early.discard(info.mid)
+                future.set_result(0.0)
+            else:
+                self._pending[info.mid] = future
+        return future
+
+    def trigger_many(self, feeds, payload="true"):
+        """Ping several device feeds back to back on the one connection; returns their Futures."""
+        return [self.trigger(feed, payload) for feed in feeds]
+
+    @staticmethod
+    def wait(futures, timeout=10):
+        """Block until every Future is done (or timeout). Returns (done, not_done)."""
+        return wait_futures(futures, timeout=timeout)
+
+    def close(self, timeout=5):
+        """Wait for outstanding PUBACKs (up to timeout), then disconnect."""
+        with self._lock:
+            outstanding = list(self._pending.values())
+        if outstanding:
+            wait_futures(outstanding, timeout=timeout)
+        self.client.disconnect()
+        self.client.loop_stop()
+
+    def _on_connect(self, client, userdata, flags, reason_code, properties=None):
+        if reason_code == 0:
+            self.connected.set()
+            print("Connected to MQTT broker")
+        else:
+            print("Failed to connect:", reason_code)
+
+    def _on_disconnect(self, client, userdata, flags, reason_code, properties=None):
+        self.connected.clear()
+        if reason_code != 0:
+            print("Disconnected (%s), reconnecting..." % reason_code)
+
+    def _on_publish(self, client, userdata, mid, reason_code=None, properties=None):
+        with self._lock:
+            future = self._pending.pop(mid, None)
+            if future is None:
+                self._early.add(mid)
+                return
+        future.set_result(time.monotonic() - future.sent_at)
+
+
+def main(feeds):
+    pub = Publisher(ADA_USERNAME, ADA_KEY)
+    futures = pub.trigger_many(feeds)
+    done, not_done = Publisher.wait(futures, timeout=15)
+    for feed, future in zip(feeds, futures):
+        if future in done and future.exception() is None:
+            print("Published 'true' to %s (PUBACK in %.0f ms)" % (pub.topic(feed), future.result() * 1000))
+        else:
+            print("No PUBACK for", pub.topic(feed))
+    pub.close()
     print("Done.")
+    return 0 if not not_done else 1
+
 
 if __name__ == "__main__":
-    main()
+    sys.exit(main(sys.argv[1:] or [FEED_KEY]))
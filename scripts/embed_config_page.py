@@ -0,0 +1,56 @@
+"""
+Gzip web/config_page.html into include/config_page_gz.h for the provisioning portal.
+
+Runs as a PlatformIO pre-build script (see extra_scripts in platformio.ini) and can also be run
+by hand:  python3 scripts/embed_config_page.py
+
+The page is served pre-compressed with Content-Encoding: gzip, so it fits in one or two
+packets on a weak softAP link. The ETag is a hash of the compressed bytes, so browsers
+revalidate with If-None-Match and get a 304 on repeat visits.
+"""
+
+import gzip
+import hashlib
+import os
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO/SCons
+    PROJECT_DIR = env["PROJECT_DIR"]  # noqa: F821
+except NameError:
+    PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+SRC = os.path.join(PROJECT_DIR, "web", "config_page.html")
+OUT = os.path.join(PROJECT_DIR, "include", "config_page_gz.h")
+
+
+def render(data: bytes) -> str:
+    gz = gzip.compress(data, compresslevel=9, mtime=0)
+    etag = '"%s"' % hashlib.sha1(gz).hexdigest()[:16]
+    rows = []
+    for i in range(0, len(gz), 16):
+        rows.append("  " + ", ".join("0x%02x" % b for b in gz[i:i + 16]) + ",")
+    return (
+        "// Generated by scripts/embed_config_page.py from web/config_page.html -- do not edit.\n"
+        "#pragma once\n"
+        "#include <stdint.h>\n"
+        "#include <stddef.h>\n\n"
+        "// %d bytes of HTML, %d gzipped\n"
+        "const uint8_t CONFIG_PAGE_GZ[] = {\n%s\n};\n"
+        "const size_t CONFIG_PAGE_GZ_LEN = sizeof(CONFIG_PAGE_GZ);\n"
+        "#define CONFIG_PAGE_ETAG \"%s\"\n"
+    ) % (len(data), len(gz), "\n".join(rows), etag.replace('"', '\\"'))
+
+
+def main():
+    with open(SRC, "rb") as f:
+        header = render(f.read())
+    if os.path.exists(OUT):
+        with open(OUT) as f:
+            if f.read() == header:
+                return
+    with open(OUT, "w") as f:
+        f.write(header)
+    print("Regenerated", os.path.relpath(OUT, PROJECT_DIR))
+
+
+main()
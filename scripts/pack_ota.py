@@ -0,0 +1,137 @@
+"""
+Compress a firmware image for over-the-air updates and print the signed request that starts one.
+
+Runs as a PlatformIO post-build script (see extra_scripts in platformio.ini), writing
+firmware.bin.zz next to firmware.bin after every build, and can also be run by hand:
+
+    python3 scripts/pack_ota.py .pio/build/esp32dev/firmware.bin --url https://example.com/fw.zz
+
+Upload the .zz anywhere reachable over HTTPS (with a public CA certificate and Range support,
+which GitHub releases and any static file host have), then publish the printed line to the
+"<FEED_KEY>-ota" feed. The device streams it through zlib inflate straight into flash and
+checks the size and SHA-256 below before it switches over.
+
+The request is signed with an ECDSA P-256 key (openssl does the crypto, so nothing needs
+installing). Create it once with
+
+    python3 scripts/pack_ota.py --keygen
+
+which writes the private key to ota_signing_key.pem (keep it; it is git-ignored) and its public
+half into include/ota_signing_key.h, then flash the next build by cable. Without the key the
+firmware refuses every update. Only "version=<n> size=<n> sha256=<hex>" is signed, so the URL
+can still be edited after the line is printed. The version is BEEPER_FIRMWARE_VERSION from
+include/firmware_version.h; a unit refuses any image not numbered above its own, so bump it for
+every release.
+"""
+
+import argparse
+import hashlib
+import os
+import re
+import subprocess
+import sys
+import zlib
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO/SCons
+    PROJECT_DIR = env["PROJECT_DIR"]  # noqa: F821
+except NameError:
+    PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+KEY = os.environ.get("OTA_SIGNING_KEY", os.path.join(PROJECT_DIR, "ota_signing_key.pem"))
+KEY_HEADER = os.path.join(PROJECT_DIR, "include", "ota_signing_key.h")
+VERSION_HEADER = os.path.join(PROJECT_DIR, "include", "firmware_version.h")
+
+
+def pack(path: str) -> tuple:
+    with open(path, "rb") as f:
+        image = f.read()
+    packed = zlib.compress(image, 9)
+    out = path + ".zz"
+    with open(out, "wb") as f:
+        f.write(packed)
+    return out, len(image), len(packed), hashlib.sha256(image).hexdigest()
+
+
+def firmware_version() -> int:
+    with open(VERSION_HEADER) as f:
+        m = re.search(r"^#define\s+BEEPER_FIRMWARE_VERSION\s+(\d+)", f.read(), re.M)
+    if not m:
+        sys.exit("no BEEPER_FIRMWARE_VERSION in %s" % VERSION_HEADER)
+    return int(m.group(1))
+
+
+def signed_text(version: int, size: int, sha256: str) -> str:
+    # must match otaRequestSignedText() in lib/BeeperCore/OtaRequest.cpp
+    return "version=%d size=%d sha256=%s" % (version, size, sha256.lower())
+
+
+def sign(text: str) -> str:
+    der = subprocess.run(["openssl", "dgst", "-sha256", "-sign", KEY], input=text.encode(),
+                         stdout=subprocess.PIPE, check=True).stdout
+    return der.hex()
+
+
+def request_line(url: str, version: int, size: int, sha256: str, sig: str) -> str:
+    return "url=%s %s sig=%s" % (url, signed_text(version, size, sha256), sig)
+
+
+def key_header(public_der: bytes) -> str:
+    rows = []
+    for i in range(0, len(public_der), 16):
+        rows.append("  " + ", ".join("0x%02x" % b for b in public_der[i:i + 16]) + ",")
+    return (
+        "// Generated by scripts/pack_ota.py --keygen -- do not edit.\n"
+        "// Public half of the OTA signing key (DER SubjectPublicKeyInfo, ECDSA P-256). Empty means\n"
+        "// no key was generated yet, and every OTA request is refused.\n"
+        "#pragma once\n"
+        "#include <stdint.h>\n"
+        "#include <stddef.h>\n\n"
+        "const uint8_t OTA_SIGNING_KEY[] = {\n%s\n};\n"
+        "const size_t OTA_SIGNING_KEY_LEN = %d;\n"
+    ) % ("\n".join(rows) or "  0x00,", len(public_der))
+
+
+def keygen() -> None:
+    if os.path.exists(KEY):
+        sys.exit("%s exists; delete it first to replace the key (devices then need it by cable)" % KEY)
+    subprocess.run(["openssl", "ecparam", "-name", "prime256v1", "-genkey", "-noout", "-out", KEY], check=True)
+    os.chmod(KEY, 0o600)
+    public_der = subprocess.run(["openssl", "ec", "-in", KEY, "-pubout", "-outform", "DER"],
+                                stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, check=True).stdout
+    with open(KEY_HEADER, "w") as f:
+        f.write(key_header(public_der))
+    print("Wrote %s and %s; rebuild and flash once by cable." % (KEY, os.path.relpath(KEY_HEADER, PROJECT_DIR)))
+
+
+def report(path: str, url: str) -> None:
+    out, size, packed, sha256 = pack(path)
+    print("OTA image %s: %d -> %d bytes (%.0f%%)" % (out, size, packed, 100.0 * packed / size))
+    if not os.path.exists(KEY):
+        print("  not signed: no %s (run scripts/pack_ota.py --keygen), the device will refuse it" % KEY)
+        return
+    version = firmware_version()
+    sig = sign(signed_text(version, size, sha256))
+    print("  " + request_line(url or "https://<host>/" + os.path.basename(out), version, size, sha256, sig))
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO/SCons
+
+    def _after_build(source, target, env):  # noqa: ARG001
+        report(str(target[0]), "")
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.bin", _after_build)  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+        parser.add_argument("firmware", nargs="?", help="firmware.bin from the PlatformIO build directory")
+        parser.add_argument("--url", default="", help="where the .zz will be served from")
+        parser.add_argument("--keygen", action="store_true", help="create the signing key pair")
+        args = parser.parse_args()
+        if args.keygen:
+            keygen()
+        elif args.firmware:
+            report(args.firmware, args.url)
+        else:
+            parser.error("firmware path or --keygen required")
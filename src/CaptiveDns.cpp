@@ -0,0 +1,50 @@
+#include "CaptiveDns.h"
+#include "DnsAnswer.h"
+#include "Log.h"
+
+#include <errno.h>
+#include <lwip/sockets.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const uint16_t DNS_PORT = 53;
+static const size_t DNS_MAX_PACKET = 512; // plain UDP DNS; EDNS clients still send small queries
+static const uint32_t DNS_TASK_STACK = 3072;
+
+bool CaptiveDns::begin(const uint8_t ipv4[4], UBaseType_t priority, BaseType_t core) {
+  memcpy(ip_, ipv4, sizeof(ip_));
+  sock_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (sock_ < 0) return false;
+
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(DNS_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(sock_, (sockaddr*)&addr, sizeof(addr)) != 0) {
+    LOGE("Captive DNS: bind failed (errno %d)", errno);
+    close(sock_);
+    sock_ = -1;
+    return false;
+  }
+
+  xTaskCreatePinnedToCore(taskEntry, "dns", DNS_TASK_STACK, this, priority, nullptr, core);
+  LOGI("Captive DNS answering with %u.%u.%u.%u", ip_[0], ip_[1], ip_[2], ip_[3]);
+  return true;
+}
+
+void CaptiveDns::taskEntry(void* self) {
+  static_cast<CaptiveDns*>(self)->run();
+}
+
+void CaptiveDns::run() {
+  static uint8_t query[DNS_MAX_PACKET];
+  static uint8_t reply[DNS_MAX_PACKET];
+  for (;;) {
+    sockaddr_in from = {};
+    socklen_t fromLen = sizeof(from);
+    int n = recvfrom(sock_, query, sizeof(query), 0, (sockaddr*)&from, &fromLen);
+    if (n <= 0) continue;
+    size_t len = dnsAnswerA(query, (size_t)n, ip_, reply, sizeof(reply));
+    if (len > 0) sendto(sock_, reply, len, 0, (sockaddr*)&from, fromLen);
+  }
+}
@@ -0,0 +1,173 @@
+#include "EspNowRelay.h"
+#include "Log.h"
+
+#include <WiFi.h>
+#include "esp_now.h"
+#include "esp_wifi.h"
+#include "esp_idf_version.h"
+
+static const char KEY_LABEL[] = "beeper-espnow:";
+static const uint8_t FRAME_MAGIC = 0xBE;
+static const uint8_t FRAME_TRIGGER = 1;
+static const uint8_t FRAME_BEACON = 2;
+static const uint8_t BROADCAST[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+// esp_now delivers to a plain function; there is only ever one relay
+static EspNowRelay* instance = nullptr;
+
+void EspNowRelay::setKey(const char* aioKey, const char* feedKey) {
+  auth_.setKey(KEY_LABEL, aioKey, feedKey);
+}
+
+void EspNowRelay::sign(Frame& f) const {
+  auth_.sign(&f, offsetof(Frame, mac), f.mac, sizeof(f.mac));
+}
+
+bool EspNowRelay::authentic(const Frame& f) const {
+  return auth_.verify(&f, offsetof(Frame, mac), f.mac, sizeof(f.mac));
+}
+
+void EspNowRelay::send(const Frame& f) {
+  esp_now_send(BROADCAST, (const uint8_t*)&f, sizeof(f));
+}
+
+#if ESP_IDF_VERSION_MAJOR >= 5
+static void recvCb(const esp_now_recv_info_t*, const uint8_t* data, int len) {
+#else
+static void recvCb(const uint8_t*, const uint8_t* data, int len) {
+#endif
+  if (instance) instance->onReceive(data, len);
+}
+
+bool EspNowRelay::begin(bool gateway, TriggerFn onTrigger) {
+  if (!auth_.haveKey() || (gateway ? session_ == 0 : window_ == nullptr)) {
+    LOGW("ESP-NOW relay: no key, session or replay window, not starting.");
+    return false;
+  }
+  gateway_ = gateway;
+  onTrigger_ = onTrigger;
+  instance = this;
+  esp_wifi_get_mac(WIFI_IF_STA, ownMac_);
+
+  if (esp_now_init() != ESP_OK) {
+    LOGE("ESP-NOW init failed.");
+    return false;
+  }
+  // All frames go out as broadcasts; targeting is inside the (authenticated) frame, which
+  // also means no per-leaf peer table has to be managed.
+  esp_now_peer_info_t peer = {};
+  memcpy(peer.peer_addr, BROADCAST, sizeof(BROADCAST));
+  peer.channel = 0; // whatever channel the radio is on
+  peer.ifidx = WIFI_IF_STA;
+  peer.encrypt = false;
+  esp_now_add_peer(&peer);
+  esp_now_register_recv_cb(recvCb);
+
+  if (gateway_) {
+    esp_timer_create_args_t args = {};
+    args.callback = repeatCb;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "relay_rep";
+    esp_timer_create(&args, &repeatTimer_);
+    args.callback = beaconCb;
+    args.name = "relay_bcn";
+    esp_timer_create(&args, &beaconTimer_);
+    esp_timer_start_periodic(beaconTimer_, (uint64_t)BEACON_INTERVAL_MS * 1000);
+  }
+  return true;
+}
+
+void EspNowRelay::relayTrigger(const uint8_t* target, uint32_t triggerId, uint8_t melody) {
+  if (!gateway_ || !repeatTimer_) return;
+  Frame f = {};
+  f.magic = FRAME_MAGIC;
+  f.type = FRAME_TRIGGER;
+  memcpy(f.target, target ? target : BROADCAST, sizeof(f.target));
+  memcpy(f.source, ownMac_, sizeof(f.source));
+  f.session = session_;
+  f.triggerId = triggerId;
+  f.melody = melody;
+
+  portENTER_CRITICAL(&mux_);
+  f.seq = ++seq_;
+  portEXIT_CRITICAL(&mux_);
+  sign(f); // outside the critical section: the SHA peripheral is guarded by a mutex
+
+  portENTER_CRITICAL(&mux_);
+  pending_ = f;
+  repeatsLeft_ = repeatCount_;
+  portEXIT_CRITICAL(&mux_);
+
+  send(f);
+  esp_timer_stop(repeatTimer_);
+  esp_timer_start_periodic(repeatTimer_, (uint64_t)repeatIntervalMs_ * 1000);
+}
+
+void EspNowRelay::repeatCb(void* self) {
+  EspNowRelay* r = static_cast<EspNowRelay*>(self);
+  Frame f;
+  portENTER_CRITICAL(&r->mux_);
+  bool more = r->repeatsLeft_ > 0;
+  if (more) r->repeatsLeft_--;
+  f = r->pending_;
+  portEXIT_CRITICAL(&r->mux_);
+  if (more) {
+    r->send(f);
+  } else {
+    esp_timer_stop(r->repeatTimer_);
+  }
+}
+
+void EspNowRelay::beaconCb(void* self) {
+  EspNowRelay* r = static_cast<EspNowRelay*>(self);
+  Frame f = {};
+  f.magic = FRAME_MAGIC;
+  f.type = FRAME_BEACON;
+  uint8_t primary = 0;
+  wifi_second_chan_t second;
+  esp_wifi_get_channel(&primary, &second);
+  f.channel = primary;
+  memcpy(f.target, BROADCAST, sizeof(f.target));
+  memcpy(f.source, r->ownMac_, sizeof(f.source));
+  f.session = r->session_;
+  r->sign(f);
+  r->send(f);
+}
+
+void EspNowRelay::onReceive(const uint8_t* data, int len) {
+  if (gateway_ || len != (int)sizeof(Frame)) return;
+  Frame f;
+  memcpy(&f, data, sizeof(f));
+  if (f.magic != FRAME_MAGIC || !authentic(f)) return;
+  int64_t now = esp_timer_get_time();
+  lastHeardUs_ = now;
+
+  if (f.type == FRAME_BEACON) {
+    if (channel_ == 0) channel_ = f.channel;
+    return;
+  }
+  if (f.type != FRAME_TRIGGER) return;
+  if (memcmp(f.target, BROADCAST, 6) != 0 && memcmp(f.target, ownMac_, 6) != 0) return;
+  // repeats of the trigger we already played, and recordings of older ones: session:seq only
+  // grows per gateway, across its reboots and ours
+  uint64_t mark = ((uint64_t)f.session << 32) | f.seq;
+  if (!replayWindowAccept(*window_, replaySenderId((const char*)f.source, sizeof(f.source)), mark)) return;
+  if (onWindowChanged_) onWindowChanged_(*window_);
+  onTrigger_(f.triggerId, f.melody, now);
+}
+
+bool EspNowRelay::findGateway(uint32_t dwellMs) {
+  channel_ = 0;
+  for (uint8_t ch = 1; ch <= 13; ch++) {
+    esp_wifi_set_channel(ch, WIFI_SECOND_CHAN_NONE);
+    uint32_t start = millis();
+    while (channel_ == 0 && millis() - start < dwellMs) delay(10);
+    if (channel_ != 0) {
+      esp_wifi_set_channel(channel_, WIFI_SECOND_CHAN_NONE);
+      LOGI("ESP-NOW gateway found on channel %u", (unsigned)channel_);
+      return true;
+    }
+  }
+  return false;
+}
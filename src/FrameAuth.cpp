@@ -0,0 +1,37 @@
+#include "FrameAuth.h"
+
+#include "mbedtls/md.h"
+
+void FrameAuth::setKey(const char* label, const char* aioKey, const char* feedKey) {
+  const mbedtls_md_info_t* sha = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+  mbedtls_md_context_t ctx;
+  mbedtls_md_init(&ctx);
+  haveKey_ = aioKey[0] != '\0' &&
+             mbedtls_md_setup(&ctx, sha, 0) == 0 &&
+             mbedtls_md_starts(&ctx) == 0 &&
+             mbedtls_md_update(&ctx, (const unsigned char*)label, strlen(label)) == 0 &&
+             mbedtls_md_update(&ctx, (const unsigned char*)aioKey, strlen(aioKey)) == 0 &&
+             mbedtls_md_update(&ctx, (const unsigned char*)":", 1) == 0 &&
+             mbedtls_md_update(&ctx, (const unsigned char*)feedKey, strlen(feedKey)) == 0 &&
+             mbedtls_md_finish(&ctx, key_) == 0;
+  mbedtls_md_free(&ctx);
+}
+
+bool FrameAuth::sign(const void* data, size_t len, uint8_t* tag, size_t tagLen) const {
+  uint8_t full[32];
+  if (!haveKey_ || tagLen > sizeof(full) ||
+      mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), key_, sizeof(key_),
+                      (const unsigned char*)data, len, full) != 0) {
+    return false;
+  }
+  memcpy(tag, full, tagLen);
+  return true;
+}
+
+bool FrameAuth::verify(const void* data, size_t len, const uint8_t* tag, size_t tagLen) const {
+  uint8_t expected[32];
+  if (!sign(data, len, expected, tagLen)) return false;
+  uint8_t diff = 0;
+  for (size_t i = 0; i < tagLen; i++) diff |= tag[i] ^ expected[i];
+  return diff == 0;
+}
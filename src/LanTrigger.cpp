@@ -0,0 +1,92 @@
+#include "LanTrigger.h"
+#include "Log.h"
+
+#include <errno.h>
+#include <lwip/sockets.h>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char KEY_LABEL[] = "beeper-lan:";
+static const size_t MAX_DATAGRAM = 192;
+static const uint32_t LAN_TASK_STACK = 4096;
+
+void LanTrigger::setKey(const char* aioKey, const char* feedKey) {
+  auth_.setKey(KEY_LABEL, aioKey, feedKey);
+}
+
+bool LanTrigger::verify(const char* msg, size_t len, LanDatagram& out) const {
+  return lanDatagramParse(msg, len, out) && auth_.verify(msg, out.signedLen, out.mac, sizeof(out.mac));
+}
+
+bool LanTrigger::begin(uint16_t port, TriggerFn onTrigger, UBaseType_t priority, BaseType_t core) {
+  if (!auth_.haveKey() || !window_) {
+    LOGW("LAN trigger: no key or replay window, not starting.");
+    return false;
+  }
+  sock_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (sock_ < 0) return false;
+
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(sock_, (sockaddr*)&addr, sizeof(addr)) != 0) {
+    LOGE("LAN trigger: bind failed (errno %d)", errno);
+    close(sock_);
+    sock_ = -1;
+    return false;
+  }
+
+  onTrigger_ = onTrigger;
+  xTaskCreatePinnedToCore(taskEntry, "lan", LAN_TASK_STACK, this, priority, nullptr, core);
+  LOGI("LAN trigger listening on UDP %u", (unsigned)port);
+  return true;
+}
+
+void LanTrigger::taskEntry(void* self) {
+  static_cast<LanTrigger*>(self)->run();
+}
+
+void LanTrigger::run() {
+  char buf[MAX_DATAGRAM];
+  for (;;) {
+    sockaddr_in from = {};
+    socklen_t fromLen = sizeof(from);
+    int n = recvfrom(sock_, buf, sizeof(buf), 0, (sockaddr*)&from, &fromLen);
+    if (n <= 0) continue;
+    int64_t rxUs = esp_timer_get_time();
+
+    LanDatagram d;
+    if (!verify(buf, (size_t)n, d)) {
+      LOGW("LAN trigger: rejected datagram.");
+      continue;
+    }
+    if (!replayWindowAccept(*window_, replaySenderId(d.src, d.srcLen), d.seq)) {
+      LOGW("LAN trigger: replayed seq, dropped.");
+      continue;
+    }
+
+    portENTER_CRITICAL(&mux_);
+    replyAddr_ = from.sin_addr.s_addr;
+    replyPort_ = from.sin_port;
+    portEXIT_CRITICAL(&mux_);
+
+    onTrigger_(d.triggerId, rxUs);
+    if (onWindowChanged_) onWindowChanged_(*window_);
+  }
+}
+
+void LanTrigger::sendAck(uint32_t triggerId, uint32_t rxToBeepUs) {
+  sockaddr_in to = {};
+  to.sin_family = AF_INET;
+  portENTER_CRITICAL(&mux_);
+  to.sin_addr.s_addr = replyAddr_;
+  to.sin_port = replyPort_;
+  portEXIT_CRITICAL(&mux_);
+  if (sock_ < 0 || to.sin_port == 0) return;
+
+  char msg[48];
+  int len = snprintf(msg, sizeof(msg), "ack id=%lu rxb=%lu", (unsigned long)triggerId, (unsigned long)rxToBeepUs);
+  sendto(sock_, msg, (size_t)len, 0, (sockaddr*)&to, sizeof(to));
+}
@@ -0,0 +1,160 @@
+#include "Log.h"
+
+#include <atomic>
+#include <stdarg.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+static const size_t LOG_SLOTS = 32;         // power of two
+static const size_t LOG_LINE_MAX = 120;
+static const size_t LOG_RECENT_MAX = 256;
+static const uint32_t LOG_TASK_STACK = 2048;
+static const uint32_t LOG_IDLE_POLL_MS = 20;
+static const uint32_t LOG_FLUSH_TIMEOUT_MS = 500;
+
+static_assert((LOG_SLOTS & (LOG_SLOTS - 1)) == 0, "LOG_SLOTS must be a power of two");
+
+// Each slot's sequence says whose turn it is: == pos means free for the producer claiming pos,
+// == pos + 1 means filled and ready for the consumer.
+struct LogSlot {
+  std::atomic<uint32_t> sequence;
+  uint8_t len;
+  char text[LOG_LINE_MAX];
+};
+
+static LogSlot slots[LOG_SLOTS];
+static std::atomic<uint32_t> enqueuePos(0);
+static std::atomic<uint32_t> dequeuePos(0); // single consumer: the drain task once it runs
+static std::atomic<uint32_t> dropped(0);
+static std::atomic<bool> ringReady(false);
+static TaskHandle_t drainTask = nullptr;
+
+static char recent[LOG_RECENT_MAX];
+static size_t recentLen = 0;
+static portMUX_TYPE recentMux = portMUX_INITIALIZER_UNLOCKED;
+
+static const char LEVEL_TAGS[] = { '-', 'E', 'W', 'I', 'D' };
+
+// First use may come from any task, so the slot sequences are set up under a lock once
+static void initRing() {
+  static portMUX_TYPE initMux = portMUX_INITIALIZER_UNLOCKED;
+  portENTER_CRITICAL(&initMux);
+  if (!ringReady.load(std::memory_order_relaxed)) {
+    for (size_t i = 0; i < LOG_SLOTS; i++) slots[i].sequence.store((uint32_t)i, std::memory_order_relaxed);
+    ringReady.store(true, std::memory_order_release);
+  }
+  portEXIT_CRITICAL(&initMux);
+}
+
+static void keepRecent(const char* line, size_t len) {
+  portENTER_CRITICAL(&recentMux);
+  if (recentLen + len + 1 > LOG_RECENT_MAX) recentLen = 0; // keep the newest, not a torn mix
+  if (len + 1 <= LOG_RECENT_MAX) {
+    memcpy(recent + recentLen, line, len);
+    recentLen += len;
+    recent[recentLen++] = '\n';
+  }
+  portEXIT_CRITICAL(&recentMux);
+}
+
+void logWrite(uint8_t level, const char* fmt, ...) {
+  if (!ringReady.load(std::memory_order_acquire)) initRing();
+
+  char line[LOG_LINE_MAX];
+  int n = snprintf(line, sizeof(line), "%lu %c ", (unsigned long)(esp_timer_get_time() / 1000),
+                   LEVEL_TAGS[level < sizeof(LEVEL_TAGS) ? level : 0]);
+  va_list ap;
+  va_start(ap, fmt);
+  int m = vsnprintf(line + n, sizeof(line) - n, fmt, ap);
+  va_end(ap);
+  size_t len = (size_t)n + (m < 0 ? 0 : (size_t)m);
+  if (len > sizeof(line) - 1) len = sizeof(line) - 1;
+
+  if (level <= LOG_LEVEL_WARN) keepRecent(line, len);
+
+  // claim a slot
+  uint32_t pos = enqueuePos.load(std::memory_order_relaxed);
+  LogSlot* slot;
+  for (;;) {
+    slot = &slots[pos & (LOG_SLOTS - 1)];
+    uint32_t seq = slot->sequence.load(std::memory_order_acquire);
+    int32_t diff = (int32_t)(seq - pos);
+    if (diff == 0) {
+      if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+    } else if (diff < 0) {
+      dropped.fetch_add(1, std::memory_order_relaxed); // full
+      return;
+    } else {
+      pos = enqueuePos.load(std::memory_order_relaxed);
+    }
+  }
+  memcpy(slot->text, line, len);
+  slot->len = (uint8_t)len;
+  slot->sequence.store(pos + 1, std::memory_order_release);
+  if (drainTask) xTaskNotifyGive(drainTask);
+}
+
+// Writes one queued line to Serial, if there is one
+static bool drainOne() {
+  uint32_t pos = dequeuePos.load(std::memory_order_relaxed);
+  LogSlot* slot = &slots[pos & (LOG_SLOTS - 1)];
+  if (slot->sequence.load(std::memory_order_acquire) != pos + 1) return false;
+  Serial.write((const uint8_t*)slot->text, slot->len);
+  Serial.write('\n');
+  slot->sequence.store(pos + LOG_SLOTS, std::memory_order_release);
+  dequeuePos.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+static void drainLoop(void*) {
+  uint32_t reportedDrops = 0;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOG_IDLE_POLL_MS * 50));
+    while (drainOne()) {}
+    uint32_t d = dropped.load(std::memory_order_relaxed);
+    if (d != reportedDrops) {
+      Serial.printf("[log: %lu lines dropped]\n", (unsigned long)(d - reportedDrops));
+      reportedDrops = d;
+    }
+  }
+}
+
+void logBegin(UBaseType_t priority, BaseType_t core) {
+  if (!ringReady.load(std::memory_order_acquire)) initRing();
+  xTaskCreatePinnedToCore(drainLoop, "log", LOG_TASK_STACK, nullptr, priority, &drainTask, core);
+}
+
+void logFlush() {
+  if (!ringReady.load(std::memory_order_acquire)) return;
+  if (!drainTask) {
+    while (drainOne()) {} // before logBegin() the caller is the only consumer
+  } else if (xTaskGetCurrentTaskHandle() != drainTask) {
+    // The drain task stays the only consumer (stopping it could leave it holding the UART or
+    // halfway through a slot); wake it and wait, bounded, for it to catch up.
+    uint32_t target = enqueuePos.load(std::memory_order_acquire);
+    TickType_t start = xTaskGetTickCount();
+    while ((int32_t)(dequeuePos.load(std::memory_order_acquire) - target) < 0 &&
+           xTaskGetTickCount() - start < pdMS_TO_TICKS(LOG_FLUSH_TIMEOUT_MS)) {
+      xTaskNotifyGive(drainTask);
+      vTaskDelay(1);
+    }
+  }
+  Serial.flush();
+}
+
+size_t logTakeRecent(char* buf, size_t len) {
+  if (len == 0) return 0;
+  portENTER_CRITICAL(&recentMux);
+  size_t n = recentLen < len - 1 ? recentLen : len - 1;
+  memcpy(buf, recent, n);
+  recentLen = 0;
+  portEXIT_CRITICAL(&recentMux);
+  if (n > 0 && buf[n - 1] == '\n') n--;
+  buf[n] = '\0';
+  return n;
+}
+
+uint32_t logDropped() {
+  return dropped.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,266 @@
+#include "OtaUpdater.h"
+#include "Log.h"
+
+#include "esp_http_client.h"
+#include "esp_crt_bundle.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_heap_caps.h"
+#include "esp32/rom/miniz.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mbedtls/md.h"
+#include "mbedtls/pk.h"
+#include "firmware_version.h"
+#include "ota_signing_key.h"
+
+static const uint32_t OTA_TASK_STACK = 8192;      // TLS handshake + HTTP client
+static const size_t OTA_READ_CHUNK = 4096;
+static const size_t OTA_MIN_FREE_HEAP = 90 * 1024; // inflate window + state + a second TLS session
+static const int OTA_HTTP_TIMEOUT_MS = 15000;
+static const uint8_t OTA_MAX_RESUMES = 8;
+static const uint32_t OTA_RESUME_BASE_MS = 2000;
+static const uint8_t OTA_MAX_REDIRECTS = 3;
+
+// The signed text is rebuilt from the parsed fields, so only the canonical form verifies
+bool OtaUpdater::signatureValid(const Request& req) {
+  if (OTA_SIGNING_KEY_LEN == 0) {
+    LOGE("OTA: no signing key built in (scripts/pack_ota.py --keygen), refusing.");
+    return false;
+  }
+  char text[OtaRequest::SIGNED_TEXT_MAX];
+  size_t n = otaRequestSignedText(req, text);
+
+  uint8_t hash[32];
+  mbedtls_pk_context key;
+  mbedtls_pk_init(&key);
+  bool ok = mbedtls_md(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), (const uint8_t*)text, n, hash) == 0 &&
+            mbedtls_pk_parse_public_key(&key, OTA_SIGNING_KEY, OTA_SIGNING_KEY_LEN) == 0 &&
+            mbedtls_pk_can_do(&key, MBEDTLS_PK_ECDSA) &&
+            mbedtls_pk_verify(&key, MBEDTLS_MD_SHA256, hash, sizeof(hash), req.sig, req.sigLen) == 0;
+  mbedtls_pk_free(&key);
+  return ok;
+}
+
+bool OtaUpdater::start(const Request& req, DoneFn onDone, HoldFn hold, UBaseType_t priority, BaseType_t core) {
+  if (busy_) return false;
+  if (heap_caps_get_free_size(MALLOC_CAP_8BIT) < OTA_MIN_FREE_HEAP) {
+    LOGE("OTA: not enough free heap (%u), not starting.", (unsigned)heap_caps_get_free_size(MALLOC_CAP_8BIT));
+    return false;
+  }
+  req_ = req;
+  onDone_ = onDone;
+  hold_ = hold;
+  busy_ = true;
+  if (xTaskCreatePinnedToCore(taskEntry, "ota", OTA_TASK_STACK, this, priority, nullptr, core) != pdPASS) {
+    busy_ = false;
+    return false;
+  }
+  return true;
+}
+
+void OtaUpdater::taskEntry(void* self) {
+  OtaUpdater* ota = static_cast<OtaUpdater*>(self);
+  if (ota->hold_) ota->hold_(true);
+  bool ok = ota->run();
+  if (ota->hold_) ota->hold_(false);
+  ota->busy_ = false;
+  if (ota->onDone_) ota->onDone_(ok);
+  vTaskDelete(nullptr);
+}
+
+void OtaUpdater::confirmRunningImage() {
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  esp_ota_img_states_t state;
+  if (esp_ota_get_state_partition(running, &state) == ESP_OK && state == ESP_OTA_IMG_PENDING_VERIFY) {
+    esp_ota_mark_app_valid_cancel_rollback();
+    LOGI("OTA: new firmware confirmed.");
+  }
+}
+
+// Opens the GET at `offset` of the compressed image, following redirects. 206 is required
+// when resuming; a server that ignores Range can only be used from the start.
+static bool openAt(esp_http_client_handle_t client, uint32_t offset) {
+  char range[32];
+  if (offset > 0) {
+    snprintf(range, sizeof(range), "bytes=%lu-", (unsigned long)offset);
+    esp_http_client_set_header(client, "Range", range);
+  }
+  for (uint8_t redirects = 0; redirects <= OTA_MAX_REDIRECTS; redirects++) {
+    if (esp_http_client_open(client, 0) != ESP_OK) return false;
+    esp_http_client_fetch_headers(client);
+    int status = esp_http_client_get_status_code(client);
+    if (status == 206 || (status == 200 && offset == 0)) return true;
+    esp_http_client_close(client);
+    if (status < 300 || status >= 400 || esp_http_client_set_redirection(client) != ESP_OK) {
+      LOGE("OTA: HTTP %d", status);
+      return false;
+    }
+  }
+  return false;
+}
+
+// True if the first req.size bytes of the running partition hash to req.sha256: flashing it
+// would only restart into the same image.
+static bool matchesRunning(const OtaRequest& req, uint8_t* buf, size_t bufLen) {
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  if (!running || req.size > running->size) return false;
+  mbedtls_md_context_t sha;
+  mbedtls_md_init(&sha);
+  bool ok = mbedtls_md_setup(&sha, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 0) == 0 &&
+            mbedtls_md_starts(&sha) == 0;
+  for (uint32_t ofs = 0; ok && ofs < req.size; ofs += bufLen) {
+    size_t n = req.size - ofs < bufLen ? req.size - ofs : bufLen;
+    ok = esp_partition_read(running, ofs, buf, n) == ESP_OK && mbedtls_md_update(&sha, buf, n) == 0;
+  }
+  uint8_t digest[32];
+  ok = ok && mbedtls_md_finish(&sha, digest) == 0 && memcmp(digest, req.sha256, sizeof(digest)) == 0;
+  mbedtls_md_free(&sha);
+  return ok;
+}
+
+bool OtaUpdater::run() {
+  // verified here rather than in start(): a P-256 verify is too slow for the network task
+  if (!signatureValid(req_)) {
+    LOGE("OTA: request signature invalid, not flashing.");
+    return false;
+  }
+  if (req_.version <= BEEPER_FIRMWARE_VERSION) {
+    LOGE("OTA: v%lu is not newer than the running v%lu, refusing.", (unsigned long)req_.version,
+         (unsigned long)BEEPER_FIRMWARE_VERSION);
+    return false;
+  }
+  const esp_partition_t* target = esp_ota_get_next_update_partition(nullptr);
+  if (!target || req_.size > target->size) {
+    LOGE("OTA: no partition for a %lu byte image.", (unsigned long)req_.size);
+    return false;
+  }
+
+  tinfl_decompressor* inflater = (tinfl_decompressor*)malloc(sizeof(tinfl_decompressor));
+  uint8_t* window = (uint8_t*)malloc(TINFL_LZ_DICT_SIZE);
+  uint8_t* in = (uint8_t*)malloc(OTA_READ_CHUNK);
+  esp_http_client_config_t cfg = {};
+  cfg.url = req_.url;
+  cfg.timeout_ms = OTA_HTTP_TIMEOUT_MS;
+  cfg.crt_bundle_attach = esp_crt_bundle_attach;
+  esp_http_client_handle_t client = esp_http_client_init(&cfg);
+
+  const mbedtls_md_info_t* shaInfo = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+  mbedtls_md_context_t sha;
+  mbedtls_md_init(&sha);
+
+  esp_ota_handle_t ota = 0;
+  bool otaBegun = false;
+  bool ok = false;
+  bool done = false;
+  uint32_t received = 0;   // compressed bytes taken off the wire; where a resume starts
+  uint32_t written = 0;    // decompressed bytes flashed
+  uint32_t nextReport = req_.size / 10;
+  size_t windowOfs = 0;
+  uint8_t resumes = 0;
+
+  if (!inflater || !window || !in || !client || mbedtls_md_setup(&sha, shaInfo, 0) != 0 ||
+      mbedtls_md_starts(&sha) != 0) {
+    LOGE("OTA: out of memory.");
+    goto cleanup;
+  }
+  if (matchesRunning(req_, in, OTA_READ_CHUNK)) {
+    LOGE("OTA: that image is the one running, refusing.");
+    goto cleanup;
+  }
+  tinfl_init(inflater);
+  // sequential writes: flash is erased sector by sector as data arrives, not all up front
+  if (esp_ota_begin(target, OTA_WITH_SEQUENTIAL_WRITES, &ota) != ESP_OK) {
+    LOGE("OTA: esp_ota_begin failed.");
+    goto cleanup;
+  }
+  otaBegun = true;
+  LOGI("OTA: %lu bytes into %s from %s", (unsigned long)req_.size, target->label, req_.url);
+
+  while (!done) {
+    if (!openAt(client, received)) {
+      if (++resumes > OTA_MAX_RESUMES) goto cleanup;
+      vTaskDelay(pdMS_TO_TICKS(OTA_RESUME_BASE_MS * resumes));
+      continue;
+    }
+
+    for (;;) {
+      int n = esp_http_client_read(client, (char*)in, OTA_READ_CHUNK);
+      if (n <= 0) break; // end of body, or the link went away
+      received += (uint32_t)n;
+
+      size_t inPos = 0;
+      tinfl_status status;
+      do {
+        size_t inBytes = (size_t)n - inPos;
+        size_t outBytes = TINFL_LZ_DICT_SIZE - windowOfs;
+        status = tinfl_decompress(inflater, in + inPos, &inBytes, window, window + windowOfs, &outBytes,
+                                  TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+        inPos += inBytes;
+        if (outBytes > 0) {
+          if (written + outBytes > req_.size) {
+            LOGE("OTA: image larger than announced.");
+            goto cleanup;
+          }
+          if (esp_ota_write(ota, window + windowOfs, outBytes) != ESP_OK ||
+              mbedtls_md_update(&sha, window + windowOfs, outBytes) != 0) {
+            LOGE("OTA: flash write failed.");
+            goto cleanup;
+          }
+          written += outBytes;
+          windowOfs = (windowOfs + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+        if (status < TINFL_STATUS_DONE) {
+          LOGE("OTA: corrupt compressed stream (%d).", (int)status);
+          goto cleanup;
+        }
+        if (status == TINFL_STATUS_DONE) done = true;
+      } while (!done && (inPos < (size_t)n || status == TINFL_STATUS_HAS_MORE_OUTPUT));
+
+      if (written >= nextReport) {
+        LOGI("OTA: %lu%% (%lu compressed bytes)", (unsigned long)((uint64_t)written * 100 / req_.size),
+             (unsigned long)received);
+        nextReport += req_.size / 10;
+      }
+      if (done) break;
+    }
+    esp_http_client_close(client);
+    if (!done) {
+      if (++resumes > OTA_MAX_RESUMES) {
+        LOGE("OTA: giving up after %u resumes.", (unsigned)OTA_MAX_RESUMES);
+        goto cleanup;
+      }
+      LOGW("OTA: connection lost at %lu bytes, resuming.", (unsigned long)received);
+      vTaskDelay(pdMS_TO_TICKS(OTA_RESUME_BASE_MS * resumes));
+    }
+  }
+
+  {
+    uint8_t digest[32];
+    if (written != req_.size || mbedtls_md_finish(&sha, digest) != 0 ||
+        memcmp(digest, req_.sha256, sizeof(digest)) != 0) {
+      LOGE("OTA: size or SHA-256 mismatch, discarding image.");
+      goto cleanup;
+    }
+  }
+  otaBegun = false;
+  if (esp_ota_end(ota) != ESP_OK) {
+    LOGE("OTA: image failed validation.");
+    goto cleanup;
+  }
+  if (esp_ota_set_boot_partition(target) != ESP_OK) {
+    LOGE("OTA: could not switch boot partition.");
+    goto cleanup;
+  }
+  LOGI("OTA: done, %lu bytes downloaded for %lu flashed.", (unsigned long)received, (unsigned long)written);
+  ok = true;
+
+cleanup:
+  if (otaBegun) esp_ota_abort(ota);
+  mbedtls_md_free(&sha);
+  if (client) esp_http_client_cleanup(client);
+  free(in);
+  free(window);
+  free(inflater);
+  return ok;
+}
@@ -0,0 +1,81 @@
+#include "Telemetry.h"
+
+#include <algorithm>
+#include "esp_heap_caps.h"
+#include "TelemetrySummary.h"
+
+Telemetry telemetry;
+
+static_assert(TM_METRIC_COUNT <= TelemetrySummary::MAX_METRICS, "TelemetrySummary can't hold every metric");
+
+static const char* const METRIC_NAMES[TM_METRIC_COUNT] = {
+  "assoc", "dhcp", "tls", "conn", "sub", "rxb_us", "rtt", "boot",
+};
+
+const char* Telemetry::metricName(TelemetryMetric m) {
+  return m < TM_METRIC_COUNT ? METRIC_NAMES[m] : "?";
+}
+
+void Telemetry::record(TelemetryMetric m, uint32_t value) {
+  if (m >= TM_METRIC_COUNT) return;
+  portENTER_CRITICAL(&mux_);
+  Ring& r = rings_[m];
+  r.samples[r.next] = value;
+  r.next = (r.next + 1) % TELEMETRY_WINDOW;
+  if (r.count < TELEMETRY_WINDOW) r.count++;
+  portEXIT_CRITICAL(&mux_);
+}
+
+void Telemetry::count(TelemetryCounter c, uint32_t n) {
+  if (c >= TC_COUNTER_COUNT) return;
+  portENTER_CRITICAL(&mux_);
+  counters_[c] += n;
+  portEXIT_CRITICAL(&mux_);
+}
+
+// Nearest-rank percentile over a sorted window
+static uint32_t rankOf(const uint32_t* sorted, uint8_t n, uint8_t pct) {
+  uint32_t rank = ((uint32_t)pct * n + 99) / 100; // ceil(pct/100 * n)
+  return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+TelemetryPercentiles Telemetry::percentiles(TelemetryMetric m) {
+  TelemetryPercentiles p = {};
+  if (m >= TM_METRIC_COUNT) return p;
+
+  uint32_t scratch[TELEMETRY_WINDOW];
+  portENTER_CRITICAL(&mux_);
+  const Ring& r = rings_[m];
+  p.n = r.count;
+  memcpy(scratch, r.samples, sizeof(scratch));
+  portEXIT_CRITICAL(&mux_);
+
+  if (p.n == 0) return p;
+  std::sort(scratch, scratch + p.n); // the first `count` slots are the live ones until the ring wraps
+  p.p50 = rankOf(scratch, p.n, 50);
+  p.p90 = rankOf(scratch, p.n, 90);
+  p.p99 = rankOf(scratch, p.n, 99);
+  p.max = scratch[p.n - 1];
+  return p;
+}
+
+size_t Telemetry::formatSummary(char* buf, size_t len) {
+  static TelemetrySummary s; // network task only; too big to want on its stack twice
+  s.upS = (uint32_t)(esp_timer_get_time() / 1000000);
+  s.heapFree = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  s.heapMinFree = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+  s.heapLargest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  s.wifiReconnects = counters_[TC_WIFI_RECONNECTS];
+  s.mqttReconnects = counters_[TC_MQTT_RECONNECTS];
+  s.triggers = counters_[TC_TRIGGERS];
+  s.duplicates = counters_[TC_DUPLICATES];
+
+  // metrics without samples are left out
+  s.metricCount = 0;
+  for (uint8_t m = 0; m < TM_METRIC_COUNT; m++) {
+    TelemetryPercentiles p = percentiles((TelemetryMetric)m);
+    if (p.n == 0) continue;
+    s.metrics[s.metricCount++] = { METRIC_NAMES[m], p.p50, p.p90, p.p99, p.max, p.n };
+  }
+  return telemetrySummaryJson(s, buf, len);
+}
@@ -0,0 +1,339 @@
+#include "TlsSessionClient.h"
+
+#include <WiFi.h>
+#include <errno.h>
+#include <lwip/sockets.h>
+#include "mbedtls/net_sockets.h"
+
+// mbedTLS 3.x hides struct members behind MBEDTLS_PRIVATE(); 2.x has them public.
+#ifndef MBEDTLS_PRIVATE
+#define MBEDTLS_PRIVATE(member) member
+#endif
+
+static const char DRBG_PERSONALIZATION[] = "beeper-tls";
+
+TlsSessionClient::TlsSessionClient() {
+  mbedtls_ssl_session_init(&session_);
+}
+
+TlsSessionClient::~TlsSessionClient() {
+  stop();
+  if (ctxReady_) {
+    mbedtls_ssl_free(&ssl_);
+    mbedtls_ssl_config_free(&conf_);
+    mbedtls_x509_crt_free(&ca_);
+    mbedtls_ctr_drbg_free(&drbg_);
+    mbedtls_entropy_free(&entropy_);
+  }
+  mbedtls_ssl_session_free(&session_);
+}
+
+void TlsSessionClient::setTrustAnchors(const uint8_t* const* ders, const size_t* lens, size_t count) {
+  caDers_ = ders;
+  caLens_ = lens;
+  caCount_ = count;
+}
+
+bool TlsSessionClient::initContext() {
+  if (ctxReady_) return true;
+
+  mbedtls_ssl_init(&ssl_);
+  mbedtls_ssl_config_init(&conf_);
+  mbedtls_x509_crt_init(&ca_);
+  mbedtls_entropy_init(&entropy_);
+  mbedtls_ctr_drbg_init(&drbg_);
+
+  int ret = mbedtls_ctr_drbg_seed(&drbg_, mbedtls_entropy_func, &entropy_,
+                                  (const unsigned char*)DRBG_PERSONALIZATION, sizeof(DRBG_PERSONALIZATION) - 1);
+  for (size_t i = 0; ret == 0 && i < caCount_; i++) {
+    ret = mbedtls_x509_crt_parse_der(&ca_, caDers_[i], caLens_[i]);
+  }
+  if (ret == 0 && caCount_ == 0) ret = MBEDTLS_ERR_X509_CERT_VERIFY_FAILED; // refuse to run unpinned
+  if (ret == 0) {
+    ret = mbedtls_ssl_config_defaults(&conf_, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                      MBEDTLS_SSL_PRESET_DEFAULT);
+  }
+  if (ret == 0) {
+    mbedtls_ssl_conf_authmode(&conf_, MBEDTLS_SSL_VERIFY_REQUIRED);
+    mbedtls_ssl_conf_ca_chain(&conf_, &ca_, nullptr);
+    mbedtls_ssl_conf_rng(&conf_, mbedtls_ctr_drbg_random, &drbg_);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    mbedtls_ssl_conf_session_tickets(&conf_, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+    if (maxFragmentLen_ != 0) {
+      unsigned char code = maxFragmentLen_ <= 512 ? MBEDTLS_SSL_MAX_FRAG_LEN_512
+                         : maxFragmentLen_ <= 1024 ? MBEDTLS_SSL_MAX_FRAG_LEN_1024
+                         : maxFragmentLen_ <= 2048 ? MBEDTLS_SSL_MAX_FRAG_LEN_2048
+                         : MBEDTLS_SSL_MAX_FRAG_LEN_4096;
+      mbedtls_ssl_conf_max_frag_len(&conf_, code);
+    }
+#endif
+    ret = mbedtls_ssl_setup(&ssl_, &conf_);
+  }
+
+  if (ret != 0) {
+    lastError_ = ret;
+    mbedtls_ssl_free(&ssl_);
+    mbedtls_ssl_config_free(&conf_);
+    mbedtls_x509_crt_free(&ca_);
+    mbedtls_ctr_drbg_free(&drbg_);
+    mbedtls_entropy_free(&entropy_);
+    return false;
+  }
+  ctxReady_ = true;
+  return true;
+}
+
+// ---------- Socket ----------
+static bool waitSocket(int sock, bool forWrite, uint32_t timeoutMs) {
+  fd_set fds;
+  FD_ZERO(&fds);
+  FD_SET(sock, &fds);
+  struct timeval tv;
+  tv.tv_sec = timeoutMs / 1000;
+  tv.tv_usec = (timeoutMs % 1000) * 1000;
+  int ret = forWrite ? select(sock + 1, nullptr, &fds, nullptr, &tv)
+                     : select(sock + 1, &fds, nullptr, nullptr, &tv);
+  return ret > 0;
+}
+
+int TlsSessionClient::connectSocket(const IPAddress& ip, uint16_t port) {
+  sock_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (sock_ < 0) return -1;
+
+  fcntl(sock_, F_SETFL, fcntl(sock_, F_GETFL, 0) | O_NONBLOCK);
+  int one = 1;
+  setsockopt(sock_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // MQTT packets are tiny
+
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = (uint32_t)ip;
+
+  int ret = ::connect(sock_, (struct sockaddr*)&addr, sizeof(addr));
+  if (ret < 0 && errno != EINPROGRESS) {
+    closeSocket();
+    return -1;
+  }
+  if (ret < 0) {
+    int err = 0;
+    socklen_t errLen = sizeof(err);
+    if (!waitSocket(sock_, true, handshakeTimeoutMs_) ||
+        getsockopt(sock_, SOL_SOCKET, SO_ERROR, &err, &errLen) < 0 || err != 0) {
+      closeSocket();
+      return -1;
+    }
+  }
+  return 0;
+}
+
+void TlsSessionClient::closeSocket() {
+  if (sock_ >= 0) {
+    close(sock_);
+    sock_ = -1;
+  }
+}
+
+int TlsSessionClient::bioSend(void* ctx, const unsigned char* buf, size_t len) {
+  TlsSessionClient* self = static_cast<TlsSessionClient*>(ctx);
+  int ret = send(self->sock_, buf, len, 0);
+  if (ret >= 0) return ret;
+  if (errno == EAGAIN || errno == EWOULDBLOCK) return MBEDTLS_ERR_SSL_WANT_WRITE;
+  return MBEDTLS_ERR_NET_SEND_FAILED;
+}
+
+int TlsSessionClient::bioRecv(void* ctx, unsigned char* buf, size_t len) {
+  TlsSessionClient* self = static_cast<TlsSessionClient*>(ctx);
+  int ret = recv(self->sock_, buf, len, 0);
+  if (ret >= 0) return ret; // 0 = peer closed
+  if (errno == EAGAIN || errno == EWOULDBLOCK) return MBEDTLS_ERR_SSL_WANT_READ;
+  return MBEDTLS_ERR_NET_RECV_FAILED;
+}
+
+// ---------- Handshake ----------
+int TlsSessionClient::handshake() {
+  uint32_t start = millis();
+  int ret;
+  while ((ret = mbedtls_ssl_handshake(&ssl_)) != 0) {
+    if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) return ret;
+    uint32_t elapsed = millis() - start;
+    if (elapsed >= handshakeTimeoutMs_) return MBEDTLS_ERR_SSL_TIMEOUT;
+    waitSocket(sock_, ret == MBEDTLS_ERR_SSL_WANT_WRITE, handshakeTimeoutMs_ - elapsed);
+  }
+  return 0;
+}
+
+int TlsSessionClient::connect(const char* host, uint16_t port) {
+  IPAddress ip;
+  if (!WiFi.hostByName(host, ip)) return 0;
+  strncpy(host_, host, sizeof(host_) - 1);
+  host_[sizeof(host_) - 1] = '\0';
+  return connectTo(ip, port);
+}
+
+int TlsSessionClient::connect(IPAddress ip, uint16_t port) {
+  host_[0] = '\0'; // no SNI / name check for a bare address
+  return connectTo(ip, port);
+}
+
+int TlsSessionClient::connectTo(const IPAddress& ip, uint16_t port) {
+  stop();
+  lastResumed_ = false;
+  lastHandshakeMs_ = 0;
+  if (!initContext()) return 0;
+  if (connectSocket(ip, port) != 0) {
+    lastError_ = MBEDTLS_ERR_NET_CONNECT_FAILED;
+    return 0;
+  }
+
+  mbedtls_ssl_set_hostname(&ssl_, host_[0] ? host_ : nullptr);
+  mbedtls_ssl_set_bio(&ssl_, this, bioSend, bioRecv, nullptr);
+  if (haveSession_) mbedtls_ssl_set_session(&ssl_, &session_);
+
+  uint32_t start = millis();
+  int ret = handshake();
+  lastHandshakeMs_ = millis() - start;
+  lastError_ = ret;
+  if (ret != 0) {
+    closeSocket();
+    mbedtls_ssl_session_reset(&ssl_);
+    clearSession(); // don't keep offering a session the server may be choking on
+    return 0;
+  }
+
+  // A resumed session keeps the master secret; a full handshake derives a fresh one.
+  mbedtls_ssl_session fresh;
+  mbedtls_ssl_session_init(&fresh);
+  if (mbedtls_ssl_get_session(&ssl_, &fresh) == 0) {
+    lastResumed_ = haveSession_ &&
+                   memcmp(fresh.MBEDTLS_PRIVATE(master), session_.MBEDTLS_PRIVATE(master),
+                          sizeof(fresh.MBEDTLS_PRIVATE(master))) == 0;
+    mbedtls_ssl_session_free(&session_);
+    session_ = fresh; // takes ownership
+    haveSession_ = true;
+  } else {
+    mbedtls_ssl_session_free(&fresh);
+  }
+
+  connected_ = true;
+  return 1;
+}
+
+// ---------- Stream ----------
+size_t TlsSessionClient::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t TlsSessionClient::write(const uint8_t* buf, size_t size) {
+  if (!connected_) return 0;
+  size_t sent = 0;
+  uint32_t start = millis();
+  while (sent < size) {
+    int ret = mbedtls_ssl_write(&ssl_, buf + sent, size - sent);
+    if (ret > 0) {
+      sent += ret;
+    } else if (ret == MBEDTLS_ERR_SSL_WANT_WRITE || ret == MBEDTLS_ERR_SSL_WANT_READ) {
+      uint32_t elapsed = millis() - start;
+      if (elapsed >= handshakeTimeoutMs_) {
+        // part of a record may be queued in mbedTLS; the stream can't be picked up again
+        lastError_ = MBEDTLS_ERR_SSL_TIMEOUT;
+        connected_ = false;
+        break;
+      }
+      waitSocket(sock_, ret == MBEDTLS_ERR_SSL_WANT_WRITE, handshakeTimeoutMs_ - elapsed);
+    } else {
+      lastError_ = ret;
+      connected_ = false;
+      break;
+    }
+  }
+  return sent;
+}
+
+int TlsSessionClient::available() {
+  if (!connected_) return peeked_ >= 0 ? 1 : 0;
+  int ret = mbedtls_ssl_read(&ssl_, nullptr, 0); // pull in a record if one is waiting
+  if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+    lastError_ = ret;
+    connected_ = false;
+  }
+  return (peeked_ >= 0 ? 1 : 0) + (int)mbedtls_ssl_get_bytes_avail(&ssl_);
+}
+
+bool TlsSessionClient::hasBuffered() const {
+  return peeked_ >= 0 || (connected_ && mbedtls_ssl_get_bytes_avail(&ssl_) > 0);
+}
+
+int TlsSessionClient::read(uint8_t* buf, size_t size) {
+  if (size == 0) return 0;
+  size_t got = 0;
+  if (peeked_ >= 0) {
+    buf[got++] = (uint8_t)peeked_;
+    peeked_ = -1;
+  }
+  if (connected_ && got < size) {
+    int ret = mbedtls_ssl_read(&ssl_, buf + got, size - got);
+    if (ret > 0) {
+      got += ret;
+    } else if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      lastError_ = ret;
+      connected_ = false; // 0 = close_notify
+    }
+  }
+  return got > 0 ? (int)got : -1;
+}
+
+int TlsSessionClient::read() {
+  uint8_t b;
+  return read(&b, 1) == 1 ? b : -1;
+}
+
+int TlsSessionClient::peek() {
+  if (peeked_ < 0) {
+    uint8_t b;
+    if (read(&b, 1) == 1) peeked_ = b;
+  }
+  return peeked_;
+}
+
+void TlsSessionClient::stop() {
+  if (sock_ >= 0) {
+    if (connected_) mbedtls_ssl_close_notify(&ssl_);
+    closeSocket();
+  }
+  if (ctxReady_) mbedtls_ssl_session_reset(&ssl_);
+  connected_ = false;
+  peeked_ = -1;
+}
+
+uint8_t TlsSessionClient::connected() {
+  return connected_ ? 1 : 0;
+}
+
+// ---------- Session cache ----------
+size_t TlsSessionClient::saveSession(uint8_t* buf, size_t len) const {
+  if (!haveSession_) return 0;
+  size_t olen = 0;
+  if (mbedtls_ssl_session_save(&session_, buf, len, &olen) != 0) return 0;
+  return olen;
+}
+
+bool TlsSessionClient::loadSession(const uint8_t* buf, size_t len) {
+  mbedtls_ssl_session loaded;
+  mbedtls_ssl_session_init(&loaded);
+  if (mbedtls_ssl_session_load(&loaded, buf, len) != 0) {
+    mbedtls_ssl_session_free(&loaded);
+    return false;
+  }
+  mbedtls_ssl_session_free(&session_);
+  session_ = loaded;
+  haveSession_ = true;
+  return true;
+}
+
+void TlsSessionClient::clearSession() {
+  mbedtls_ssl_session_free(&session_);
+  mbedtls_ssl_session_init(&session_);
+  haveSession_ = false;
+}
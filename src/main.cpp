@@ -6,7 +6,7 @@
    - Saves SSID and PASS into Preferences (NVS).
    - Connects to WiFi, then to Adafruit IO using MQTT/TLS (io.adafruit.com:8883).
    - Subscribes to topic:  "<ADA_USERNAME>/feeds/<FEED_KEY>"
-   - When a message payload contains "true" -> beep() and publish "false" to clear.
+   - When a message payload contains "true" -> beep (in the background) and publish "false" to clear.
    - Uses WiFi modem power save mode to reduce average power draw.
 
   Placeholders to replace:
@@ -16,389 +16,2515 @@
 */
 
 #include <WiFi.h>
+#include <ESPmDNS.h>
 #include "esp_wifi.h"
-#include <WebServer.h>
+#include "esp_http_server.h"
 #include <Preferences.h>
-#include <WiFiClientSecure.h>
 #include <PubSubClient.h>
+#include <time.h>
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "driver/rtc_io.h"
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include "esp_vfs_eventfd.h"
+#include <sys/select.h>
+#include "TlsSessionClient.h"
+#include "aio_root_ca.h"
+#include "config_page_gz.h"
+#include "Telemetry.h"
+#include "BeepPatterns.h"
+#include "Payload.h"
+#include "LinkPolicy.h"
+#include "DeviceConfig.h"
+#include "ScanList.h"
+#include "TriggerDedupe.h"
+#include "ReplayWindow.h"
+#include "LanTrigger.h"
+#include "CaptiveDns.h"
+#include "EspNowRelay.h"
+#include "Log.h"
+#include "OtaUpdater.h"
+
+// Automatic light sleep + dynamic frequency scaling. Needs an ESP-IDF build with CONFIG_PM_ENABLE
+// and tickless idle, which the stock Arduino libraries don't have -- use `pio run -e esp32dev-lowpower`.
+#ifndef BEEPER_AUTO_LIGHT_SLEEP
+#define BEEPER_AUTO_LIGHT_SLEEP 0
+#endif
+#if BEEPER_AUTO_LIGHT_SLEEP
+#include "esp_pm.h"
+#include "esp_idf_version.h"
+#endif
+
+// Cluster role (see EspNowRelay.h). A gateway holds the Adafruit IO session and relays triggers
+// over ESP-NOW; a leaf never joins WiFi and just listens for the gateway. Pick with
+// `pio run -e esp32dev-gateway` / `-e esp32dev-leaf`.
+#define BEEPER_ROLE_STANDALONE 0
+#define BEEPER_ROLE_GATEWAY 1
+#define BEEPER_ROLE_LEAF 2
+#ifndef BEEPER_NODE_ROLE
+#define BEEPER_NODE_ROLE BEEPER_ROLE_STANDALONE
+#endif
 
 // -------------------- Hardware / user config --------------------
-const int BUZZER_PIN = 25;          // GPIO that drives the active buzzer
+const int BUZZER_PIN = 25;          // GPIO that drives the buzzer
+const bool BUZZER_IS_PASSIVE = true; // passive (as in the BOM): LEDC plays the notes; active: just on/off
 const int LED_PIN = 26;             // Pin for the LED
 const int RESET_BTN = 27;           // Pin for the reset button
 const char* AP_SSID = "BEEPER-SETUP";
 const char* AP_PASS = "beeper1234"; // optional, keep >=8 chars for phones that require it
+// Provisioning portal: right after the AP comes up it scans once for networks (served to the
+// setup page as GET /scan, so nobody types an SSID), answers every DNS query with itself so
+// phones open the page unprompted, and joins the submitted network before saving it (in front of
+// the networks saved before, which stay as fallbacks; see WIFI_FAILOVER_BUDGET_MS). A wrong
+// name or password is reported on the page within PORTAL_CHECK_TIMEOUT_MS instead of costing a
+// reboot and another round through setup mode.
+const uint8_t AP_CHANNEL = 1;
+const unsigned long PORTAL_CHECK_TIMEOUT_MS = 15000;
+const uint32_t PORTAL_SAVED_RESTART_DELAY_MS = 4000; // long enough for the page to see "ok"
 
 // Power-saving config
 // Use LIGHT_SLEEP via WiFi power-save (modem PS). This keeps connection but reduces average draw.
+// Always on in the BEEPER_AUTO_LIGHT_SLEEP build: the chip can only light-sleep between DTIM beacons.
 const bool ENABLE_WIFI_POWERSAVE = false;
+// Fixed CPU clock for the stock build. The BEEPER_AUTO_LIGHT_SLEEP build scales between these on demand.
+const int CPU_FREQ_MHZ = 80;
+const int PM_MAX_FREQ_MHZ = 240;
+const int PM_MIN_FREQ_MHZ = 80;
+// With power save on, the station uses WIFI_PS_MAX_MODEM and wakes only for every Nth beacon.
+// N is the largest multiple of the AP's DTIM period (so broadcasts are never missed) that keeps
+// the extra delay on an incoming ping within WIFI_PS_MAX_ADDED_LATENCY_MS. IDF doesn't report the
+// AP's DTIM period, so set AP_DTIM_PERIOD to match the router (most use 1..3).
+// WIFI_PS_USE_MAX_MODEM = false keeps WIFI_PS_MIN_MODEM (wakes for every DTIM beacon).
+const bool WIFI_PS_USE_MAX_MODEM = true;
+const uint32_t WIFI_PS_MAX_ADDED_LATENCY_MS = 500;
+const uint8_t AP_DTIM_PERIOD = 1;
+const uint32_t AP_BEACON_INTERVAL_US = 102400; // 100 TU, what nearly every AP uses
+
+// Adaptive MQTT keepalive (power-save builds): every keepalive PINGREQ wakes the radio and CPU, so
+// use the longest interval the NAT/firewall path to the broker tolerates. Starting at
+// KEEPALIVE_START_S, a value that holds for KEEPALIVE_CONFIRM_ROUNDS intervals is kept and the next
+// connect tries double; a connection that times out at a value bisects back toward the last good
+// one, until the gap is under KEEPALIVE_RESOLUTION_S. Without power save, KEEPALIVE_DEFAULT_S.
+const bool ENABLE_ADAPTIVE_KEEPALIVE = true;
+const uint16_t KEEPALIVE_DEFAULT_S = 15;   // PubSubClient's default
+const uint16_t KEEPALIVE_START_S = 60;
+const uint16_t KEEPALIVE_MAX_S = 1200;
+const uint16_t KEEPALIVE_RESOLUTION_S = 30;
+const uint8_t KEEPALIVE_CONFIRM_ROUNDS = 3;
+const KeepAliveLimits KEEPALIVE_LIMITS = { KEEPALIVE_DEFAULT_S, KEEPALIVE_MAX_S, KEEPALIVE_RESOLUTION_S };
 
 // If MQTT cannot connect repeatedly, open provisioning AP again after N attempts
+// (only before the first successful connect; afterwards the device just keeps retrying)
 const int MQTT_MAX_CONNECT_ATTEMPTS = 6;
 
+// Reconnect backoff: capped exponential with jitter, so a fleet that lost the same AP spreads out
+// its reconnects instead of hammering the AP and the broker in lockstep.
+const uint32_t WIFI_BACKOFF_BASE_MS = 1000;
+const uint32_t WIFI_BACKOFF_CAP_MS = 5UL * 60UL * 1000UL;
+const uint32_t MQTT_BACKOFF_BASE_MS = 2000;
+const uint32_t MQTT_BACKOFF_CAP_MS = 10UL * 60UL * 1000UL;
+const unsigned long WIFI_CONNECT_TIMEOUT_MS = 20000;
+// Failover between the saved networks (each save in the portal adds one, up to
+// CONFIG_MAX_NETWORKS). The last good one goes first, through the fast-connect hints; if that
+// fails, one scan ranks the rest by signal and they are tried in turn, each ending early on a
+// definite "not here" or "wrong password". The whole pass gets WIFI_FAILOVER_BUDGET_MS; only a
+// pass that fails before the device was ever online this boot opens the portal.
+const unsigned long WIFI_FAILOVER_BUDGET_MS = 45000;
+const uint32_t WIFI_SCAN_MS_PER_CHANNEL = 120;  // this scan and the portal's
+const unsigned long WIFI_SCAN_TIMEOUT_MS = 5000;
+
+// Task layout: the network task (WiFi/MQTT/TLS) runs on core 0 next to the WiFi stack; the app
+// task (patterns, feed clears) and the input task (reset button) run on core 1. The app task has
+// the highest priority so a trigger beeps promptly even while the network task is mid-reconnect.
+const BaseType_t NETWORK_TASK_CORE = 0;
+const BaseType_t APP_TASK_CORE = 1;
+const UBaseType_t NETWORK_TASK_PRIORITY = 2;
+const UBaseType_t INPUT_TASK_PRIORITY = 3;
+const UBaseType_t APP_TASK_PRIORITY = 4;
+const uint32_t NETWORK_TASK_STACK = 10240; // mbedTLS handshake needs the headroom
+const uint32_t APP_TASK_STACK = 4096;
+const uint32_t INPUT_TASK_STACK = 2048;
+const uint32_t RESTART_TASK_STACK = 2048;
+const UBaseType_t LAN_TASK_PRIORITY = 3;
+const UBaseType_t DNS_TASK_PRIORITY = 1;  // captive DNS, provisioning AP only
+// Log lines go out on the UART from the lowest task priority, whenever nothing else wants the CPU
+const UBaseType_t LOG_TASK_PRIORITY = 1;
+// OTA downloads below everything else, on the app core so the network task keeps core 0
+const UBaseType_t OTA_TASK_PRIORITY = 1;
+
+// Fast WiFi reconnect: remember the last good BSSID/channel (and DHCP lease) and hand them to
+// the next WiFi.begin() so it can skip the scan and DHCP. Falls back to a full scan on failure.
+const bool ENABLE_FAST_CONNECT = true;
+const bool FAST_CONNECT_REUSE_LEASE = true;       // reuse the cached DHCP lease as a static IP
+const unsigned long FAST_CONNECT_TIMEOUT_MS = 3000;
+// Optional fixed address for the station. Leave STATIC_IP as 0.0.0.0 to use DHCP / the cached lease.
+const IPAddress STATIC_IP(0, 0, 0, 0);
+const IPAddress STATIC_GATEWAY(0, 0, 0, 0);
+const IPAddress STATIC_SUBNET(255, 255, 255, 0);
+const IPAddress STATIC_DNS(0, 0, 0, 0);
+
+// MQTT endpoint and the fixed memory plan for the connection. The largest packets are a signed
+// OTA request coming in and the telemetry summary going out: fixed header + topic + payload.
+const char* MQTT_HOST = "io.adafruit.com";
+const uint16_t MQTT_PORT = 8883;
+const size_t TELEMETRY_SUMMARY_MAX = 384;
+const size_t FEED_TOPIC_MAX = 128;
+// "url=<url> version=<9 digits> size=<9 digits> sha256=<64 hex> sig=<hex DER>"
+const size_t OTA_REQUEST_MAX = 4 + OtaRequest::URL_MAX + 18 + 15 + 72 + 5 + 2 * OtaRequest::SIG_MAX;
+const uint16_t MQTT_BUFFER_SIZE =
+    8 + FEED_TOPIC_MAX + (OTA_REQUEST_MAX > TELEMETRY_SUMMARY_MAX ? OTA_REQUEST_MAX : TELEMETRY_SUMMARY_MAX);
+// Negotiated TLS record limit (max fragment length). Nothing we send or receive is near it, so
+// with CONFIG_MBEDTLS_DYNAMIC_BUFFER (the lowpower env) the record buffers shrink from 16 KB.
+const uint16_t TLS_MAX_FRAGMENT_LEN = 2048;
+
+// Telemetry: latency percentiles, heap low-water mark and reconnect counts are published as one
+// compact JSON value to "<FEED_KEY>-diag" every TELEMETRY_PUBLISH_INTERVAL_S (0 = never).
+const uint32_t TELEMETRY_PUBLISH_INTERVAL_S = 900;
+const char* DIAG_FEED_SUFFIX = "-diag";
+// Units in the field have no serial monitor: when true, WARN/ERROR log lines collected since the
+// last pass are also published to "<FEED_KEY>-log" (at most every LOG_FEED_INTERVAL_S, from the
+// same publish budget as everything else). The log level itself is BEEPER_LOG_LEVEL (Log.h).
+const bool LOG_TO_FEED = false;
+const uint32_t LOG_FEED_INTERVAL_S = 300;
+const char* LOG_FEED_SUFFIX = "-log";
+
+// Where the device acknowledges a ping:
+//   ACK_CLEAR_FEED    - publish "false" to the trigger feed itself (original behaviour). The broker
+//                       echoes it straight back, costing a decrypt, a wake and a rate-limit slot.
+//   ACK_SEPARATE_FEED - publish to "<FEED_KEY>-ack", which the device never subscribes to, so each
+//                       ping is one message in and one out. Nothing is echoed, so the telemetry
+//                       summary has no "rtt".
+// Duty cycling reads the feed's retained value on every wake, so with FALLBACK_TO_DEEPSLEEP_SECONDS
+// > 0 (or MQTT_RELIABLE_DELIVERY) the trigger feed is always cleared regardless of this setting.
+enum AckMode : uint8_t { ACK_CLEAR_FEED, ACK_SEPARATE_FEED };
+const AckMode ACK_MODE = ACK_SEPARATE_FEED;
+const char* ACK_FEED_SUFFIX = "-ack";
+
+// Catch-up after a reconnect: pings published while the link was down still beep. The trigger
+// and fleet feeds are subscribed at QoS 1 on a persistent session (the client id is fixed per
+// chip), so a broker that keeps sessions queues them; every connect also asks for the trigger
+// feed's last value through "<feed>/get", which works on Adafruit IO either way. Acks then clear
+// the trigger feed, so a "true" handed back is one nobody has heard yet. A ping that arrives
+// both ways plays once (see TriggerDedupe.h); unnumbered ones count as repeats for
+// DEDUPE_PLAIN_WINDOW_MS.
+const bool MQTT_RELIABLE_DELIVERY = false;
+const uint32_t DEDUPE_PLAIN_WINDOW_MS = 10000;
+
+// Control feeds next to the trigger feed (see TOPIC_ROUTES). Values are applied when they arrive
+// and last until reboot:
+//   "<FEED_KEY>-pattern" - name of the melody a plain ping plays ("chime", "coin", ...)
+//   "<FEED_KEY>-volume"  - 0..100 (a passive buzzer scales its duty; an active one is on or muted)
+//   "<FEED_KEY>-quiet"   - "22-7": pings only flash the LED from 22:00 to 07:00; "off" clears it.
+//                          Local time comes from SNTP, in QUIET_HOURS_TZ (a POSIX TZ string).
+// FLEET_FEED_KEY is one feed every unit subscribes to: a ping there beeps all of them and is never
+// acked or cleared. Empty = no fleet feed.
+const bool ENABLE_CONTROL_FEEDS = true;
+// "<FEED_KEY>-ota" takes "url=https://... version=<n> size=<n> sha256=<hex> sig=<hex>" (signed and
+// printed by scripts/pack_ota.py) and updates the firmware in the background, then restarts (see
+// OtaUpdater.h). Requests not signed by the key in include/ota_signing_key.h, or not newer than
+// BEEPER_FIRMWARE_VERSION (include/firmware_version.h), are refused.
+const bool ENABLE_OTA = true;
+const char* FLEET_FEED_KEY = "";
+const char* QUIET_HOURS_TZ = "UTC0";
+const char* NTP_SERVER = "pool.ntp.org";
+// One SUBSCRIBE for every route: fixed header + packet id + (2 + topic + 1) per topic
+const size_t SUBSCRIBE_PACKET_MAX = 512;
+
+// Triggers arriving within TRIGGER_COALESCE_MS of the one that beeped are merged: no extra
+// playback, and a single ack for the whole burst once the window closes.
+const uint32_t TRIGGER_COALESCE_MS = 2000;
+
+// Outbound publish budget (token bucket). Adafruit IO's cap is per account -- 30/min on the free
+// tier, 60/min on IO+ -- and is shared with whoever sends the pings, so the device only takes a
+// slice of it. Acks that find the bucket empty wait for a token (newer ones replace older ones);
+// telemetry just waits for its next chance. A message on "<user>/throttle" empties the bucket.
+const uint32_t PUBLISH_TOKENS_PER_MIN = 10;
+const uint32_t PUBLISH_BURST = 3;
+
+// LAN fast path: an HMAC-authenticated UDP trigger on the local network (see LanTrigger.h),
+// advertised over mDNS as <MDNS_HOSTNAME>.local, service _beeper._udp.
+const bool ENABLE_LAN_TRIGGER = true;
+const uint16_t LAN_TRIGGER_PORT = 4210;
+const char* MDNS_HOSTNAME = "beeper";
+// The replay marks reach NVS this long after the last accepted datagram, once per burst
+const uint32_t LAN_REPLAY_SAVE_DELAY_MS = 2000;
+
+// ESP-NOW cluster timing. A leaf listens for LEAF_LISTEN_MS, light-sleeps for LEAF_SLEEP_MS, and
+// so on; the gateway repeats each trigger for longer than one such period so every leaf hears it.
+// Worst-case relay latency is about LEAF_SLEEP_MS.
+const uint32_t LEAF_LISTEN_MS = 60;
+const uint32_t LEAF_SLEEP_MS = 940;
+const uint32_t RELAY_REPEAT_MS = 50;
+const uint8_t RELAY_REPEAT_COUNT = (LEAF_LISTEN_MS + LEAF_SLEEP_MS) / RELAY_REPEAT_MS + 4;
+// How long to sit on each channel while looking for the gateway's beacon, and how long a leaf
+// may go without hearing it before searching again (the AP may have changed channel).
+const uint32_t RELAY_SCAN_DWELL_MS = EspNowRelay::BEACON_INTERVAL_MS + 500;
+const uint32_t LEAF_GATEWAY_LOST_S = 300;
+
 // Optional: if you want to fall back to periodic deep-sleep when idle (very low power but slower)
-// set FALLBACK_TO_DEEPSLEEP_SECONDS > 0 (e.g., 300) to deep-sleep for that many seconds after prolonged idle.
+// set FALLBACK_TO_DEEPSLEEP_SECONDS > 0 (e.g., 300) to start duty-cycling after that many seconds idle.
 // Default 0 (disabled).
 const uint32_t FALLBACK_TO_DEEPSLEEP_SECONDS = 0;
+// While duty-cycling the device wakes every DEEPSLEEP_WAKE_INTERVAL_SECONDS, reconnects with the
+// cached WiFi/TLS state, reads the feed's retained value (so pings sent while asleep still beep)
+// and sleeps again. Worst-case trigger latency is about the interval plus ~1-2 s of reconnect;
+// average current scales with awake time / interval, so a longer interval trades latency for battery.
+const uint32_t DEEPSLEEP_WAKE_INTERVAL_SECONDS = 60;
+// How long a timer wake waits for the retained value before going back to sleep
+const uint32_t DEEPSLEEP_LISTEN_MS = 1500;
 
 // -------------------- Globals --------------------
 Preferences prefs;
-WebServer server(80);
-
-String savedSSID = "";
-String savedPASS = "";
+httpd_handle_t portalServer = nullptr;
+CaptiveDns captiveDns;
 
-String adaUsername = "";
-String adaKey = "";
-String feedKey = "beeper"; // default feed key; can be changed in provisioning page
+TlsSessionClient tlsClient;
+PubSubClient mqtt(tlsClient);
+LanTrigger lanTrigger;
+bool mdnsStarted = false;
+EspNowRelay relay;
+bool relayStarted = false;
+OtaUpdater ota;
 
-WiFiClientSecure secureClient;
-PubSubClient mqtt(secureClient);
+// Serialized TLS session, kept in RTC memory so even the first connect after a deep-sleep
+// wake can do an abbreviated handshake.
+const size_t TLS_SESSION_RTC_MAX = 2048;
+RTC_DATA_ATTR uint8_t tlsSessionBlob[TLS_SESSION_RTC_MAX];
+RTC_DATA_ATTR uint16_t tlsSessionLen = 0;
 
 unsigned long lastMqttMsgTime = 0;
-int mqttConnectAttempts = 0;
+uint16_t mqttKeepAliveS = KEEPALIVE_DEFAULT_S; // of the current connection
+uint32_t mqttMsgCount = 0;
+uint32_t triggerCount = 0;
+
+// Work handed between tasks. Only the network task touches mqtt/tlsClient.
+enum TriggerSource : uint8_t {
+  TRIGGER_SRC_MQTT,
+  TRIGGER_SRC_LAN,      // acked straight back over UDP, nothing to clear on the feed
+  TRIGGER_SRC_RELAY,    // heard from the gateway over ESP-NOW; the gateway acks the feed
+  TRIGGER_SRC_FLEET,    // the shared fleet feed, which nobody acks
+};
+enum AppEventType : uint8_t {
+  APP_EV_TRIGGER,       // ping received -> beep and clear the feed
+  APP_EV_RESET_PRESSED,
+};
+struct AppEvent {
+  AppEventType type;
+  int64_t rxUs;        // esp_timer time the triggering message arrived
+  uint32_t triggerId;  // "id=" from the payload, 0 if none
+  TriggerSource source;
+  PatternId pattern;   // what to play
+};
+
+enum NetRequestType : uint8_t {
+  NET_REQ_CLEAR_FEED,   // publish "false" to the feed
+};
+struct NetRequest {
+  NetRequestType type;
+  uint32_t triggerId;   // echoed in the clear so lib/bench_latency.py can match it
+  uint32_t rxToBeepUs;
+  uint16_t merged;      // triggers covered by this ack beyond the first
+};
+
+const UBaseType_t APP_QUEUE_LEN = 8;
+const UBaseType_t NET_QUEUE_LEN = 8;
+QueueHandle_t appQueue = nullptr;
+QueueHandle_t netQueue = nullptr;
+
+// Last station disconnect reason; whoever starts an association attempt resets it
+volatile uint8_t staDisconnectReason = 0;
+
+// Link status, kept current by WiFi event callbacks rather than polling WiFi.status()
+const EventBits_t LINK_WIFI_UP_BIT = BIT0;
+const EventBits_t LINK_MQTT_UP_BIT = BIT1;
+const EventBits_t LINK_CHANGED_BIT = BIT2;  // wakes the network task early
+// An async scan ended (the portal's, or the link supervisor's failover scan, which also gets
+// LINK_CHANGED_BIT)
+const EventBits_t WIFI_SCAN_DONE_BIT = BIT3;
+// Provisioning portal only: work for the task parked in startConfigPortal()
+const EventBits_t PORTAL_SAVE_BIT = BIT4;
+const EventBits_t PORTAL_RESCAN_BIT = BIT5;
+EventGroupHandle_t linkEvents = nullptr;
+// While LINK_UP the network task sleeps in select() on the MQTT socket and this eventfd, which
+// sendNetRequest() and link changes write to. -1 if it couldn't be created: then it polls.
+int netWakeFd = -1;
+const uint32_t NET_POLL_FALLBACK_MS = 10;
+
+void wakeNetworkTask() {
+  if (netWakeFd < 0) return;
+  uint64_t one = 1;
+  write(netWakeFd, &one, sizeof(one));
+}
+
+// Any task: hands a publish to the network task and wakes it
+void sendNetRequest(const NetRequest& req) {
+  if (xQueueSend(netQueue, &req, 0) == pdTRUE) wakeNetworkTask();
+}
+
+// Survives deep sleep: whether we are duty-cycling and any work left over from the last wake
+const uint32_t SLEEP_STATE_MAGIC = 0x51EE9ED0;
+struct SleepState {
+  uint32_t magic;        // SLEEP_STATE_MAGIC while duty-cycling
+  uint32_t wakeCount;
+  uint32_t failedWakes;  // consecutive wakes that could not reach the broker
+  bool pendingClear;     // a "false" clear publish that has not gone out yet
+};
+RTC_DATA_ATTR SleepState sleepState = {};
+
+// Keepalive probe progress; survives deep sleep (a power cycle probes again from the start)
+const uint32_t KEEPALIVE_PROBE_MAGIC = 0x4EE9A11E;
+RTC_DATA_ATTR KeepAliveProbe keepAliveProbe = {};
+int64_t mqttConnectedUs = 0;
+int64_t subscribeSentUs = 0;   // SUBSCRIBE written, its SUBACK not read yet
+
+// Last good association (see DeviceConfig.h), mirrored in RTC memory. RTC memory outlives
+// esp_restart(), so the copy is tagged with the network it was made for (configNetworkKey())
+// and only trusted while networks[0] still matches.
+RTC_DATA_ATTR FastConnectCache fastConnect = {};
+RTC_DATA_ATTR uint32_t fastConnectFor = 0;
+
+// Replay marks for authenticated triggers (see ReplayWindow.h). The RTC copy covers a restart
+// without touching flash; NVS ("replay" namespace) covers a power cut. Neither is cleared by a
+// settings reset, so a captured datagram stays stale whatever happens to the device.
+RTC_DATA_ATTR ReplayWindow lanReplay = {};
+RTC_DATA_ATTR ReplayWindow relayReplay = {};   // leaf: marks per ESP-NOW gateway
+// Copied on the WiFi task after each accepted relay trigger; written to NVS by the leaf task
+ReplayWindow relayReplayToSave = {};
+volatile bool relayReplayDirty = false;
+portMUX_TYPE relayReplayMux = portMUX_INITIALIZER_UNLOCKED;
+// Same again for the LAN task; the network task writes it (maybeSaveLanReplay)
+ReplayWindow lanReplayToSave = {};
+volatile bool lanReplayDirty = false;
+int64_t lanReplayChangedUs = 0;
+portMUX_TYPE lanReplayMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Everything provisioned: one NVS blob ("cfg"), laid out and checked by DeviceConfig.h
+const char* DEFAULT_FEED_KEY = "beeper"; // can be changed in provisioning page
+DeviceConfig config = {};
+// "<ADA_USERNAME>/feeds/<FEED_KEY>", built once per connect so the callback never allocates
+char feedTopic[FEED_TOPIC_MAX] = "";
+char diagTopic[FEED_TOPIC_MAX] = "";
+char logTopic[FEED_TOPIC_MAX] = "";
+char ackTopic[FEED_TOPIC_MAX] = "";
+
+// Telemetry timestamps (esp_timer_get_time() microseconds, 0 = not pending)
+int64_t wifiBeginUs = 0;
+int64_t wifiAssocUs = 0;
+int64_t clearSentUs = 0;
+int64_t lastTelemetryPublishUs = 0;
 
 // ---------- HTML provisioning page ----------
-const char CONFIG_PAGE[] PROGMEM = R"rawliteral(
-<!DOCTYPE html>
-<html>
-<head>
-<meta name="viewport" content="width=device-width, initial-scale=1">
-<title>Beeper Setup</title>
-<style> body{font-family:Arial;padding:10px} input{width:100%;padding:8px;margin:6px 0} button{padding:10px;width:100%;background:#007bff;color:#fff;border:none} </style>
-</head>
-<body>
-<h3>"Not A Smoke Detector™" Adafruit IO Setup</h3>
-<form action="/save" method="POST">
-<label>WiFi SSID</label><input name="ssid" required>
-<label>WiFi Password</label><input name="pass">
-<hr>
-<label>Adafruit IO Username</label><input name="ada_user" value="" required>
-<label>Adafruit IO AIO Key</label><input name="ada_key" value="" required>
-<label>Feed Key (e.g. beeper)</label><input name="feed_key" value="beeper" required>
-<button type="submit">Save & Reboot</button>
-</form>
-<p>A single beep means you have turned on the device and it has connected to the network!</p>
-<p>To reset for a new WiFi network, press the RESET button.</p>
-<p>2 beeps means you have clicked the reset button!</p>
-<p>3 beeps means you have entered setup mode, which is this one!</p>
-<p>If you saved your settings, and after a reboot you re-enter setup mode, this likely means you entered your SSID or Password incorrectly!</p>
-</body>
-</html>
-)rawliteral";
-
-// ---------- Helpers ----------
-void beep() {
-  // Enable buzzer pin
-  pinMode(BUZZER_PIN, OUTPUT);
-  // quick beep pattern
-  digitalWrite(BUZZER_PIN, HIGH);
+// The page source lives in web/config_page.html; scripts/embed_config_page.py gzips it into
+// config_page_gz.h at build time.
+
+// ---------- Power management ----------
+// With automatic light sleep the chip sleeps whenever every task is blocked. PM locks keep it
+// awake (or at full clock) only for the short stretches that need it.
+#if BEEPER_AUTO_LIGHT_SLEEP
+esp_pm_lock_handle_t tlsPmLock = nullptr;      // 240 MHz while mbedTLS does handshake crypto
+esp_pm_lock_handle_t patternPmLock = nullptr;  // APB fixed and no light sleep while a pattern plays
+
+void initPowerManagement() {
+#if ESP_IDF_VERSION_MAJOR >= 5
+  esp_pm_config_t pm = {};
+#else
+  esp_pm_config_esp32_t pm = {};
+#endif
+  pm.max_freq_mhz = PM_MAX_FREQ_MHZ;
+  pm.min_freq_mhz = PM_MIN_FREQ_MHZ;
+  pm.light_sleep_enable = true;
+  esp_err_t err = esp_pm_configure(&pm);
+  if (err != ESP_OK) {
+    LOGE("esp_pm_configure failed (%s), staying at %d MHz", esp_err_to_name(err), CPU_FREQ_MHZ);
+    setCpuFrequencyMhz(CPU_FREQ_MHZ);
+    return;
+  }
+  esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "tls", &tlsPmLock);
+  // LEDC runs off APB, so the note pitch needs APB fixed (which also rules out light sleep)
+  esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "pattern", &patternPmLock);
+  LOGI("Auto light sleep on, CPU %d-%d MHz", PM_MIN_FREQ_MHZ, PM_MAX_FREQ_MHZ);
+}
+
+void pmHold(esp_pm_lock_handle_t lock, bool hold) {
+  if (!lock) return;
+  if (hold) {
+    esp_pm_lock_acquire(lock);
+  } else {
+    esp_pm_lock_release(lock);
+  }
+}
+
+inline void pmHoldTls(bool hold) { pmHold(tlsPmLock, hold); }
+inline void pmHoldPattern(bool hold) { pmHold(patternPmLock, hold); }
+#else
+void initPowerManagement() {
+  // Set CPU frequency to 80 MHz
+  setCpuFrequencyMhz(CPU_FREQ_MHZ);
+}
+
+inline void pmHoldTls(bool) {}
+inline void pmHoldPattern(bool) {}
+#endif
+
+// ---------- Memory report ----------
+// Everything long-lived is sized up front (no String, fixed MQTT buffer), so after boot the free
+// heap and the largest free block should stay flat. These lines, and the "heap" entry of the
+// diag feed, are how to check that over weeks of uptime.
+void reportHeap(const char* when) {
+  size_t freeBytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  LOGI("Heap (%s): free %u, min %u, largest block %u, fragmentation %u%%", when, (unsigned)freeBytes,
+                (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT), (unsigned)largest,
+                freeBytes ? (unsigned)(100 - largest * 100 / freeBytes) : 0u);
+}
+
+void reportMemoryPlan() {
+  LOGI("Memory plan: MQTT buffer %u, TLS record limit %u, RTC TLS session %u, config record %u",
+                (unsigned)MQTT_BUFFER_SIZE, (unsigned)TLS_MAX_FRAGMENT_LEN, (unsigned)sizeof(tlsSessionBlob),
+                (unsigned)sizeof(DeviceConfig));
+  reportHeap("boot");
+}
+
+// ---------- Beep pattern engine ----------
+// Plays the patterns of BeepPatterns.h. The LEDC peripheral generates each note's square wave on
+// BUZZER_PIN by itself, and an esp_timer only fires at note boundaries to switch to the next
+// one, so the caller returns immediately and the CPU is free while the buzzer sounds.
+// Patterns queued while one is playing are played in order.
+const ledc_mode_t BUZZER_LEDC_MODE = LEDC_LOW_SPEED_MODE;
+const ledc_timer_t BUZZER_LEDC_TIMER = LEDC_TIMER_0;
+const ledc_channel_t BUZZER_LEDC_CHANNEL = LEDC_CHANNEL_0;
+const ledc_timer_bit_t BUZZER_LEDC_RESOLUTION = LEDC_TIMER_10_BIT;
+const uint32_t BUZZER_DUTY_ON = BUZZER_IS_PASSIVE ? (1u << 9) : (1u << 10); // 50% square wave, or solid high
+
+const uint8_t PATTERN_QUEUE_LEN = 8;
+
+esp_timer_handle_t patternTimer = nullptr;
+portMUX_TYPE patternMux = portMUX_INITIALIZER_UNLOCKED;
+struct QueuedPattern {
+  const BeepPattern* pattern;
+  uint16_t duty;       // LEDC duty while a note sounds; 0 = LED only
+};
+QueuedPattern patternQueue[PATTERN_QUEUE_LEN];
+uint8_t patternQueueHead = 0;
+uint8_t patternQueueCount = 0;
+volatile bool patternPlaying = false;
+
+// Only touched from whoever owns playback (patternPlaying == true)
+PatternCursor cur = {};
+uint16_t curDuty = BUZZER_DUTY_ON;
+
+void buzzerOn(uint16_t freqHz) {
+  if (BUZZER_IS_PASSIVE && freqHz > 0) ledc_set_freq(BUZZER_LEDC_MODE, BUZZER_LEDC_TIMER, freqHz);
+  ledc_set_duty(BUZZER_LEDC_MODE, BUZZER_LEDC_CHANNEL, curDuty);
+  ledc_update_duty(BUZZER_LEDC_MODE, BUZZER_LEDC_CHANNEL);
+}
+
+void buzzerOff() {
+  ledc_set_duty(BUZZER_LEDC_MODE, BUZZER_LEDC_CHANNEL, 0);
+  ledc_update_duty(BUZZER_LEDC_MODE, BUZZER_LEDC_CHANNEL);
+}
+
+void patternApplyEdge(const PatternEdge& e) {
+  if (e.on) buzzerOn(e.freqHz);
+  else buzzerOff();
+  if (cur.pattern->mirrorLed) digitalWrite(LED_PIN, e.on ? HIGH : LOW);
+  esp_timer_start_once(patternTimer, (uint64_t)e.ms * 1000ULL);
+}
+
+void patternStartPattern(const QueuedPattern& q) {
+  curDuty = q.duty;
+  patternApplyEdge(patternCursorBegin(cur, q.pattern));
+}
+
+// Pattern finished: hand playback to the next queued pattern, or go idle. Going idle (cursor,
+// pm lock, patternPlaying) happens under patternMux, so a playPattern() on the other core that
+// takes over right after sees a clean engine; the pm lock is taken and let go under the same
+// lock as patternPlaying (esp_pm locks are safe inside a critical section).
+void patternFinish() {
+  QueuedPattern next = {};
+  portENTER_CRITICAL(&patternMux);
+  if (patternQueueCount > 0) {
+    next = patternQueue[patternQueueHead];
+    patternQueueHead = (patternQueueHead + 1) % PATTERN_QUEUE_LEN;
+    patternQueueCount--;
+  } else {
+    cur.pattern = nullptr;
+    pmHoldPattern(false);
+    patternPlaying = false;
+  }
+  portEXIT_CRITICAL(&patternMux);
+
+  if (next.pattern) patternStartPattern(next);
+}
+
+void patternTimerCb(void*) {
+  PatternEdge next;
+  if (patternCursorAdvance(cur, next)) {
+    patternApplyEdge(next);
+    return;
+  }
+  // a last note without trailing silence is still sounding
+  buzzerOff();
+  if (cur.pattern->mirrorLed) digitalWrite(LED_PIN, LOW);
+  patternFinish();
+}
+
+// The buzzer idles with the LEDC output held low, so no current flows between notes.
+void initPatternEngine() {
+  ledc_timer_config_t timer = {};
+  timer.speed_mode = BUZZER_LEDC_MODE;
+  timer.duty_resolution = BUZZER_LEDC_RESOLUTION;
+  timer.timer_num = BUZZER_LEDC_TIMER;
+  timer.freq_hz = TONE_ALERT_HI;
+  timer.clk_cfg = LEDC_AUTO_CLK;
+  ledc_timer_config(&timer);
+
+  ledc_channel_config_t channel = {};
+  channel.gpio_num = BUZZER_PIN;
+  channel.speed_mode = BUZZER_LEDC_MODE;
+  channel.channel = BUZZER_LEDC_CHANNEL;
+  channel.timer_sel = BUZZER_LEDC_TIMER;
+  channel.duty = 0;
+  channel.hpoint = 0;
+  ledc_channel_config(&channel);
+
+  esp_timer_create_args_t args = {};
+  args.callback = patternTimerCb;
+  args.dispatch_method = ESP_TIMER_TASK;
+  args.name = "beep";
+  esp_timer_create(&args, &patternTimer);
+}
+
+// Queue a pattern for background playback. Returns false if the queue is full.
+// `duty` < BUZZER_DUTY_ON plays it quieter (passive buzzer only); 0 just flashes the LED.
+bool playPattern(PatternId id, uint16_t duty = BUZZER_DUTY_ON) {
+  QueuedPattern q = { &PATTERNS[id < PAT_COUNT ? id : PAT_PING], duty };
+  bool startNow = false;
+  bool queued = true;
+  portENTER_CRITICAL(&patternMux);
+  if (!patternPlaying) {
+    patternPlaying = true;
+    pmHoldPattern(true);
+    startNow = true;
+  } else if (patternQueueCount < PATTERN_QUEUE_LEN) {
+    patternQueue[(patternQueueHead + patternQueueCount) % PATTERN_QUEUE_LEN] = q;
+    patternQueueCount++;
+  } else {
+    queued = false;
+  }
+  portEXIT_CRITICAL(&patternMux);
+
+  if (startNow) patternStartPattern(q);
+  return queued;
+}
+
+bool patternBusy() {
+  return patternPlaying;
+}
+
+// For the few places that must not continue (restart) until the buzzer is done.
+void waitForPatternIdle() {
+  while (patternBusy()) delay(10);
+}
+
+// ---------- Boot LED animation ----------
+// Runs off its own esp_timer so WiFi association and the broker connect start while the LED is
+// still blinking instead of after it.
+const uint32_t BOOT_BLINK_MS = 500;
+const uint8_t BOOT_BLINK_TOGGLES = 3; // on -> off -> on -> off
+
+esp_timer_handle_t bootBlinkTimer = nullptr;
+uint8_t bootBlinkStep = 0;
+
+void bootBlinkCb(void*) {
+  bootBlinkStep++;
+  digitalWrite(LED_PIN, (bootBlinkStep % 2) ? LOW : HIGH);
+  if (bootBlinkStep >= BOOT_BLINK_TOGGLES) esp_timer_stop(bootBlinkTimer);
+}
+
+void startBootBlink() {
+  esp_timer_create_args_t args = {};
+  args.callback = bootBlinkCb;
+  args.dispatch_method = ESP_TIMER_TASK;
+  args.name = "bootblink";
+  if (esp_timer_create(&args, &bootBlinkTimer) != ESP_OK) return;
   digitalWrite(LED_PIN, HIGH);
-  delay(100);
-  digitalWrite(BUZZER_PIN, LOW);
-  digitalWrite(LED_PIN, LOW);
-  // Disable buzzer pin (for high pitched ring)
-  pinMode(BUZZER_PIN, OUTPUT);
-}
-
-void beepNeedsConfig() {
-  // beep to signify setup required
-  pinMode(BUZZER_PIN, OUTPUT);
-  digitalWrite(BUZZER_PIN, HIGH);
-  delay(50);
-  digitalWrite(BUZZER_PIN, LOW);
-  delay(200);
-  digitalWrite(BUZZER_PIN, HIGH);
-  delay(50);
-  digitalWrite(BUZZER_PIN, LOW);
-  delay(200);
-  digitalWrite(BUZZER_PIN, HIGH);
-  delay(50);
-  digitalWrite(BUZZER_PIN, LOW);
-  pinMode(BUZZER_PIN, INPUT);
+  esp_timer_start_periodic(bootBlinkTimer, (uint64_t)BOOT_BLINK_MS * 1000ULL);
 }
 
 // Save credentials and aio settings into preferences
-void saveCredentials(const String& ssid, const String& pass, const String& user, const String& aioKey, const String& fkey) {
+bool writeConfig() {
+  configEncode(config);
   prefs.begin("config", false);
-  prefs.putString("ssid", ssid);
-  prefs.putString("pass", pass);
-  prefs.putString("ada_user", user);
-  prefs.putString("ada_key", aioKey);
-  prefs.putString("feed", fkey);
+  bool ok = prefs.putBytes("cfg", &config, sizeof(config)) == sizeof(config);
   prefs.end();
+  if (!ok) LOGE("Failed to write config.");
+  return ok;
+}
+
+// The network goes first in the saved list; ones saved before stay behind it as fallbacks
+void saveCredentials(const char* ssid, const char* pass, const char* user, const char* aioKey, const char* fkey) {
+  configRememberNetwork(config, ssid, pass);
+  fastConnect.magic = 0; // the RTC copy may be the previous network's
+  copyField(config.adaUser, sizeof(config.adaUser), user);
+  copyField(config.adaKey, sizeof(config.adaKey), aioKey);
+  copyField(config.feedKey, sizeof(config.feedKey), fkey);
+  writeConfig();
+}
+
+// Firmware before the config blob kept five string keys plus "fastconn". Read them once,
+// write the blob, and drop them. Returns false if there was nothing to migrate.
+bool migrateLegacyConfig() {
+  prefs.begin("config", false);
+  if (!prefs.isKey("ssid")) {
+    prefs.end();
+    return false;
+  }
+  prefs.getString("ssid", config.networks[0].ssid, sizeof(config.networks[0].ssid));
+  prefs.getString("pass", config.networks[0].pass, sizeof(config.networks[0].pass));
+  prefs.getString("ada_user", config.adaUser, sizeof(config.adaUser));
+  prefs.getString("ada_key", config.adaKey, sizeof(config.adaKey));
+  if (prefs.getString("feed", config.feedKey, sizeof(config.feedKey)) == 0) {
+    copyField(config.feedKey, sizeof(config.feedKey), DEFAULT_FEED_KEY);
+  }
+  if (prefs.getBytes("fastconn", &config.fastConnect, sizeof(config.fastConnect)) != sizeof(config.fastConnect)) {
+    memset(&config.fastConnect, 0, sizeof(config.fastConnect));
+  }
+  prefs.end();
+
+  if (!writeConfig()) return true; // keep the old keys; try again next boot
+  prefs.begin("config", false);
+  const char* legacyKeys[] = { "ssid", "pass", "ada_user", "ada_key", "feed", "fastconn" };
+  for (const char* key : legacyKeys) prefs.remove(key);
+  prefs.end();
+  LOGI("Migrated settings to the config blob.");
+  return true;
 }
 
 // Load saved settings (if present)
 void loadSavedSettings() {
+  DeviceConfig stored;
   prefs.begin("config", true);
-  savedSSID = prefs.getString("ssid", "");
-  savedPASS = prefs.getString("pass", "");
-  adaUsername = prefs.getString("ada_user", "");
-  adaKey = prefs.getString("ada_key", "");
-  feedKey = prefs.getString("feed", "beeper");
+  size_t got = prefs.getBytes("cfg", &stored, sizeof(stored));
   prefs.end();
+
+  if (!configDecode(&stored, got, config)) {
+    if (got > 0) LOGE("Config record invalid, ignoring it.");
+    memset(&config, 0, sizeof(config));
+    if (!migrateLegacyConfig()) copyField(config.feedKey, sizeof(config.feedKey), DEFAULT_FEED_KEY);
+  } else if (config.version != CONFIG_VERSION) {
+    LOGI("Config record v%u converted to v%u.", (unsigned)config.version, (unsigned)CONFIG_VERSION);
+    writeConfig();
+  }
+
+  uint32_t key = configNetworkKey(config.networks[0]);
+  if (fastConnect.magic != FAST_CONNECT_MAGIC || fastConnectFor != key) {
+    fastConnect = config.fastConnect;
+    fastConnectFor = key;
+  }
 }
 
-// ---------- Web handlers ----------
-void handleRoot() {
-  server.send(200, "text/html", CONFIG_PAGE);
+// Remember the current association for the next boot / reconnect. Only writes NVS on change.
+void saveFastConnectCache() {
+  FastConnectCache c = {};
+  c.magic = FAST_CONNECT_MAGIC;
+  memcpy(c.bssid, WiFi.BSSID(), sizeof(c.bssid));
+  c.channel = (uint8_t)WiFi.channel();
+  c.ip = (uint32_t)WiFi.localIP();
+  c.gateway = (uint32_t)WiFi.gatewayIP();
+  c.subnet = (uint32_t)WiFi.subnetMask();
+  c.dns = (uint32_t)WiFi.dnsIP();
+
+  if (memcmp(&c, &fastConnect, sizeof(c)) == 0) return;
+  fastConnect = c;
+  fastConnectFor = configNetworkKey(config.networks[0]);
+  config.fastConnect = c;
+  writeConfig();
 }
 
-void handleSave() {
-  if (!server.hasArg("ssid") || !server.hasArg("ada_user") || !server.hasArg("ada_key") || !server.hasArg("feed_key")) {
-    server.send(400, "text/plain", "Missing fields");
-    return;
+void clearFastConnectCache() {
+  if (fastConnect.magic != FAST_CONNECT_MAGIC) return;
+  fastConnect.magic = 0;
+  config.fastConnect.magic = 0;
+  writeConfig();
+}
+
+// ---------- Web handlers ----------
+// esp_http_server runs its own task that blocks in select() between requests, so the portal
+// costs no CPU while it waits for a phone to connect.
+const size_t PORTAL_FORM_MAX = 1024;
+const uint32_t PORTAL_RESTART_DELAY_MS = 1500;
+
+// In-place application/x-www-form-urlencoded decode ('+' and %XX)
+void urlDecode(char* s) {
+  char* out = s;
+  for (char* in = s; *in; in++) {
+    if (*in == '+') {
+      *out++ = ' ';
+    } else if (*in == '%' && isxdigit((unsigned char)in[1]) && isxdigit((unsigned char)in[2])) {
+      char hex[3] = { in[1], in[2], 0 };
+      *out++ = (char)strtol(hex, nullptr, 16);
+      in += 2;
+    } else {
+      *out++ = *in;
+    }
   }
+  *out = '\0';
+}
 
-  String ssid = server.arg("ssid");
-  String pass = server.arg("pass");
-  String user = server.arg("ada_user");
-  String aioKey = server.arg("ada_key");
-  String fkey = server.arg("feed_key");
+// One form field, decoded into `out`. httpd_query_key_value() copies the value still encoded,
+// where every symbol takes 3 bytes ("%21"), so it goes through a scratch buffer big enough for
+// the longest field fully encoded and only the decoded text has to fit.
+enum FormResult : uint8_t { FORM_OK, FORM_MISSING, FORM_TOO_LONG };
+const size_t FORM_FIELD_MAX = 65; // longest field, terminator included (pass, Adafruit fields)
 
-  saveCredentials(ssid, pass, user, aioKey, fkey);
+FormResult formField(const char* body, const char* key, char* out, size_t outLen) {
+  static char encoded[3 * (FORM_FIELD_MAX - 1) + 1];
+  esp_err_t err = httpd_query_key_value(body, key, encoded, sizeof(encoded));
+  if (err == ESP_ERR_NOT_FOUND) return FORM_MISSING;
+  if (err != ESP_OK) return FORM_TOO_LONG;
+  urlDecode(encoded);
+  if (strlen(encoded) >= outLen) return FORM_TOO_LONG;
+  memcpy(out, encoded, strlen(encoded) + 1);
+  return FORM_OK;
+}
 
-  server.send(200, "text/html", "<html><body><h3>Saved! Rebooting...</h3></body></html>");
-  delay(1500);
+void restartTask(void* arg) {
+  vTaskDelay(pdMS_TO_TICKS((uint32_t)(uintptr_t)arg));
+  logFlush(); // waits on the log task, so not from a timer callback
   ESP.restart();
 }
 
+// Restart from a short-lived task so the handler that asked returns and its response is
+// flushed first
+void scheduleRestart(uint32_t delayMs) {
+  if (xTaskCreate(restartTask, "restart", RESTART_TASK_STACK, (void*)(uintptr_t)delayMs, 1, nullptr) != pdPASS) {
+    logFlush();
+    ESP.restart();
+  }
+}
+
+esp_err_t handleRoot(httpd_req_t* req) {
+  httpd_resp_set_hdr(req, "ETag", CONFIG_PAGE_ETAG);
+  httpd_resp_set_hdr(req, "Cache-Control", "public, max-age=86400");
+
+  char inm[40];
+  if (httpd_req_get_hdr_value_str(req, "If-None-Match", inm, sizeof(inm)) == ESP_OK &&
+      strcmp(inm, CONFIG_PAGE_ETAG) == 0) {
+    httpd_resp_set_status(req, "304 Not Modified");
+    return httpd_resp_send(req, nullptr, 0);
+  }
+
+  httpd_resp_set_type(req, "text/html");
+  httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+  return httpd_resp_send(req, (const char*)CONFIG_PAGE_GZ, CONFIG_PAGE_GZ_LEN);
+}
+
+// Credentials from the form wait here while the portal tries them; the result is polled by the
+// page through GET /status. Written by the HTTP task, acted on by the portal task.
+enum PortalCheck : uint8_t {
+  PORTAL_CHECK_IDLE,
+  PORTAL_CHECK_RUNNING,
+  PORTAL_CHECK_OK,
+  PORTAL_CHECK_NO_SSID,
+  PORTAL_CHECK_BAD_PASSWORD,
+  PORTAL_CHECK_FAILED,
+};
+const char* const PORTAL_CHECK_NAMES[] = { "idle", "checking", "ok", "no_ssid", "bad_password", "failed" };
+struct PortalPending {
+  char ssid[33];
+  char pass[65];
+  char user[65];
+  char aioKey[65];
+  char feedKey[65];
+};
+PortalPending portalPending = {};
+volatile PortalCheck portalCheck = PORTAL_CHECK_IDLE;
+
+// Scan results, rendered once per scan and sent as is to every GET /scan
+const size_t SCAN_JSON_MAX = 1536;
+char scanJson[SCAN_JSON_MAX] = "[]";
+size_t scanJsonLen = 2;
+SemaphoreHandle_t scanJsonLock = nullptr;
+ScanList scanCache = {};
+bool scanRunning = false;
+
+// What a page served while the check runs shows, in place of a reboot
+const char SAVE_RESPONSE_HTML[] =
+  "<!DOCTYPE html><html><head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1\">"
+  "<title>Beeper Setup</title><style>body{font-family:Arial;padding:10px}</style></head><body>"
+  "<h3 id=\"msg\">Checking the WiFi network...</h3><p><a id=\"back\" href=\"/\" hidden>Back to setup</a></p>"
+  "<script>"
+  "const T={ok:'Connected! Saved, rebooting. Listen for the ready beep.',"
+  "no_ssid:'That network was not found. Names are case-sensitive, and it must be 2.4 GHz.',"
+  "bad_password:'The WiFi password was rejected.',failed:'Could not join that network.'};"
+  "const msg=document.getElementById('msg'),back=document.getElementById('back');"
+  "function poll(){fetch('/status').then(r=>r.json()).then(s=>{"
+  "if(s.state==='checking'){setTimeout(poll,1000);return}"
+  "msg.textContent=T[s.state]||s.state;back.hidden=s.state==='ok'})"
+  ".catch(()=>setTimeout(poll,1000))}"
+  "poll();"
+  "</script></body></html>";
+
+esp_err_t handleSave(httpd_req_t* req) {
+  static char body[PORTAL_FORM_MAX];
+  if (req->content_len >= sizeof(body)) {
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Form too large");
+    return ESP_OK;
+  }
+  size_t got = 0;
+  while (got < req->content_len) {
+    int n = httpd_req_recv(req, body + got, req->content_len - got);
+    if (n <= 0) {
+      if (n == HTTPD_SOCK_ERR_TIMEOUT) continue;
+      return ESP_FAIL;
+    }
+    got += n;
+  }
+  body[got] = '\0';
+
+  if (portalCheck == PORTAL_CHECK_RUNNING || portalCheck == PORTAL_CHECK_OK) {
+    // a resubmit while the first one is still being tried: just show its progress
+    httpd_resp_set_type(req, "text/html");
+    return httpd_resp_send(req, SAVE_RESPONSE_HTML, sizeof(SAVE_RESPONSE_HTML) - 1);
+  }
+
+  PortalPending& f = portalPending;
+  struct FormSpec {
+    const char* key;
+    char* out;
+    size_t len;
+    bool required;
+  };
+  const FormSpec fields[] = {
+    { "ssid", f.ssid, sizeof(f.ssid), true },
+    { "pass", f.pass, sizeof(f.pass), false }, // open networks have none
+    { "ada_user", f.user, sizeof(f.user), true },
+    { "ada_key", f.aioKey, sizeof(f.aioKey), true },
+    { "feed_key", f.feedKey, sizeof(f.feedKey), true },
+  };
+  for (const FormSpec& field : fields) {
+    FormResult r = formField(body, field.key, field.out, field.len);
+    if (r == FORM_TOO_LONG) {
+      char msg[48];
+      snprintf(msg, sizeof(msg), "Too long: %s (at most %u characters)", field.key, (unsigned)field.len - 1);
+      httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, msg);
+      return ESP_OK;
+    }
+    if (r == FORM_MISSING) field.out[0] = '\0';
+    if (field.required && field.out[0] == '\0') {
+      httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing fields");
+      return ESP_OK;
+    }
+  }
+
+  portalCheck = PORTAL_CHECK_RUNNING;
+  xEventGroupSetBits(linkEvents, PORTAL_SAVE_BIT);
+
+  httpd_resp_set_type(req, "text/html");
+  return httpd_resp_send(req, SAVE_RESPONSE_HTML, sizeof(SAVE_RESPONSE_HTML) - 1);
+}
+
+esp_err_t handleStatus(httpd_req_t* req) {
+  char json[40];
+  int len = snprintf(json, sizeof(json), "{\"state\":\"%s\"}", PORTAL_CHECK_NAMES[portalCheck]);
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+  return httpd_resp_send(req, json, len);
+}
+
+// The cached scan; "?refresh=1" also starts a new one (the page asks again a few seconds later)
+esp_err_t handleScan(httpd_req_t* req) {
+  char query[16];
+  if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK && strstr(query, "refresh=1")) {
+    xEventGroupSetBits(linkEvents, PORTAL_RESCAN_BIT);
+  }
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+  xSemaphoreTake(scanJsonLock, portMAX_DELAY);
+  esp_err_t err = httpd_resp_send(req, scanJson, scanJsonLen);
+  xSemaphoreGive(scanJsonLock);
+  return err;
+}
+
+// Everything else (phones' connectivity checks, with DNS pointing them here) goes to the page
+esp_err_t handleCaptiveRedirect(httpd_req_t* req, httpd_err_code_t) {
+  char location[32];
+  IPAddress ip = WiFi.softAPIP();
+  snprintf(location, sizeof(location), "http://%u.%u.%u.%u/", ip[0], ip[1], ip[2], ip[3]);
+  httpd_resp_set_status(req, "302 Found");
+  httpd_resp_set_hdr(req, "Location", location);
+  return httpd_resp_send(req, nullptr, 0);
+}
+
 void handleResetPrefs() {
-  pinMode(BUZZER_PIN, OUTPUT);
-  prefs.begin("config", false);
-  digitalWrite(BUZZER_PIN, HIGH);
-  delay(50);
-  digitalWrite(BUZZER_PIN, LOW);
-  delay(250);
-  digitalWrite(BUZZER_PIN, HIGH);
-  delay(50);
-  digitalWrite(BUZZER_PIN, LOW);
-  pinMode(BUZZER_PIN, INPUT);
+  playPattern(PAT_RESET);
 
+  prefs.begin("config", false);
   prefs.clear();
   prefs.end();
+  fastConnect.magic = 0; // would otherwise outlive the restart in RTC memory
+
+  waitForPatternIdle();
+  logFlush();
   delay(500);
   esp_restart();
 }
 
 // ---------- Provisioning portal ----------
+bool wifiUp();
+
+void startPortalScan() {
+  if (scanRunning || portalCheck == PORTAL_CHECK_RUNNING) return;
+  scanRunning = WiFi.scanNetworks(true, false, false, WIFI_SCAN_MS_PER_CHANNEL) == WIFI_SCAN_RUNNING;
+}
+
+// Finished scan into scanCache (empty if the scan failed); returns the raw result count
+int16_t readScanResults() {
+  int16_t found = WiFi.scanComplete();
+  ScanList list = {};
+  for (int16_t i = 0; i < found; i++) {
+    scanListAdd(list, WiFi.SSID(i).c_str(), (int8_t)WiFi.RSSI(i), (uint8_t)WiFi.channel(i),
+                WiFi.encryptionType(i) == WIFI_AUTH_OPEN);
+  }
+  WiFi.scanDelete();
+  scanCache = list;
+  return found;
+}
+
+void cachePortalScan() {
+  scanRunning = false;
+  int16_t found = readScanResults();
+
+  xSemaphoreTake(scanJsonLock, portMAX_DELAY);
+  scanJsonLen = scanListJson(scanCache, scanJson, sizeof(scanJson));
+  xSemaphoreGive(scanJsonLock);
+  LOGI("Portal scan: %d results, %u networks", (int)found, (unsigned)scanCache.count);
+}
+
+// Join the submitted network next to the AP. Knowing the channel from the scan skips the
+// station's own scan; the AP follows the station to that channel, so phones briefly drop and
+// rejoin, which the page's polling rides out.
+void portalSaveAndRestart() {
+  saveCredentials(portalPending.ssid, portalPending.pass, portalPending.user, portalPending.aioKey,
+                  portalPending.feedKey);
+  portalCheck = PORTAL_CHECK_OK;
+  scheduleRestart(PORTAL_SAVED_RESTART_DELAY_MS);
+}
+
+void startPortalCheck() {
+  if (BEEPER_NODE_ROLE == BEEPER_ROLE_LEAF) {
+    portalSaveAndRestart(); // a leaf never joins WiFi; nothing to try
+    return;
+  }
+  staDisconnectReason = 0;
+  xEventGroupClearBits(linkEvents, LINK_WIFI_UP_BIT);
+  const ScanEntry* seen = scanListFind(scanCache, portalPending.ssid);
+  LOGI("Portal: trying WiFi %s%s", portalPending.ssid, seen ? "" : " (not in the scan)");
+  WiFi.begin(portalPending.ssid, portalPending.pass, seen ? seen->channel : 0);
+}
+
+// What a disconnect reason says about the submitted credentials. Only a missing network or a
+// failed handshake is conclusive; anything else may still recover before the timeout.
+PortalCheck portalCheckFailure(uint8_t reason) {
+  switch (reason) {
+    case WIFI_REASON_NO_AP_FOUND:
+      return PORTAL_CHECK_NO_SSID;
+    case WIFI_REASON_AUTH_FAIL:
+    case WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT:
+    case WIFI_REASON_HANDSHAKE_TIMEOUT:
+    case WIFI_REASON_MIC_FAILURE:
+      return PORTAL_CHECK_BAD_PASSWORD;
+    default:
+      return PORTAL_CHECK_FAILED;
+  }
+}
+
+// Called on every wake while a check runs; settles it once there is an answer.
+void finishPortalCheck(bool timedOut) {
+  if (wifiUp()) {
+    LOGI("Portal: WiFi works; saving and restarting.");
+    portalSaveAndRestart();
+    return;
+  }
+  uint8_t reason = staDisconnectReason;
+  PortalCheck result = portalCheckFailure(reason);
+  if (result == PORTAL_CHECK_FAILED && !timedOut) return;
+  WiFi.disconnect();
+  if (result == PORTAL_CHECK_FAILED && !scanListFind(scanCache, portalPending.ssid)) result = PORTAL_CHECK_NO_SSID;
+  LOGW("Portal: WiFi %s failed (%s, reason %u)", portalPending.ssid, PORTAL_CHECK_NAMES[result], (unsigned)reason);
+  portalCheck = result;
+}
+
 void startConfigPortal() {
-  Serial.println("Starting config portal (AP mode)...");
-  WiFi.mode(WIFI_AP);
-  WiFi.softAP(AP_SSID, AP_PASS);
+  LOGI("Starting config portal (AP mode)...");
+  // AP + station: the station half scans and tries the submitted network
+  WiFi.mode(WIFI_AP_STA);
+  WiFi.setAutoReconnect(false);
+  WiFi.softAP(AP_SSID, AP_PASS, AP_CHANNEL);
   IPAddress apIP = WiFi.softAPIP();
-  Serial.print("AP IP: "); Serial.println(apIP);
+  LOGI("AP IP: %u.%u.%u.%u", apIP[0], apIP[1], apIP[2], apIP[3]);
+
+  // scan straight away, before a phone has had time to join
+  scanJsonLock = xSemaphoreCreateMutex();
+  xEventGroupClearBits(linkEvents, WIFI_SCAN_DONE_BIT); // left over from a failover scan
+  startPortalScan();
+
+  const uint8_t dnsIp[4] = { apIP[0], apIP[1], apIP[2], apIP[3] };
+  captiveDns.begin(dnsIp, DNS_TASK_PRIORITY, NETWORK_TASK_CORE);
 
-  server.on("/", handleRoot);
-  server.on("/save", HTTP_POST, handleSave);
-  server.begin();
+  httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+  config.lru_purge_enable = true; // connectivity probes open sockets and walk away
+  if (httpd_start(&portalServer, &config) == ESP_OK) {
+    httpd_uri_t root = {};
+    root.uri = "/";
+    root.method = HTTP_GET;
+    root.handler = handleRoot;
+    httpd_register_uri_handler(portalServer, &root);
 
-  beepNeedsConfig();
+    httpd_uri_t save = {};
+    save.uri = "/save";
+    save.method = HTTP_POST;
+    save.handler = handleSave;
+    httpd_register_uri_handler(portalServer, &save);
 
-  // Serve portal until reboot or configuration saved
+    httpd_uri_t scan = {};
+    scan.uri = "/scan";
+    scan.method = HTTP_GET;
+    scan.handler = handleScan;
+    httpd_register_uri_handler(portalServer, &scan);
+
+    httpd_uri_t status = {};
+    status.uri = "/status";
+    status.method = HTTP_GET;
+    status.handler = handleStatus;
+    httpd_register_uri_handler(portalServer, &status);
+
+    httpd_register_err_handler(portalServer, HTTPD_404_NOT_FOUND, handleCaptiveRedirect);
+  } else {
+    LOGE("Failed to start portal HTTP server.");
+  }
+
+  playPattern(PAT_NEEDS_CONFIG);
+
+  // Serve the portal until a save restarts us. The HTTP server and DNS have their own tasks;
+  // this one only wakes for scan results, submitted credentials and the station's link events.
+  bool checkQueued = false;
+  unsigned long checkStart = 0;
   while (true) {
-    server.handleClient();
-    delay(2);
+    TickType_t wait = portalCheck == PORTAL_CHECK_RUNNING && !checkQueued ? pdMS_TO_TICKS(1000) : portMAX_DELAY;
+    EventBits_t bits = xEventGroupWaitBits(linkEvents, WIFI_SCAN_DONE_BIT | PORTAL_SAVE_BIT | PORTAL_RESCAN_BIT |
+                                           LINK_CHANGED_BIT, pdTRUE, pdFALSE, wait);
+
+    if (bits & WIFI_SCAN_DONE_BIT) cachePortalScan();
+    if (bits & PORTAL_RESCAN_BIT) startPortalScan();
+    if (bits & PORTAL_SAVE_BIT) checkQueued = true;
+    // a connect can't start mid-scan; the submit waits for the scan to end
+    if (checkQueued && !scanRunning) {
+      checkQueued = false;
+      checkStart = millis();
+      startPortalCheck();
+    }
+    if (portalCheck == PORTAL_CHECK_RUNNING && !checkQueued) {
+      finishPortalCheck(millis() - checkStart >= PORTAL_CHECK_TIMEOUT_MS);
+    }
   }
 }
 
+// ---------- Publish budget ----------
+// Token bucket refilled continuously at PUBLISH_TOKENS_PER_MIN, holding at most PUBLISH_BURST.
+// Only the network task publishes, so no locking is needed.
+struct TokenBucket {
+  uint32_t tokensMilli;   // thousandths of a token
+  int64_t lastRefillUs;
+};
+TokenBucket publishBucket = { PUBLISH_BURST * 1000, 0 };
+
+void publishRefill() {
+  int64_t now = esp_timer_get_time();
+  if (publishBucket.lastRefillUs == 0) publishBucket.lastRefillUs = now;
+  // 1000 milli-tokens per token, PUBLISH_TOKENS_PER_MIN tokens per 60e6 us
+  int64_t earned = (now - publishBucket.lastRefillUs) * PUBLISH_TOKENS_PER_MIN / 60000;
+  if (earned <= 0) return;
+  publishBucket.lastRefillUs = now;
+  uint64_t total = publishBucket.tokensMilli + (uint64_t)earned;
+  publishBucket.tokensMilli = total > PUBLISH_BURST * 1000 ? PUBLISH_BURST * 1000 : (uint32_t)total;
+}
+
+// Takes one publish token if there is one
+bool publishTake() {
+  publishRefill();
+  if (publishBucket.tokensMilli < 1000) return false;
+  publishBucket.tokensMilli -= 1000;
+  return true;
+}
+
+// Milliseconds until publishTake() can succeed
+uint32_t publishWaitMs() {
+  publishRefill();
+  if (publishBucket.tokensMilli >= 1000) return 0;
+  return (1000 - publishBucket.tokensMilli) * 60 / PUBLISH_TOKENS_PER_MIN + 1;
+}
+
+// The broker says we (or the account) are over the limit: stop publishing until tokens regrow
+void publishThrottled() {
+  publishRefill();
+  publishBucket.tokensMilli = 0;
+}
+
 // ---------- MQTT callback ----------
-void mqttCallback(char* topic, byte* payload, unsigned int length) {
-  // convert payload to string
-  String msg;
-  for (unsigned int i = 0; i < length; i++) msg += (char)payload[i];
-  msg.trim();
-
-  Serial.print("MQTT msg on ");
-  Serial.print(topic);
-  Serial.print(": ");
-  Serial.println(msg);
-
-  // look for true (case-insensitive)
-  String lower = msg;
-  lower.toLowerCase();
-  if (lower.indexOf("true") >= 0 || lower == "1") {
-    Serial.println("Ping received -> beep and clear feed");
-    beep();
-
-    // publish "false" to clear feed
-    String pubTopic = adaUsername + "/feeds/" + feedKey;
-    if (mqtt.publish(pubTopic.c_str(), "false")) {
-      Serial.println("Cleared feed via publish.");
-    } else {
-      Serial.println("Failed to publish clear message.");
+// Payload parsing (payloadIsTrigger() and friends) lives in lib/BeeperCore/Payload.h.
+// True when acks must go to the trigger feed (and so come back to us)
+inline bool acksClearTriggerFeed() {
+  return ACK_MODE == ACK_CLEAR_FEED || FALLBACK_TO_DEEPSLEEP_SECONDS > 0 || MQTT_RELIABLE_DELIVERY;
+}
+
+// Triggers already played, so a redelivered or re-fetched one doesn't beep twice. Network task only.
+TriggerDedupe triggerDedupe = {};
+
+// ---------- Control feeds ----------
+// Written by the network task (MQTT callback), read by the app task when a ping plays.
+volatile PatternId defaultMelody = PAT_PING;
+volatile uint8_t buzzerVolume = 100;
+volatile int8_t quietStartHour = -1; // -1 = no quiet hours
+volatile int8_t quietEndHour = -1;
+bool sntpStarted = false;
+
+bool quietHoursNow() {
+  int8_t start = quietStartHour;
+  int8_t end = quietEndHour;
+  if (start < 0 || end < 0 || start == end) return false;
+  time_t now = time(nullptr);
+  if (now < 1600000000) return false; // no SNTP time yet: rather beep than stay silent
+  struct tm local;
+  localtime_r(&now, &local);
+  int h = local.tm_hour;
+  return start < end ? (h >= start && h < end) : (h >= start || h < end);
+}
+
+// LEDC duty for a ping right now, from the volume and quiet-hours feeds
+uint16_t triggerDuty() {
+  if (quietHoursNow()) return 0;
+  uint8_t volume = buzzerVolume;
+  if (!BUZZER_IS_PASSIVE) return volume > 0 ? BUZZER_DUTY_ON : 0;
+  return (uint16_t)((uint32_t)BUZZER_DUTY_ON * volume / 100u);
+}
+
+void handleTrigger(const byte* payload, unsigned int length, TriggerSource source) {
+  if (!payloadIsTrigger(payload, length)) return;
+  int64_t rxUs = esp_timer_get_time();
+  if (MQTT_RELIABLE_DELIVERY && triggerDedupeSeen(triggerDedupe, payload, length, millis(), DEDUPE_PLAIN_WINDOW_MS)) {
+    LOGD("Ping already played, dropped.");
+    telemetry.count(TC_DUPLICATES);
+    return;
+  }
+  uint32_t triggerId = payloadTriggerId(payload, length);
+  PatternId melody = payloadMelody(payload, length, defaultMelody);
+  triggerCount++;
+  telemetry.count(TC_TRIGGERS);
+
+  if (BEEPER_NODE_ROLE == BEEPER_ROLE_GATEWAY) {
+    uint8_t target[6];
+    bool targeted = payloadTarget(payload, length, target);
+    uint8_t own[6];
+    WiFi.macAddress(own);
+    bool forUs = !targeted || memcmp(target, own, sizeof(own)) == 0;
+    if (!forUs || !targeted) relay.relayTrigger(targeted ? target : nullptr, triggerId, melody);
+    if (!forUs) {
+      // only a leaf beeps; the feed is still ours to ack
+      LOGD("Ping relayed to leaf");
+      if (source == TRIGGER_SRC_MQTT) {
+        NetRequest req = { NET_REQ_CLEAR_FEED, triggerId, 0, 0 };
+        sendNetRequest(req);
+      }
+      return;
     }
   }
 
+  LOGD("Ping received -> beep and clear feed");
+  AppEvent ev = { APP_EV_TRIGGER, rxUs, triggerId, source, melody };
+  xQueueSend(appQueue, &ev, 0);
+}
+
+void onTriggerFeed(const byte* payload, unsigned int length) {
+  handleTrigger(payload, length, TRIGGER_SRC_MQTT);
+}
+
+void onFleetFeed(const byte* payload, unsigned int length) {
+  handleTrigger(payload, length, TRIGGER_SRC_FLEET);
+}
+
+void onPatternFeed(const byte* payload, unsigned int length) {
+  payloadTrim(payload, length);
+  defaultMelody = patternByName(payload, length, PAT_PING);
+  LOGI("Default melody: %s", PATTERNS[defaultMelody].name);
+}
+
+void onVolumeFeed(const byte* payload, unsigned int length) {
+  payloadTrim(payload, length);
+  long v = payloadNumber(payload, length);
+  if (v < 0) return;
+  buzzerVolume = (uint8_t)(v > 100 ? 100 : v);
+  LOGI("Volume: %u%%", (unsigned)buzzerVolume);
+}
+
+// "<start>-<end>" in whole hours, local time; anything else turns quiet hours off
+void onQuietFeed(const byte* payload, unsigned int length) {
+  payloadTrim(payload, length);
+  long start = payloadNumber(payload, length);
+  long end = -1;
+  if (start >= 0 && length > 0 && payload[0] == '-') {
+    payload++;
+    length--;
+    end = payloadNumber(payload, length);
+  }
+  if (start < 0 || start > 23 || end < 0 || end > 23 || length != 0) {
+    quietStartHour = -1;
+    quietEndHour = -1;
+    LOGI("Quiet hours off");
+    return;
+  }
+  if (!sntpStarted) {
+    configTzTime(QUIET_HOURS_TZ, NTP_SERVER);
+    sntpStarted = true;
+  }
+  quietStartHour = (int8_t)start;
+  quietEndHour = (int8_t)end;
+  LOGI("Quiet hours %02ld:00-%02ld:00", start, end);
+}
+
+// OTA task: the new image is set to boot; restart once nothing is playing
+void onOtaDone(bool ok) {
+  if (!ok) {
+    LOGW("OTA update refused or failed, staying on this firmware.");
+    return;
+  }
+  waitForPatternIdle();
+  LOGI("Restarting into the new firmware.");
+  logFlush();
+  esp_restart();
+}
+
+void onOtaFeed(const byte* payload, unsigned int length) {
+  static OtaUpdater::Request req;
+  if (ota.busy()) {
+    LOGW("OTA already running, request ignored.");
+    return;
+  }
+  if (!otaRequestParse((const char*)payload, length, req)) {
+    LOGE("OTA request malformed.");
+    return;
+  }
+  ota.start(req, onOtaDone, pmHoldTls, OTA_TASK_PRIORITY, APP_TASK_CORE);
+}
+
+void onThrottle(const byte*, unsigned int) {
+  publishThrottled();
+}
+
+// ---------- Topic dispatch ----------
+// Every topic the device listens on, as a fixed table. At connect each enabled route's topic is
+// rendered once, straight into the SUBSCRIBE packet, and hashed (FNV-1a); an incoming message is
+// hashed once and matched on hash and length, then confirmed with one memcmp.
+enum TopicBase : uint8_t {
+  TOPIC_FEED_SUFFIX,  // "<user>/feeds/<FEED_KEY><name>"
+  TOPIC_FEED,         // "<user>/feeds/<name>" (skipped if name is empty)
+  TOPIC_USER,         // "<user>/<name>"
+};
+typedef void (*TopicHandler)(const byte* payload, unsigned int length);
+struct TopicRoute {
+  TopicBase base;
+  const char* name;
+  bool enabled;
+  uint8_t qos;  // requested in the SUBSCRIBE
+  TopicHandler handler;
+};
+
+// Control feeds only matter while we're connected, and their last values come with every
+// (re)connect anyway; only pings are worth a queue at the broker.
+const uint8_t TRIGGER_QOS = MQTT_RELIABLE_DELIVERY ? 1 : 0;
+
+const TopicRoute TOPIC_ROUTES[] = {
+  { TOPIC_FEED_SUFFIX, "", true, TRIGGER_QOS, onTriggerFeed },  // TRIGGER_ROUTE
+  { TOPIC_FEED_SUFFIX, "-pattern", ENABLE_CONTROL_FEEDS, 0, onPatternFeed },
+  { TOPIC_FEED_SUFFIX, "-volume", ENABLE_CONTROL_FEEDS, 0, onVolumeFeed },
+  { TOPIC_FEED_SUFFIX, "-quiet", ENABLE_CONTROL_FEEDS, 0, onQuietFeed },
+  { TOPIC_FEED_SUFFIX, "-ota", ENABLE_OTA, 0, onOtaFeed },
+  { TOPIC_FEED, FLEET_FEED_KEY, true, TRIGGER_QOS, onFleetFeed },
+  { TOPIC_USER, "throttle", true, 0, onThrottle },
+};
+const size_t TOPIC_ROUTE_COUNT = sizeof(TOPIC_ROUTES) / sizeof(TOPIC_ROUTES[0]);
+const size_t TRIGGER_ROUTE = 0;
+
+const uint16_t SUBSCRIBE_PACKET_ID = 0x5B5B; // PubSubClient numbers its own packets from 1
+const size_t SUBSCRIBE_HEADER_MAX = 5;       // type byte + up to 4 bytes of remaining length
+
+struct RouteTopic {
+  uint32_t hash;
+  uint16_t offset;  // of the topic inside subscribePacket
+  uint16_t len;     // 0 = not subscribed
+};
+RouteTopic routeTopics[TOPIC_ROUTE_COUNT];
+uint8_t subscribePacket[SUBSCRIBE_PACKET_MAX];
+size_t subscribePacketStart = 0;
+size_t subscribePacketLen = 0;
+
+uint32_t topicHash(const char* s, size_t len) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    h ^= (uint8_t)s[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+void buildTopicRoutes() {
+  size_t pos = SUBSCRIBE_HEADER_MAX;
+  subscribePacket[pos++] = (uint8_t)(SUBSCRIBE_PACKET_ID >> 8);
+  subscribePacket[pos++] = (uint8_t)(SUBSCRIBE_PACKET_ID & 0xFF);
+  for (size_t i = 0; i < TOPIC_ROUTE_COUNT; i++) {
+    const TopicRoute& route = TOPIC_ROUTES[i];
+    routeTopics[i] = {};
+    if (!route.enabled || (route.base == TOPIC_FEED && route.name[0] == '\0')) continue;
+
+    // topic text after its 2-byte length; snprintf's terminator lands where the QoS byte goes
+    char* topic = (char*)subscribePacket + pos + 2;
+    size_t room = SUBSCRIBE_PACKET_MAX - pos - 2;
+    int n;
+    switch (route.base) {
+      case TOPIC_FEED_SUFFIX: n = snprintf(topic, room, "%s/feeds/%s%s", config.adaUser, config.feedKey, route.name); break;
+      case TOPIC_FEED: n = snprintf(topic, room, "%s/feeds/%s", config.adaUser, route.name); break;
+      default: n = snprintf(topic, room, "%s/%s", config.adaUser, route.name); break;
+    }
+    if (n <= 0 || (size_t)n >= room) {
+      LOGE("Topic route %u does not fit the SUBSCRIBE packet.", (unsigned)i);
+      continue;
+    }
+    subscribePacket[pos] = (uint8_t)(n >> 8);
+    subscribePacket[pos + 1] = (uint8_t)(n & 0xFF);
+    routeTopics[i] = { topicHash(topic, (size_t)n), (uint16_t)(pos + 2), (uint16_t)n };
+    pos += 2 + (size_t)n;
+    subscribePacket[pos++] = route.qos;
+  }
+
+  // fixed header packed right in front of the packet id
+  size_t remaining = pos - SUBSCRIBE_HEADER_MAX;
+  uint8_t lenBytes[4];
+  size_t lenCount = 0;
+  do {
+    uint8_t b = remaining % 128;
+    remaining /= 128;
+    if (remaining > 0) b |= 0x80;
+    lenBytes[lenCount++] = b;
+  } while (remaining > 0 && lenCount < sizeof(lenBytes));
+  subscribePacketStart = SUBSCRIBE_HEADER_MAX - 1 - lenCount;
+  subscribePacket[subscribePacketStart] = 0x82; // SUBSCRIBE, reserved flags 0010
+  memcpy(subscribePacket + subscribePacketStart + 1, lenBytes, lenCount);
+  subscribePacketLen = pos - subscribePacketStart;
+}
+
+// PubSubClient sends one SUBSCRIBE per topic and waits on nothing; this sends one for all routes.
+// The SUBACK is ignored by PubSubClient's loop(), as it is for its own subscribes.
+size_t subscribedRouteCount() {
+  size_t n = 0;
+  for (const RouteTopic& t : routeTopics) n += t.len > 0;
+  return n;
+}
+
+bool mqttSubscribeAll() {
+  subscribeSentUs = esp_timer_get_time();
+  if (mqtt.write(subscribePacket + subscribePacketStart, subscribePacketLen) == subscribePacketLen) return true;
+  subscribeSentUs = 0;
+  return false;
+}
+
+// loop() reads one packet per call and drops a SUBACK unseen, so the subscribe round trip is
+// timed here, when the next packet waiting is the SUBACK (type 9, first byte 0x90)
+bool mqttLoop() {
+  if (subscribeSentUs != 0 && tlsClient.available() > 0 && tlsClient.peek() == 0x90) {
+    telemetry.record(TM_MQTT_SUBSCRIBE_MS, (uint32_t)((esp_timer_get_time() - subscribeSentUs) / 1000));
+    subscribeSentUs = 0;
+  }
+  return mqtt.loop();
+}
+
+// Index of the TOPIC_ROUTES entry `topic` arrived through; TOPIC_ROUTE_COUNT if none
+size_t routeForTopic(const char* topic) {
+  size_t len = strlen(topic);
+  uint32_t hash = topicHash(topic, len);
+  for (size_t i = 0; i < TOPIC_ROUTE_COUNT; i++) {
+    const RouteTopic& t = routeTopics[i];
+    if (t.len == len && t.hash == hash && memcmp(subscribePacket + t.offset, topic, len) == 0) return i;
+  }
+  return TOPIC_ROUTE_COUNT;
+}
+
+void mqttCallback(char* topic, byte* payload, unsigned int length) {
+  mqttMsgCount++;
   lastMqttMsgTime = millis();
+
+  // Our own clear coming back on the trigger feed: note the round trip and drop it before any
+  // logging or parsing. Other feeds may say "false" and mean it.
+  size_t route = routeForTopic(topic);
+  if (route == TRIGGER_ROUTE && length >= 5 && memcmp(payload, "false", 5) == 0) {
+    if (clearSentUs != 0) {
+      telemetry.record(TM_CLEAR_RTT_MS, (uint32_t)((esp_timer_get_time() - clearSentUs) / 1000));
+      clearSentUs = 0;
+    }
+    return;
+  }
+
+  LOGD("MQTT msg on %s: %.*s", topic, (int)length, (const char*)payload);
+  if (route < TOPIC_ROUTE_COUNT) TOPIC_ROUTES[route].handler(payload, length);
+}
+
+// Runs on the network task: publishes requested by other tasks. Waits up to `wait` for the first one.
+// Acks are held in deferredAck until the publish budget allows them; a newer one replaces an
+// older one that never went out, since only the latest value of the feed matters.
+NetRequest deferredAck;
+bool haveDeferredAck = false;
+
+void flushDeferredAck() {
+  if (!haveDeferredAck || !mqtt.connected() || !publishTake()) return;
+  haveDeferredAck = false;
+
+  // publish "false" to clear feed (or the ack feed); benchmark triggers get their id and timing echoed back
+  char clearMsg[48] = "false";
+  if (deferredAck.triggerId != 0) {
+    snprintf(clearMsg, sizeof(clearMsg), "false id=%lu rxb=%lu n=%u", (unsigned long)deferredAck.triggerId,
+             (unsigned long)deferredAck.rxToBeepUs, (unsigned)deferredAck.merged + 1);
+  }
+  bool clearFeed = acksClearTriggerFeed();
+  if (mqtt.publish(clearFeed ? feedTopic : ackTopic, clearMsg)) {
+    LOGD("%s", clearFeed ? "Cleared feed via publish." : "Acked via ack feed.");
+    if (clearFeed) {
+      clearSentUs = esp_timer_get_time();
+      sleepState.pendingClear = false;
+    }
+  } else {
+    LOGE("Failed to publish clear message.");
+    // only a clear of the trigger feed matters later; a lost ack is just a lost ack
+    if (clearFeed) sleepState.pendingClear = true; // retried after the next connect
+  }
+}
+
+void processNetRequests(TickType_t wait) {
+  NetRequest req;
+  while (xQueueReceive(netQueue, &req, wait) == pdTRUE) {
+    wait = 0;
+    switch (req.type) {
+      case NET_REQ_CLEAR_FEED:
+        if (haveDeferredAck) {
+          req.merged += deferredAck.merged + 1;
+          // the older ack is still here because flushDeferredAck() found one of these
+          LOGD("Ack still deferred (%s), merging.", mqtt.connected() ? "no publish token" : "not connected");
+        }
+        deferredAck = req;
+        haveDeferredAck = true;
+        break;
+    }
+  }
+  flushDeferredAck();
+}
+
+// Adafruit IO answers a publish to "<feed>/get" by re-sending the feed's last value
+bool requestRetainedValue() {
+  char getTopic[FEED_TOPIC_MAX + 4];
+  snprintf(getTopic, sizeof(getTopic), "%s/get", feedTopic);
+  return publishTake() && mqtt.publish(getTopic, "");
+}
+
+// ---------- LAN trigger ----------
+// Runs on the LAN task
+void onLanTrigger(uint32_t triggerId, int64_t rxUs) {
+  LOGD("LAN ping received -> beep");
+  triggerCount++;
+  telemetry.count(TC_TRIGGERS);
+  AppEvent ev = { APP_EV_TRIGGER, rxUs, triggerId, TRIGGER_SRC_LAN, defaultMelody };
+  xQueueSend(appQueue, &ev, 0);
+}
+
+// Own Preferences handle: these run on the LAN/WiFi tasks, alongside users of `prefs`
+void loadReplayWindow(const char* key, ReplayWindow& w) {
+  if (replayWindowValid(w)) return; // kept in RTC memory across the restart
+  Preferences p;
+  bool ok = p.begin("replay", true) && p.getBytes(key, &w, sizeof(w)) == sizeof(w) && replayWindowValid(w);
+  p.end();
+  if (!ok) replayWindowReset(w);
+}
+
+void saveReplayWindow(const char* key, const ReplayWindow& w) {
+  Preferences p;
+  if (p.begin("replay", false)) p.putBytes(key, &w, sizeof(w));
+  p.end();
+}
+
+void onLanReplayChanged(const ReplayWindow& w) {
+  portENTER_CRITICAL(&lanReplayMux);
+  lanReplayToSave = w;
+  lanReplayChangedUs = esp_timer_get_time();
+  lanReplayDirty = true;
+  portEXIT_CRITICAL(&lanReplayMux);
+}
+
+void startLanTrigger() {
+  if (!ENABLE_LAN_TRIGGER) return;
+  lanTrigger.setKey(config.adaKey, config.feedKey);
+  loadReplayWindow("lan", lanReplay);
+  lanTrigger.setReplayWindow(&lanReplay, onLanReplayChanged);
+  lanTrigger.begin(LAN_TRIGGER_PORT, onLanTrigger, LAN_TASK_PRIORITY, NETWORK_TASK_CORE);
+}
+
+// mDNS needs an IP, so this runs the first time WiFi comes up; the responder follows later
+// reconnects on its own.
+void startMdns() {
+  if (!ENABLE_LAN_TRIGGER || mdnsStarted) return;
+  if (!MDNS.begin(MDNS_HOSTNAME)) {
+    LOGE("mDNS start failed.");
+    return;
+  }
+  MDNS.addService("beeper", "udp", LAN_TRIGGER_PORT);
+  mdnsStarted = true;
+  LOGI("mDNS: %s.local, _beeper._udp port %u", MDNS_HOSTNAME, (unsigned)LAN_TRIGGER_PORT);
+}
+
+// ---------- ESP-NOW cluster ----------
+// Gateway: relaying needs the radio on the AP's channel, so this runs once WiFi is up.
+// Gateway: one more than the last boot's session, stored before it is used so no two boots
+// share one. 0 if NVS won't take it.
+uint32_t nextRelaySession() {
+  Preferences p;
+  uint32_t session = 0;
+  if (p.begin("replay", false)) {
+    session = p.getUInt("relay_boot", 0) + 1;
+    if (p.putUInt("relay_boot", session) == 0) session = 0;
+  }
+  p.end();
+  return session;
+}
+
+void startRelayGateway() {
+  if (BEEPER_NODE_ROLE != BEEPER_ROLE_GATEWAY || relayStarted) return;
+  static uint32_t session = nextRelaySession();
+  relay.setKey(config.adaKey, config.feedKey);
+  relay.setRepeat(RELAY_REPEAT_MS, RELAY_REPEAT_COUNT);
+  relay.setSession(session);
+  relayStarted = relay.begin(true, nullptr);
+  if (relayStarted) LOGI("ESP-NOW gateway on channel %ld", (long)WiFi.channel());
+}
+
+// Leaf: these run from the ESP-NOW receive callback
+void onRelayReplayChanged(const ReplayWindow& w) {
+  portENTER_CRITICAL(&relayReplayMux);
+  relayReplayToSave = w;
+  relayReplayDirty = true;
+  portEXIT_CRITICAL(&relayReplayMux);
+}
+
+void onRelayTrigger(uint32_t triggerId, uint8_t melody, int64_t rxUs) {
+  triggerCount++;
+  telemetry.count(TC_TRIGGERS);
+  AppEvent ev = { APP_EV_TRIGGER, rxUs, triggerId, TRIGGER_SRC_RELAY, melody < PAT_COUNT && PATTERNS[melody].selectable ? (PatternId)melody : PAT_PING };
+  xQueueSend(appQueue, &ev, 0);
+}
+
+// Leaf main loop: short listen windows with timed light sleep in between. The radio stays in
+// STA mode without associating, so there is no AP, DHCP or TLS work at all.
+void leafTask(void*) {
+  WiFi.mode(WIFI_STA);
+  WiFi.disconnect();
+  relay.setKey(config.adaKey, config.feedKey);
+  loadReplayWindow("relay", relayReplay);
+  relay.setReplayWindow(&relayReplay, onRelayReplayChanged);
+  if (!relay.begin(false, onRelayTrigger)) {
+    vTaskDelete(nullptr);
+  }
+  LOGI("ESP-NOW leaf, MAC %s", WiFi.macAddress().c_str());
+
+  for (;;) {
+    int64_t sinceHeardUs = esp_timer_get_time() - relay.lastHeardUs();
+    if (relay.channel() == 0 || sinceHeardUs > (int64_t)LEAF_GATEWAY_LOST_S * 1000000LL) {
+      if (!relay.findGateway(RELAY_SCAN_DWELL_MS)) {
+        LOGW("No ESP-NOW gateway heard, retrying.");
+        continue;
+      }
+      playPattern(PAT_PING); // same "ready" beep as a standalone unit
+    }
+
+    vTaskDelay(pdMS_TO_TICKS(LEAF_LISTEN_MS));
+    if (relayReplayDirty) {
+      ReplayWindow snapshot;
+      portENTER_CRITICAL(&relayReplayMux);
+      snapshot = relayReplayToSave;
+      relayReplayDirty = false;
+      portEXIT_CRITICAL(&relayReplayMux);
+      saveReplayWindow("relay", snapshot);
+    }
+    // the pattern engine runs on esp_timer, which stops in light sleep
+    if (LEAF_SLEEP_MS > 0 && !patternBusy() && digitalRead(RESET_BTN) == HIGH) {
+      esp_sleep_enable_timer_wakeup((uint64_t)LEAF_SLEEP_MS * 1000);
+      esp_light_sleep_start(); // the reset button's GPIO wake is armed by the input task
+    }
+  }
+}
+
+// ---------- Adaptive keepalive ----------
+bool wifiPowerSaveOn() {
+  return ENABLE_WIFI_POWERSAVE || BEEPER_AUTO_LIGHT_SLEEP;
+}
+
+bool adaptiveKeepAliveOn() {
+  return ENABLE_ADAPTIVE_KEEPALIVE && wifiPowerSaveOn();
+}
+
+uint16_t keepAliveForConnect() {
+  if (!adaptiveKeepAliveOn()) return KEEPALIVE_DEFAULT_S;
+  if (keepAliveProbe.magic != KEEPALIVE_PROBE_MAGIC) {
+    keepAliveProbe = { KEEPALIVE_PROBE_MAGIC, KEEPALIVE_DEFAULT_S, 0, KEEPALIVE_START_S, false };
+  }
+  return keepAliveProbe.tryingS;
+}
+
+// While LINK_UP: once the current value has held long enough, remember it and ask for a
+// reconnect to try the next one (a resumed TLS handshake, a handful of times per boot).
+bool keepAliveWantsStepUp() {
+  KeepAliveProbe& p = keepAliveProbe;
+  if (!adaptiveKeepAliveOn() || p.settled || mqttConnectedUs == 0) return false;
+  int64_t heldUs = esp_timer_get_time() - mqttConnectedUs;
+  if (heldUs < (int64_t)p.tryingS * KEEPALIVE_CONFIRM_ROUNDS * 1000000LL) return false;
+  if (haveDeferredAck || patternBusy()) return false; // not in the middle of a ping
+
+  if (!keepAliveProbeHeld(p, KEEPALIVE_LIMITS)) {
+    LOGI("Keepalive settled at %u s", (unsigned)p.goodS);
+    return false;
+  }
+  LOGI("Keepalive %u s held, trying %u s", (unsigned)p.goodS, (unsigned)p.tryingS);
+  mqttConnectedUs = 0;
+  return true;
+}
+
+// The connection dropped while up. A keepalive timeout (or a reset) after at least one full
+// interval is what a NAT mapping expiring looks like; anything sooner is something else.
+void keepAliveOnDrop(int mqttState) {
+  KeepAliveProbe& p = keepAliveProbe;
+  if (!adaptiveKeepAliveOn() || mqttConnectedUs == 0) return;
+  int64_t heldUs = esp_timer_get_time() - mqttConnectedUs;
+  mqttConnectedUs = 0;
+  bool idleDrop = mqttState == MQTT_CONNECTION_TIMEOUT || mqttState == MQTT_CONNECTION_LOST;
+  if (!idleDrop || heldUs < (int64_t)p.tryingS * 1000000LL) return;
+
+  uint16_t failed = p.tryingS;
+  keepAliveProbeTimedOut(p, KEEPALIVE_LIMITS);
+  LOGW("Keepalive %u s timed out, next %u s", (unsigned)failed, (unsigned)p.tryingS);
 }
 
 // ---------- MQTT connect helper ----------
 bool connectToMqtt() {
-  if (adaUsername.length() == 0 || adaKey.length() == 0) {
-    Serial.println("Adafruit IO credentials missing.");
+  if (config.adaUser[0] == '\0' || config.adaKey[0] == '\0') {
+    LOGW("Adafruit IO credentials missing.");
     return false;
   }
 
-  String mqttHost = "io.adafruit.com";
-  int mqttPort = 8883;
+  snprintf(feedTopic, sizeof(feedTopic), "%s/feeds/%s", config.adaUser, config.feedKey);
+  snprintf(diagTopic, sizeof(diagTopic), "%s%s", feedTopic, DIAG_FEED_SUFFIX);
+  snprintf(logTopic, sizeof(logTopic), "%s%s", feedTopic, LOG_FEED_SUFFIX);
+  snprintf(ackTopic, sizeof(ackTopic), "%s%s", feedTopic, ACK_FEED_SUFFIX);
+  buildTopicRoutes();
 
-  mqtt.setServer(mqttHost.c_str(), mqttPort);
+  mqtt.setServer(MQTT_HOST, MQTT_PORT);
   mqtt.setCallback(mqttCallback);
+  mqttKeepAliveS = keepAliveForConnect();
+  mqtt.setKeepAlive(mqttKeepAliveS);
+  // PubSubClient reallocates on every call, so size the buffer once per boot
+  static bool bufferSized = false;
+  if (!bufferSized) bufferSized = mqtt.setBufferSize(MQTT_BUFFER_SIZE);
 
-  // WiFiClientSecure setup: insecure mode used here for easier usage.
-  // For production, replace setInsecure() with setCACert() and load Adafruit IO root CA.
-  secureClient.setInsecure();
+  // Verify io.adafruit.com against the pinned DigiCert roots (see aio_root_ca.h).
+  // The client keeps the negotiated session so reconnects resume instead of redoing the full handshake.
+  tlsClient.setTrustAnchors(AIO_ROOT_CAS, AIO_ROOT_CA_LENS, AIO_ROOT_CA_COUNT);
+  tlsClient.setMaxFragmentLength(TLS_MAX_FRAGMENT_LEN);
 
   // clientID must be unique
-  String clientId = "esp32-beeper-";
-  clientId += String((uint32_t)ESP.getEfuseMac(), HEX);
+  static char clientId[32] = "";
+  if (clientId[0] == '\0') snprintf(clientId, sizeof(clientId), "esp32-beeper-%lx", (unsigned long)(uint32_t)ESP.getEfuseMac());
 
-  Serial.print("Connecting to MQTT as ");
-  Serial.println(clientId);
+  LOGI("Connecting to MQTT as %s", clientId);
 
-  if (mqtt.connect(clientId.c_str(), adaUsername.c_str(), adaKey.c_str())) {
-    Serial.println("MQTT connected.");
-    String subTopic = adaUsername + "/feeds/" + feedKey;
-    if (mqtt.subscribe(subTopic.c_str())) {
-      Serial.print("Subscribed to: "); Serial.println(subTopic);
+  unsigned long connectStart = millis();
+  pmHoldTls(true);
+  // no will; a persistent session only when we want the broker to queue pings for us
+  bool connected = mqtt.connect(clientId, config.adaUser, config.adaKey, nullptr, 0, false, nullptr,
+                                !MQTT_RELIABLE_DELIVERY);
+  pmHoldTls(false);
+  if (connected) {
+    unsigned long connectMs = millis() - connectStart;
+    LOGI("MQTT connected in %lu ms (TLS handshake %lu ms, %s).", connectMs,
+                  (unsigned long)tlsClient.lastHandshakeMs(), tlsClient.lastHandshakeResumed() ? "resumed" : "full");
+    telemetry.record(TM_TLS_HANDSHAKE_MS, tlsClient.lastHandshakeMs());
+    telemetry.record(TM_MQTT_CONNECT_MS, connectMs - tlsClient.lastHandshakeMs());
+    tlsSessionLen = (uint16_t)tlsClient.saveSession(tlsSessionBlob, sizeof(tlsSessionBlob));
+    mqttConnectedUs = esp_timer_get_time();
+    if (mqttSubscribeAll()) {
+      LOGI("Subscribed to: %s (+%u more)", feedTopic, (unsigned)(subscribedRouteCount() - 1));
     } else {
-      Serial.println("Subscribe failed.");
+      LOGE("Subscribe failed.");
     }
-    mqttConnectAttempts = 0;
+    if (sleepState.pendingClear && publishTake() && mqtt.publish(feedTopic, "false")) {
+      sleepState.pendingClear = false;
+    }
+    // after the clear, so a ping we already played comes back as "false"
+    if (MQTT_RELIABLE_DELIVERY && !requestRetainedValue()) LOGW("Could not ask for missed pings.");
     return true;
   } else {
-    Serial.print("MQTT connect failed, rc=");
-    Serial.println(mqtt.state());
+    LOGE("MQTT connect failed, rc=%d (TLS error -0x%04x)", mqtt.state(), -tlsClient.lastError());
     return false;
   }
 }
 
-// ---------- Try connect WiFi ----------
-bool tryConnectWiFi(const char* ssid, const char* pass) {
+void restoreTlsSession() {
+  if (tlsSessionLen > 0 && !tlsClient.loadSession(tlsSessionBlob, tlsSessionLen)) {
+    tlsSessionLen = 0;
+  }
+}
+
+// Beacons between wakes under WIFI_PS_MAX_MODEM: a whole number of DTIM periods, at least one
+uint16_t wifiListenInterval() {
+  uint32_t dtimUs = AP_BEACON_INTERVAL_US * (AP_DTIM_PERIOD ? AP_DTIM_PERIOD : 1);
+  uint32_t periods = (WIFI_PS_MAX_ADDED_LATENCY_MS * 1000UL) / dtimUs;
+  if (periods == 0) periods = 1;
+  return (uint16_t)(periods * (AP_DTIM_PERIOD ? AP_DTIM_PERIOD : 1));
+}
+
+void applyWiFiPowerSave() {
+  // optionally enable WiFi power save mode (modem/light)
+  if (!wifiPowerSaveOn()) return;
+  if (!WIFI_PS_USE_MAX_MODEM) {
+    esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+    LOGI("WiFi power save enabled: WIFI_PS_MIN_MODEM");
+    return;
+  }
+  // WiFi.begin() rewrites the station config (listen interval 0 = IDF's default of 3 beacons),
+  // so this runs after every association. The interval only sets the station's own wake schedule.
+  uint16_t listenInterval = wifiListenInterval();
+  wifi_config_t wc;
+  if (esp_wifi_get_config(WIFI_IF_STA, &wc) == ESP_OK && wc.sta.listen_interval != listenInterval) {
+    wc.sta.listen_interval = listenInterval;
+    esp_wifi_set_config(WIFI_IF_STA, &wc);
+  }
+  esp_wifi_set_ps(WIFI_PS_MAX_MODEM);
+  LOGI("WiFi power save enabled: WIFI_PS_MAX_MODEM, listen interval %u beacons (DTIM %u)",
+       (unsigned)listenInterval, (unsigned)AP_DTIM_PERIOD);
+}
+
+// ---------- WiFi ----------
+void onWiFiEvent(arduino_event_id_t event, arduino_event_info_t info) {
+  switch (event) {
+    case ARDUINO_EVENT_WIFI_STA_CONNECTED:
+      wifiAssocUs = esp_timer_get_time();
+      if (wifiBeginUs) telemetry.record(TM_WIFI_ASSOC_MS, (uint32_t)((wifiAssocUs - wifiBeginUs) / 1000));
+      wifiBeginUs = 0;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+      if (wifiAssocUs) telemetry.record(TM_DHCP_MS, (uint32_t)((esp_timer_get_time() - wifiAssocUs) / 1000));
+      wifiAssocUs = 0;
+      xEventGroupSetBits(linkEvents, LINK_WIFI_UP_BIT | LINK_CHANGED_BIT);
+      wakeNetworkTask();
+      break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+      staDisconnectReason = info.wifi_sta_disconnected.reason;
+      // fall through
+    case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+      xEventGroupClearBits(linkEvents, LINK_WIFI_UP_BIT);
+      xEventGroupSetBits(linkEvents, LINK_CHANGED_BIT);
+      wakeNetworkTask();
+      break;
+    case ARDUINO_EVENT_WIFI_SCAN_DONE:
+      xEventGroupSetBits(linkEvents, WIFI_SCAN_DONE_BIT | LINK_CHANGED_BIT);
+      break;
+    default:
+      break;
+  }
+}
+
+void initWiFiEvents() {
+  linkEvents = xEventGroupCreate();
+  WiFi.onEvent(onWiFiEvent, ARDUINO_EVENT_WIFI_STA_CONNECTED);
+  WiFi.onEvent(onWiFiEvent, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+  WiFi.onEvent(onWiFiEvent, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+  WiFi.onEvent(onWiFiEvent, ARDUINO_EVENT_WIFI_STA_LOST_IP);
+  WiFi.onEvent(onWiFiEvent, ARDUINO_EVENT_WIFI_SCAN_DONE);
+}
+
+bool wifiUp() {
+  return (xEventGroupGetBits(linkEvents) & LINK_WIFI_UP_BIT) != 0;
+}
+
+// Association attempts return right away; GOT_IP arrives as a WiFi event.
+void stationMode() {
   WiFi.mode(WIFI_STA);
-  WiFi.begin(ssid, pass);
-  Serial.print("Connecting to WiFi ");
-  Serial.print(ssid);
-  Serial.print(" ...");
+  WiFi.setAutoReconnect(false); // the link supervisor owns retries and their timing
+}
 
-  unsigned long start = millis();
-  const unsigned long timeout = 20000; // 20s
-  while (WiFi.status() != WL_CONNECTED && millis() - start < timeout) {
-    delay(250);
-    Serial.print(".");
+// Rejoin networks[0] through the fast-connect hints. Returns false (nothing started) without them.
+bool beginFastWiFi() {
+  if (!ENABLE_FAST_CONNECT || fastConnect.magic != FAST_CONNECT_MAGIC || configNetworkCount(config) == 0 ||
+      fastConnectFor != configNetworkKey(config.networks[0])) {
+    return false;
   }
-  Serial.println();
+  const SavedNetwork& net = config.networks[0];
+  stationMode();
+  staDisconnectReason = 0;
+  wifiBeginUs = esp_timer_get_time();
+  if (STATIC_IP != IPAddress(0, 0, 0, 0)) {
+    WiFi.config(STATIC_IP, STATIC_GATEWAY, STATIC_SUBNET, STATIC_DNS);
+  } else if (FAST_CONNECT_REUSE_LEASE && fastConnect.ip != 0) {
+    WiFi.config(IPAddress(fastConnect.ip), IPAddress(fastConnect.gateway),
+                IPAddress(fastConnect.subnet), IPAddress(fastConnect.dns));
+  }
+  WiFi.begin(net.ssid, net.pass, fastConnect.channel, fastConnect.bssid);
+  LOGI("Fast-connecting to WiFi %s (ch %u) ...", net.ssid, fastConnect.channel);
+  return true;
+}
 
-  if (WiFi.status() == WL_CONNECTED) {
-    Serial.println("WiFi connected. IP: " + WiFi.localIP().toString());
-    return true;
+// Full join of networks[index]; the channel from the last scan, if it saw the network, saves
+// the station scanning every channel itself.
+void beginWiFi(uint8_t index) {
+  const SavedNetwork& net = config.networks[index];
+  const ScanEntry* seen = scanListFind(scanCache, net.ssid);
+  stationMode();
+  staDisconnectReason = 0;
+  wifiBeginUs = esp_timer_get_time();
+  if (STATIC_IP != IPAddress(0, 0, 0, 0)) {
+    WiFi.config(STATIC_IP, STATIC_GATEWAY, STATIC_SUBNET, STATIC_DNS);
   } else {
-    Serial.println("WiFi connect failed.");
-    return false;
+    WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE); // back to DHCP
+  }
+  WiFi.begin(net.ssid, net.pass, seen ? seen->channel : 0);
+  if (seen) {
+    LOGI("Connecting to WiFi %s (ch %u, %d dBm) ...", net.ssid, (unsigned)seen->channel, seen->rssi);
+  } else {
+    LOGI("Connecting to WiFi %s ...", net.ssid);
   }
 }
 
+// The station gave up on its own: the network isn't there or turned the password down
+bool wifiAttemptRejected() {
+  return portalCheckFailure(staDisconnectReason) != PORTAL_CHECK_FAILED;
+}
 
-// -------------------- setup & loop --------------------
-void setup() {
-  // Set CPU frequency to 80 MHz
-  setCpuFrequencyMhz(80);
-  
-  Serial.begin(115200);
-  delay(50);
+// Saved networks in the order to try them after a scan (see scanListRank); returns how many
+uint8_t rankSavedNetworks(uint8_t order[CONFIG_MAX_NETWORKS]) {
+  const char* names[CONFIG_MAX_NETWORKS];
+  uint8_t count = configNetworkCount(config);
+  for (uint8_t i = 0; i < count; i++) names[i] = config.networks[i].ssid;
+  uint8_t seen = scanListRank(scanCache, names, count, order);
+  LOGI("%u of %u saved networks in range", (unsigned)seen, (unsigned)count);
+  return count;
+}
 
-  pinMode(BUZZER_PIN, OUTPUT);
-  digitalWrite(BUZZER_PIN, LOW);
-  pinMode(BUZZER_PIN, INPUT); // float when idle
+// A fallback worked: it becomes the one to try first (and the fast-connect cache follows it)
+void adoptNetwork(uint8_t index) {
+  if (index == 0) return;
+  LOGI("Switching to saved network %s.", config.networks[index].ssid);
+  configPromoteNetwork(config, index);
+  fastConnect = config.fastConnect;
+  fastConnectFor = configNetworkKey(config.networks[0]);
+  if (!ENABLE_FAST_CONNECT) writeConfig(); // otherwise saveFastConnectCache() writes it next
+}
 
-  pinMode(RESET_BTN, INPUT_PULLUP);
+// Attempt is over: record the association for next time, or drop hints that didn't work.
+void finishWiFiAttempt(bool fast, bool ok, unsigned long startMs) {
+  if (ok) {
+    uint32_t ip = (uint32_t)WiFi.localIP();
+    LOGI("WiFi connected in %lu ms%s. IP: %u.%u.%u.%u", millis() - startMs, fast ? " (fast)" : "",
+                  (unsigned)(ip & 0xFF), (unsigned)((ip >> 8) & 0xFF), (unsigned)((ip >> 16) & 0xFF), (unsigned)(ip >> 24));
+    if (ENABLE_FAST_CONNECT && !fast) saveFastConnectCache();
+    return;
+  }
+  WiFi.disconnect();
+  if (fast) {
+    LOGW("Fast connect failed (reason %u), scanning.", (unsigned)staDisconnectReason);
+    clearFastConnectCache();
+  } else {
+    LOGE("WiFi connect failed (reason %u).", (unsigned)staDisconnectReason);
+  }
+}
 
-  pinMode(LED_PIN, OUTPUT);
-  digitalWrite(LED_PIN, HIGH);
-  delay(500);
-  digitalWrite(LED_PIN, LOW);
-  delay(500);
-  digitalWrite(LED_PIN, HIGH);
-  delay(500);
-  digitalWrite(LED_PIN, LOW);
+// Waits for GOT_IP, or less if the station is turned away first
+bool waitForWiFi(unsigned long timeoutMs) {
+  unsigned long start = millis();
+  for (;;) {
+    unsigned long spent = millis() - start;
+    if (wifiUp()) return true;
+    if (spent >= timeoutMs || wifiAttemptRejected()) return false;
+    xEventGroupWaitBits(linkEvents, LINK_CHANGED_BIT, pdTRUE, pdFALSE, pdMS_TO_TICKS(timeoutMs - spent));
+  }
+}
 
-  // Load any saved config
-  loadSavedSettings();
+// Blocking join for the duty-cycle wake path, which has nothing else to do meanwhile. Same
+// order as the link supervisor: fast connect, then one scan and the saved networks by signal.
+bool tryConnectWiFi() {
+  unsigned long start = millis();
+  if (beginFastWiFi()) {
+    bool ok = waitForWiFi(FAST_CONNECT_TIMEOUT_MS);
+    finishWiFiAttempt(true, ok, start);
+    if (ok) return true;
+  }
 
-  // If missing saved WiFi or missing Adafruit credentials -> open provisioning portal
-  if (savedSSID == "") {
-    startConfigPortal();
-    // startConfigPortal only returns if server loop is broken, or restarted
+  stationMode();
+  WiFi.scanNetworks(false, false, false, WIFI_SCAN_MS_PER_CHANNEL);
+  readScanResults();
+  uint8_t order[CONFIG_MAX_NETWORKS];
+  uint8_t count = rankSavedNetworks(order);
+  for (uint8_t k = 0; k < count; k++) {
+    unsigned long spent = millis() - start;
+    if (spent >= WIFI_FAILOVER_BUDGET_MS) break;
+    unsigned long attemptStart = millis();
+    beginWiFi(order[k]);
+    unsigned long left = WIFI_FAILOVER_BUDGET_MS - spent;
+    bool ok = waitForWiFi(left < WIFI_CONNECT_TIMEOUT_MS ? left : WIFI_CONNECT_TIMEOUT_MS);
+    if (ok) adoptNetwork(order[k]);
+    finishWiFiAttempt(false, ok, attemptStart);
+    if (ok) return true;
   }
+  return false;
+}
 
-  // Try to connect using saved credentials
-  if (!tryConnectWiFi(savedSSID.c_str(), savedPASS.c_str())) {
-    // Can't connect -> open portal
-    startConfigPortal();
+// ---------- Link supervisor ----------
+// One non-blocking state machine for WiFi and MQTT, stepped by the network task. Each step
+// returns how long the task may sleep before the next one; WiFi events cut that short. The
+// retry spacing itself is Backoff, in lib/BeeperCore/LinkPolicy.h.
+enum LinkState : uint8_t {
+  LINK_WIFI_IDLE,     // waiting out a backoff before the next pass over the saved networks
+  LINK_WIFI_SCANNING, // fast connect didn't work; scanning to rank the saved networks
+  LINK_WIFI_JOINING,  // WiFi.begin() issued, waiting for GOT_IP
+  LINK_MQTT_IDLE,     // WiFi up, waiting out a backoff before the next broker connect
+  LINK_UP,
+};
+
+struct LinkSupervisor {
+  LinkState state;
+  unsigned long deadline;     // millis() when the current wait ends
+  unsigned long attemptStart;
+  unsigned long passStart;    // first attempt of this pass, for WIFI_FAILOVER_BUDGET_MS
+  bool fastAttempt;
+  bool everUp;                // reached the broker at least once since boot
+  int mqttFailures;
+  uint8_t order[CONFIG_MAX_NETWORKS]; // indices into config.networks, best first
+  uint8_t orderCount;
+  uint8_t orderPos;           // next entry of order to try
+  Backoff wifiBackoff;
+  Backoff mqttBackoff;
+};
+
+LinkSupervisor netLink = {
+  LINK_WIFI_IDLE, 0, 0, 0, false, false, 0, {}, 0, 0,
+  { WIFI_BACKOFF_BASE_MS, WIFI_BACKOFF_CAP_MS, 0 },
+  { MQTT_BACKOFF_BASE_MS, MQTT_BACKOFF_CAP_MS, 0 },
+};
+
+void startConfigPortal();
+
+void linkWait(LinkState next, uint32_t delayMs) {
+  netLink.state = next;
+  netLink.deadline = millis() + delayMs;
+}
+
+uint32_t linkRemaining() {
+  long rem = (long)(netLink.deadline - millis());
+  return rem > 0 ? (uint32_t)rem : 0;
+}
+
+// Scan to rank the saved networks; with the scan refused, try them in saved order
+void linkStartScan() {
+  stationMode();
+  if (WiFi.scanNetworks(true, false, false, WIFI_SCAN_MS_PER_CHANNEL) == WIFI_SCAN_RUNNING) {
+    linkWait(LINK_WIFI_SCANNING, WIFI_SCAN_TIMEOUT_MS);
     return;
   }
+  scanCache = {};
+  linkWait(LINK_WIFI_SCANNING, 0);
+}
 
-  // optionally enable WiFi power save mode (modem/light)
-  if (ENABLE_WIFI_POWERSAVE) {
-    // WIFI_PS_MIN_MODEM gives good balance for MQTT
-    esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
-    Serial.println("WiFi power save enabled: WIFI_PS_MIN_MODEM");
-  }
-
-  // set Adafruit IO vars from saved settings
-  // (we already loaded them in loadSavedSettings)
-  // Connect to MQTT
-  if (!connectToMqtt()) {
-    // if fail, try a few times before falling back to portal
-    mqttConnectAttempts++;
-    for (int i = 0; i < MQTT_MAX_CONNECT_ATTEMPTS - 1 && mqttConnectAttempts < MQTT_MAX_CONNECT_ATTEMPTS; ++i) {
-      delay(2000);
-      if (connectToMqtt()) break;
-      mqttConnectAttempts++;
-    }
+// Next saved network of this pass. False once they are all tried or the budget is spent.
+bool linkJoinNext() {
+  unsigned long spent = millis() - netLink.passStart;
+  if (netLink.orderPos >= netLink.orderCount || spent >= WIFI_FAILOVER_BUDGET_MS) return false;
+  netLink.attemptStart = millis();
+  netLink.fastAttempt = false;
+  beginWiFi(netLink.order[netLink.orderPos++]);
+  unsigned long left = WIFI_FAILOVER_BUDGET_MS - spent;
+  linkWait(LINK_WIFI_JOINING, left < WIFI_CONNECT_TIMEOUT_MS ? left : WIFI_CONNECT_TIMEOUT_MS);
+  return true;
+}
+
+uint32_t linkService() {
+  switch (netLink.state) {
+    case LINK_WIFI_IDLE:
+      if (wifiUp()) {
+        linkWait(LINK_MQTT_IDLE, 0);
+        return 0;
+      }
+      if (linkRemaining() > 0) return linkRemaining();
+      netLink.passStart = netLink.attemptStart = millis();
+      netLink.orderCount = netLink.orderPos = 0;
+      netLink.fastAttempt = beginFastWiFi();
+      if (netLink.fastAttempt) {
+        linkWait(LINK_WIFI_JOINING, FAST_CONNECT_TIMEOUT_MS);
+      } else {
+        linkStartScan();
+      }
+      return linkRemaining();
+
+    case LINK_WIFI_SCANNING:
+      if (WiFi.scanComplete() == WIFI_SCAN_RUNNING && linkRemaining() > 0) return linkRemaining();
+      readScanResults();
+      netLink.orderCount = rankSavedNetworks(netLink.order);
+      netLink.orderPos = 0;
+      if (linkJoinNext()) return linkRemaining();
+      linkWait(LINK_WIFI_JOINING, 0); // nothing saved: the pass is over
+      return 0;
+
+    case LINK_WIFI_JOINING:
+      if (wifiUp()) {
+        if (!netLink.fastAttempt) adoptNetwork(netLink.order[netLink.orderPos - 1]);
+        finishWiFiAttempt(netLink.fastAttempt, true, netLink.attemptStart);
+        applyWiFiPowerSave();
+        startMdns();
+        startRelayGateway();
+        backoffReset(netLink.wifiBackoff);
+        linkWait(LINK_MQTT_IDLE, 0);
+        return 0;
+      }
+      if (linkRemaining() > 0 && !wifiAttemptRejected()) return linkRemaining();
+      if (netLink.orderPos > 0 || netLink.fastAttempt) finishWiFiAttempt(netLink.fastAttempt, false, netLink.attemptStart);
+      if (netLink.fastAttempt) {
+        linkStartScan(); // straight on to the other networks
+        return linkRemaining();
+      }
+      if (linkJoinNext()) return linkRemaining();
+      if (!netLink.everUp) {
+        // Never got on any saved network this boot: most likely a bad SSID/password
+        startConfigPortal();
+      }
+      {
+        uint32_t delayMs = backoffNextDelayMs(netLink.wifiBackoff, esp_random());
+        LOGW("No saved network joined, WiFi retry in %lu ms", (unsigned long)delayMs);
+        linkWait(LINK_WIFI_IDLE, delayMs);
+        return delayMs;
+      }
+
+    case LINK_MQTT_IDLE:
+      if (!wifiUp()) {
+        linkWait(LINK_WIFI_IDLE, backoffNextDelayMs(netLink.wifiBackoff, esp_random()));
+        return linkRemaining();
+      }
+      if (linkRemaining() > 0) return linkRemaining();
+      if (connectToMqtt()) {
+        netLink.state = LINK_UP;
+        netLink.mqttFailures = 0;
+        backoffReset(netLink.mqttBackoff);
+        xEventGroupSetBits(linkEvents, LINK_MQTT_UP_BIT);
+        if (!netLink.everUp) {
+          netLink.everUp = true;
+          // signal success
+          playPattern(PAT_PING);
+          uint32_t bootMs = (uint32_t)(esp_timer_get_time() / 1000);
+          telemetry.record(TM_BOOT_TO_READY_MS, bootMs);
+          LOGI("Boot to ready: %lu ms", (unsigned long)bootMs);
+          reportHeap("ready");
+          OtaUpdater::confirmRunningImage();
+        }
+        return 0;
+      }
+      netLink.mqttFailures++;
+      if (!netLink.everUp && netLink.mqttFailures >= MQTT_MAX_CONNECT_ATTEMPTS) {
+        LOGE("Unable to connect to MQTT after attempts. Opening provisioning portal.");
+        clearFastConnectCache(); // a stale lease can look like a working link that goes nowhere
+        startConfigPortal();
+      }
+      {
+        uint32_t delayMs = backoffNextDelayMs(netLink.mqttBackoff, esp_random());
+        LOGW("MQTT retry in %lu ms", (unsigned long)delayMs);
+        linkWait(LINK_MQTT_IDLE, delayMs);
+        return delayMs;
+      }
+
+    case LINK_UP:
+      if (!wifiUp()) {
+        LOGW("WiFi lost.");
+        telemetry.count(TC_WIFI_RECONNECTS);
+        tlsClient.stop();
+        xEventGroupClearBits(linkEvents, LINK_MQTT_UP_BIT);
+        linkWait(LINK_WIFI_IDLE, backoffNextDelayMs(netLink.wifiBackoff, esp_random()));
+        return linkRemaining();
+      }
+      if (!mqtt.connected()) {
+        keepAliveOnDrop(mqtt.state());
+        LOGW("MQTT disconnected, reconnecting...");
+        telemetry.count(TC_MQTT_RECONNECTS);
+        xEventGroupClearBits(linkEvents, LINK_MQTT_UP_BIT);
+        linkWait(LINK_MQTT_IDLE, backoffNextDelayMs(netLink.mqttBackoff, esp_random()));
+        return linkRemaining();
+      }
+      if (keepAliveWantsStepUp()) {
+        mqtt.disconnect(); // the new keepalive only goes out in a CONNECT
+        xEventGroupClearBits(linkEvents, LINK_MQTT_UP_BIT);
+        linkWait(LINK_MQTT_IDLE, 0);
+        return 0;
+      }
+      return 0;
   }
+  return 0;
+}
 
-  if (!mqtt.connected()) {
-    Serial.println("Unable to connect to MQTT after attempts. Opening provisioning portal.");
-    startConfigPortal();
-    return;
+// ---------- Duty-cycled deep sleep ----------
+void enterDutyCycleSleep() {
+  sleepState.magic = SLEEP_STATE_MAGIC;
+  // stretch the interval (up to 8x) while the broker is unreachable instead of burning battery on retries
+  uint32_t sleepSeconds = DEEPSLEEP_WAKE_INTERVAL_SECONDS << (sleepState.failedWakes < 3 ? sleepState.failedWakes : 3);
+  LOGI("Deep sleep for %u s (wake #%u)", sleepSeconds, sleepState.wakeCount);
+
+  waitForPatternIdle();
+  mqtt.disconnect();
+  WiFi.disconnect(true);
+
+  esp_sleep_enable_timer_wakeup((uint64_t)sleepSeconds * 1000000ULL);
+  // reset button still works while asleep (digital pull-ups are off in deep sleep)
+  rtc_gpio_pullup_en((gpio_num_t)RESET_BTN);
+  esp_sleep_enable_ext0_wakeup((gpio_num_t)RESET_BTN, 0);
+  logFlush();
+  esp_deep_sleep_start();
+}
+
+// Timer wake while duty-cycling: no boot animation, no portal. Reconnect, fetch the retained
+// value, and either go back to sleep or (if someone pinged) stay awake for follow-ups.
+void dutyCycleWake() {
+  sleepState.wakeCount++;
+  loadSavedSettings();
+  restoreTlsSession();
+
+  if (configNetworkCount(config) == 0 || !tryConnectWiFi() || !connectToMqtt()) {
+    sleepState.failedWakes++;
+    enterDutyCycleSleep();
   }
+  sleepState.failedWakes = 0;
+  uint32_t wakeMs = (uint32_t)(esp_timer_get_time() / 1000);
+  telemetry.record(TM_BOOT_TO_READY_MS, wakeMs);
+  LOGI("Wake to ready: %lu ms", (unsigned long)wakeMs);
+  applyWiFiPowerSave();
 
-  // signal success
-  beep();
+  uint32_t msgsBefore = mqttMsgCount;
+  uint32_t triggersBefore = triggerCount;
+  if (!MQTT_RELIABLE_DELIVERY) requestRetainedValue(); // otherwise connectToMqtt() already asked
+  unsigned long start = millis();
+  while (mqttMsgCount == msgsBefore && millis() - start < DEEPSLEEP_LISTEN_MS) {
+    mqttLoop();
+    processNetRequests(pdMS_TO_TICKS(10));
+  }
+  // let the app task queue the clear for a retained ping before we decide to sleep
+  processNetRequests(pdMS_TO_TICKS(50));
+
+  if (triggerCount == triggersBefore) {
+    enterDutyCycleSleep();
+  }
+
+  // Someone is actively pinging: leave duty-cycling until we've been idle again
+  LOGI("Ping while duty-cycling, staying awake.");
+  sleepState.magic = 0;
   lastMqttMsgTime = millis();
 }
 
-void loop() {
-  // keep MQTT alive
-  if (!mqtt.connected()) {
-    Serial.println("MQTT disconnected, reconnecting...");
-    if (!connectToMqtt()) {
-      // back-off a bit
-      delay(2000);
+// ---------- Tasks ----------
+// Each maybe*() below returns how long until it next wants to run, for networkTask's wait.
+uint32_t maybeStartDutyCycle() {
+  // Optionally: if you want to deep-sleep after long idle to save power,
+  // you can use FALLBACK_TO_DEEPSLEEP_SECONDS > 0. Deep-sleep disconnects MQTT
+  if (FALLBACK_TO_DEEPSLEEP_SECONDS == 0 || ota.busy()) return UINT32_MAX;
+  unsigned long idleMs = millis() - lastMqttMsgTime;
+  if (idleMs > (FALLBACK_TO_DEEPSLEEP_SECONDS * 1000UL)) {
+    LOGI("Idle for %lu s, starting duty-cycled deep sleep.", idleMs/1000UL);
+    enterDutyCycleSleep();
+  }
+  return FALLBACK_TO_DEEPSLEEP_SECONDS * 1000UL - idleMs + 1;
+}
+
+uint32_t maybePublishTelemetry() {
+  if (TELEMETRY_PUBLISH_INTERVAL_S == 0) return UINT32_MAX;
+  int64_t now = esp_timer_get_time();
+  int64_t leftUs = lastTelemetryPublishUs + (int64_t)TELEMETRY_PUBLISH_INTERVAL_S * 1000000LL - now;
+  if (leftUs > 0) return (uint32_t)(leftUs / 1000) + 1;
+  if (haveDeferredAck) return publishWaitMs(); // acks get the budget first
+
+  if (!publishTake()) return publishWaitMs(); // tried again once a token has grown
+  lastTelemetryPublishUs = now;
+
+  static char summary[TELEMETRY_SUMMARY_MAX];
+  if (telemetry.formatSummary(summary, sizeof(summary)) == 0) {
+    LOGE("Telemetry summary doesn't fit, not published.");
+  } else if (!mqtt.publish(diagTopic, summary)) {
+    LOGE("Failed to publish telemetry.");
+  }
+  reportHeap("telemetry");
+  return TELEMETRY_PUBLISH_INTERVAL_S * 1000UL;
+}
+
+uint32_t maybePublishLog() {
+  if (!LOG_TO_FEED) return UINT32_MAX;
+  static int64_t lastLogPublishUs = 0;
+  int64_t now = esp_timer_get_time();
+  int64_t leftUs = lastLogPublishUs + (int64_t)LOG_FEED_INTERVAL_S * 1000000LL - now;
+  if (lastLogPublishUs != 0 && leftUs > 0) return (uint32_t)(leftUs / 1000) + 1;
+  if (haveDeferredAck || !publishTake()) return publishWaitMs();
+  lastLogPublishUs = now;
+
+  static char lines[TELEMETRY_SUMMARY_MAX];
+  if (logTakeRecent(lines, sizeof(lines)) > 0) mqtt.publish(logTopic, lines);
+  return LOG_FEED_INTERVAL_S * 1000UL;
+}
+
+// A burst of LAN triggers costs one NVS write, made after its acks have gone out
+uint32_t maybeSaveLanReplay() {
+  if (!lanReplayDirty) return UINT32_MAX;
+  ReplayWindow snapshot;
+  portENTER_CRITICAL(&lanReplayMux);
+  int64_t leftUs = lanReplayChangedUs + (int64_t)LAN_REPLAY_SAVE_DELAY_MS * 1000 - esp_timer_get_time();
+  if (leftUs <= 0) {
+    snapshot = lanReplayToSave;
+    lanReplayDirty = false;
+  }
+  portEXIT_CRITICAL(&lanReplayMux);
+  if (leftUs > 0) return (uint32_t)(leftUs / 1000) + 1;
+  saveReplayWindow("lan", snapshot);
+  return UINT32_MAX;
+}
+
+// Sleeps until the broker sends something, another task queues a request, or `timeoutMs`
+// passes. Records mbedTLS has already decrypted don't show on the socket, so those return at once.
+void waitForNetWork(uint32_t timeoutMs) {
+  if (tlsClient.hasBuffered() || uxQueueMessagesWaiting(netQueue) > 0) return;
+  int sock = tlsClient.socketFd();
+  if (netWakeFd < 0 || sock < 0) {
+    vTaskDelay(pdMS_TO_TICKS(timeoutMs < NET_POLL_FALLBACK_MS ? timeoutMs : NET_POLL_FALLBACK_MS));
+    return;
+  }
+  fd_set fds;
+  FD_ZERO(&fds);
+  FD_SET(sock, &fds);
+  FD_SET(netWakeFd, &fds);
+  struct timeval tv;
+  tv.tv_sec = timeoutMs / 1000;
+  tv.tv_usec = (timeoutMs % 1000) * 1000;
+  if (select((sock > netWakeFd ? sock : netWakeFd) + 1, &fds, nullptr, nullptr, &tv) > 0 &&
+      FD_ISSET(netWakeFd, &fds)) {
+    uint64_t count;
+    read(netWakeFd, &count, sizeof(count));
+  }
+}
+
+// Core 0: keeps the link up and owns every publish.
+void networkTask(void*) {
+  // after a duty-cycle wake setup() already brought the link up
+  if (mqtt.connected()) {
+    netLink.state = LINK_UP;
+    netLink.everUp = true;
+    xEventGroupSetBits(linkEvents, LINK_MQTT_UP_BIT);
+  }
+
+  for (;;) {
+    uint32_t waitMs = linkService();
+    uint32_t saveMs = maybeSaveLanReplay();
+    if (netLink.state == LINK_UP) {
+      mqttLoop();
+      processNetRequests(0);
+      // PubSubClient pings after a keepalive of silence; looking four times per interval keeps
+      // the ping well inside the broker's 1.5x grace
+      waitMs = (uint32_t)mqttKeepAliveS * 250;
+      const uint32_t due[] = { haveDeferredAck ? publishWaitMs() : UINT32_MAX, maybePublishTelemetry(),
+                               maybePublishLog(), maybeStartDutyCycle(), saveMs };
+      for (uint32_t d : due) {
+        if (d < waitMs) waitMs = d;
+      }
+      waitForNetWork(waitMs);
+    } else if (waitMs > 0) {
+      if (saveMs < waitMs) waitMs = saveMs;
+      xEventGroupWaitBits(linkEvents, LINK_CHANGED_BIT, pdTRUE, pdFALSE, pdMS_TO_TICKS(waitMs));
     }
-  } else {
-    mqtt.loop();
   }
+}
 
-  // Optionally: if you want to deep-sleep after long idle to save power,
-  // you can use FALLBACK_TO_DEEPSLEEP_SECONDS > 0. Deep-sleep disconnects MQTT
-  if (FALLBACK_TO_DEEPSLEEP_SECONDS > 0) {
-    unsigned long idleMs = millis() - lastMqttMsgTime;
-    if (idleMs > (FALLBACK_TO_DEEPSLEEP_SECONDS * 1000UL)) {
-      Serial.printf("Idle for %lu s. Going to deep sleep for %u s\n", idleMs/1000UL, FALLBACK_TO_DEEPSLEEP_SECONDS);
-      // disable WiFi and deep sleep
-      esp_sleep_enable_timer_wakeup((uint64_t)FALLBACK_TO_DEEPSLEEP_SECONDS * 1000000ULL);
-      delay(100);
-      esp_deep_sleep_start();
+// Core 1: turns events into patterns and feed clears.
+// The first trigger beeps and is acked at once and opens a TRIGGER_COALESCE_MS window. More
+// triggers inside it don't beep and don't move it; they share one more ack when it closes, and
+// the next trigger after that beeps again, so a steady stream still beeps every window.
+void appTask(void*) {
+  AppEvent ev;
+  int64_t burstStartUs = 0;
+  NetRequest burstAck = {};
+  bool burstPending = false;
+
+  for (;;) {
+    TickType_t wait = portMAX_DELAY;
+    if (burstPending) {
+      int64_t leftUs = burstStartUs + (int64_t)TRIGGER_COALESCE_MS * 1000 - esp_timer_get_time();
+      wait = leftUs > 0 ? pdMS_TO_TICKS(leftUs / 1000) : 0;
+    }
+    if (xQueueReceive(appQueue, &ev, wait) != pdTRUE) {
+      if (burstPending) {
+        LOGD("Coalesced %u more triggers into one ack.", (unsigned)burstAck.merged + 1);
+        sendNetRequest(burstAck);
+        burstPending = false;
+      }
+      continue;
+    }
+    switch (ev.type) {
+      case APP_EV_TRIGGER: {
+        int64_t now = esp_timer_get_time();
+        if (burstStartUs != 0 && now - burstStartUs < (int64_t)TRIGGER_COALESCE_MS * 1000) {
+          if (ev.source == TRIGGER_SRC_LAN) {
+            lanTrigger.sendAck(ev.triggerId, 0); // covered by the beep already playing
+            break;
+          }
+          if (ev.source == TRIGGER_SRC_RELAY || ev.source == TRIGGER_SRC_FLEET) break;
+          // inside the window: fold into the pending ack
+          burstAck.merged = burstPending ? burstAck.merged + 1 : 0;
+          if (ev.triggerId != 0) burstAck.triggerId = ev.triggerId;
+          burstPending = true;
+          break;
+        }
+        playPattern(ev.pattern, triggerDuty());
+        uint32_t rxToBeepUs = (uint32_t)(esp_timer_get_time() - ev.rxUs);
+        telemetry.record(TM_RX_TO_BEEP_US, rxToBeepUs);
+        burstStartUs = now;
+        burstPending = false;
+        if (ev.source == TRIGGER_SRC_LAN) {
+          lanTrigger.sendAck(ev.triggerId, rxToBeepUs);
+          burstAck = NetRequest{ NET_REQ_CLEAR_FEED, 0, rxToBeepUs, 0 };
+          break;
+        }
+        if (ev.source == TRIGGER_SRC_RELAY) break; // the gateway acks the feed
+        if (ev.source == TRIGGER_SRC_FLEET) break; // shared by every unit, nobody acks it
+        NetRequest req = { NET_REQ_CLEAR_FEED, ev.triggerId, rxToBeepUs, 0 };
+        sendNetRequest(req);
+        burstAck = req;
+        break;
+      }
+      case APP_EV_RESET_PRESSED:
+        handleResetPrefs();
+        break;
     }
   }
+}
+
+// Core 1: reset button. A low-level GPIO interrupt wakes this task (and the chip, from light
+// sleep); the interrupt stays masked until the button is released again.
+TaskHandle_t inputTaskHandle = nullptr;
+
+void IRAM_ATTR resetButtonIsr(void*) {
+  gpio_intr_disable((gpio_num_t)RESET_BTN);
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(inputTaskHandle, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+void initResetButtonInterrupt() {
+  gpio_install_isr_service(0); // ESP_ERR_INVALID_STATE if already installed is fine
+  gpio_set_intr_type((gpio_num_t)RESET_BTN, GPIO_INTR_LOW_LEVEL);
+  gpio_isr_handler_add((gpio_num_t)RESET_BTN, resetButtonIsr, nullptr);
+  gpio_wakeup_enable((gpio_num_t)RESET_BTN, GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+  gpio_intr_enable((gpio_num_t)RESET_BTN);
+}
+
+void inputTask(void*) {
+  initResetButtonInterrupt();
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    vTaskDelay(pdMS_TO_TICKS(30)); // debounce
+    if (digitalRead(RESET_BTN) == LOW) {
+      AppEvent ev = { APP_EV_RESET_PRESSED, 0, 0, TRIGGER_SRC_MQTT, PAT_RESET };
+      xQueueSend(appQueue, &ev, portMAX_DELAY);
+    }
+    while (digitalRead(RESET_BTN) == LOW) vTaskDelay(pdMS_TO_TICKS(50));
+    gpio_intr_enable((gpio_num_t)RESET_BTN);
+  }
+}
 
-  if (digitalRead(RESET_BTN) == LOW) {
+// The app task is needed as soon as anything can beep (portal, duty-cycle wake).
+void startAppTask() {
+  appQueue = xQueueCreate(APP_QUEUE_LEN, sizeof(AppEvent));
+  netQueue = xQueueCreate(NET_QUEUE_LEN, sizeof(NetRequest));
+  esp_vfs_eventfd_config_t eventfdConfig = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+  if (esp_vfs_eventfd_register(&eventfdConfig) == ESP_OK) netWakeFd = eventfd(0, 0);
+  if (netWakeFd < 0) LOGW("No eventfd, the network task will poll.");
+  xTaskCreatePinnedToCore(appTask, "app", APP_TASK_STACK, nullptr, APP_TASK_PRIORITY, nullptr, APP_TASK_CORE);
+}
+
+void startRuntimeTasks() {
+  xTaskCreatePinnedToCore(networkTask, "net", NETWORK_TASK_STACK, nullptr, NETWORK_TASK_PRIORITY, nullptr, NETWORK_TASK_CORE);
+  xTaskCreatePinnedToCore(inputTask, "input", INPUT_TASK_STACK, nullptr, INPUT_TASK_PRIORITY, &inputTaskHandle, APP_TASK_CORE);
+  startLanTrigger();
+}
+
+// -------------------- setup & loop --------------------
+void setup() {
+  Serial.begin(115200);
+  logBegin(LOG_TASK_PRIORITY, APP_TASK_CORE);
+  initPowerManagement();
+  reportMemoryPlan();
+
+  pinMode(RESET_BTN, INPUT_PULLUP);
+
+  pinMode(LED_PIN, OUTPUT);
+  initPatternEngine();
+  initWiFiEvents();
+  startAppTask();
+
+  esp_sleep_wakeup_cause_t wakeCause = esp_sleep_get_wakeup_cause();
+  if (wakeCause == ESP_SLEEP_WAKEUP_EXT0) {
+    // reset button pressed while duty-cycling
     handleResetPrefs();
   }
+  if (wakeCause == ESP_SLEEP_WAKEUP_TIMER && sleepState.magic == SLEEP_STATE_MAGIC) {
+    dutyCycleWake(); // only returns if it decided to stay awake
+    startRuntimeTasks();
+    return;
+  }
+  sleepState.magic = 0;
+
+  startBootBlink();
+
+  // Load any saved config
+  loadSavedSettings();
+  restoreTlsSession();
+
+  if (BEEPER_NODE_ROLE == BEEPER_ROLE_LEAF) {
+    // a leaf only needs the AIO key and feed key, to authenticate the gateway's frames
+    if (config.adaKey[0] == '\0') startConfigPortal();
+    xTaskCreatePinnedToCore(leafTask, "leaf", APP_TASK_STACK, nullptr, NETWORK_TASK_PRIORITY, nullptr, NETWORK_TASK_CORE);
+    xTaskCreatePinnedToCore(inputTask, "input", INPUT_TASK_STACK, nullptr, INPUT_TASK_PRIORITY, &inputTaskHandle, APP_TASK_CORE);
+    return;
+  }
 
-  delay(10); // allow background tasks to run
+  // If missing saved WiFi or missing Adafruit credentials -> open provisioning portal
+  if (configNetworkCount(config) == 0) {
+    startConfigPortal();
+    // startConfigPortal only returns if server loop is broken, or restarted
+  }
+
+  // The network task's link supervisor joins WiFi and the broker (and falls back to the portal
+  // if the saved credentials never work).
+  lastMqttMsgTime = millis();
+  startRuntimeTasks();
+}
+
+void loop() {
+  // All work happens in networkTask / appTask / inputTask
+  vTaskDelete(nullptr);
 }
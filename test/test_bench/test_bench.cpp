@@ -0,0 +1,166 @@
+// Microbenchmarks for the per-message paths, plus the claim that they never allocate.
+//
+// Timings are printed (ns per call on the build machine) for comparing builds; the asserted
+// ceilings are deliberately loose and only catch a path going accidentally quadratic.
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+
+#include "BeepPatterns.h"
+#include "LinkPolicy.h"
+#include "Payload.h"
+#include "TriggerDedupe.h"
+
+// ---------- Allocation counter ----------
+// Every operator new goes through here; on glibc so does every malloc.
+static volatile bool countAllocs = false;
+static volatile unsigned long allocCount = 0;
+
+#if defined(__GLIBC__)
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void __libc_free(void* p);
+static void* rawMalloc(size_t size) { return __libc_malloc(size); }
+static void rawFree(void* p) { __libc_free(p); }
+#else
+static void* rawMalloc(size_t size) { return malloc(size); }
+static void rawFree(void* p) { free(p); }
+#endif
+
+static void* countedAlloc(size_t size) {
+  if (countAllocs) allocCount = allocCount + 1;
+  return rawMalloc(size);
+}
+
+#if defined(__GLIBC__)
+extern "C" void* malloc(size_t size) { return countedAlloc(size); }
+#endif
+
+void* operator new(size_t size) {
+  void* p = countedAlloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { rawFree(p); }
+void operator delete[](void* p) noexcept { rawFree(p); }
+void operator delete(void* p, size_t) noexcept { rawFree(p); }
+void operator delete[](void* p, size_t) noexcept { rawFree(p); }
+
+// ---------- Harness ----------
+static const unsigned long BENCH_ITERATIONS = 200000;
+static const double BENCH_CEILING_NS = 10000.0;
+static volatile uint32_t sink;
+
+template <typename F>
+static double nsPerCall(const char* name, F body) {
+  for (unsigned long i = 0; i < 1000; i++) body(i); // warm up
+  allocCount = 0;
+  countAllocs = true;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < BENCH_ITERATIONS; i++) body(i);
+  auto end = std::chrono::steady_clock::now();
+  countAllocs = false;
+  double ns = std::chrono::duration<double, std::nano>(end - start).count() / BENCH_ITERATIONS;
+  printf("bench %-28s %8.1f ns/call\n", name, ns);
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, (uint32_t)allocCount, name);
+  return ns;
+}
+
+void setUp() {}
+void tearDown() {}
+
+// A full-size message with the trigger word at the very end: the worst case for the scan
+static uint8_t longTail[256];
+static const char* PLAIN = "true";
+static const char* BENCH = "true id=1234567 melody=doorbell to=aa:bb:cc:dd:ee:ff";
+
+static void test_counter_sees_allocations() {
+  countAllocs = true;
+  allocCount = 0;
+  int* p = new int(1);
+  countAllocs = false;
+  delete p;
+  TEST_ASSERT_EQUAL_UINT32(1, (uint32_t)allocCount);
+}
+
+static void test_bench_payload_is_trigger() {
+  memset(longTail, 'x', sizeof(longTail));
+  memcpy(longTail + sizeof(longTail) - 4, "TRUE", 4);
+  const size_t plainLen = strlen(PLAIN);
+  TEST_ASSERT_LESS_THAN_DOUBLE(BENCH_CEILING_NS, nsPerCall("payloadIsTrigger plain", [&](unsigned long) {
+    sink = sink + payloadIsTrigger((const uint8_t*)PLAIN, plainLen);
+  }));
+  TEST_ASSERT_LESS_THAN_DOUBLE(BENCH_CEILING_NS, nsPerCall("payloadIsTrigger 256 B", [&](unsigned long) {
+    sink = sink + payloadIsTrigger(longTail, sizeof(longTail));
+  }));
+}
+
+static void test_bench_payload_fields() {
+  const size_t len = strlen(BENCH);
+  const uint8_t* p = (const uint8_t*)BENCH;
+  TEST_ASSERT_LESS_THAN_DOUBLE(BENCH_CEILING_NS, nsPerCall("payloadTriggerId", [&](unsigned long) {
+    sink = sink + payloadTriggerId(p, len);
+  }));
+  TEST_ASSERT_LESS_THAN_DOUBLE(BENCH_CEILING_NS, nsPerCall("payloadMelody", [&](unsigned long) {
+    sink = sink + payloadMelody(p, len, PAT_PING);
+  }));
+  TEST_ASSERT_LESS_THAN_DOUBLE(BENCH_CEILING_NS, nsPerCall("payloadTarget", [&](unsigned long) {
+    uint8_t mac[6];
+    sink = sink + payloadTarget(p, len, mac) + mac[5];
+  }));
+  // everything the callback does with one trigger message
+  TEST_ASSERT_LESS_THAN_DOUBLE(BENCH_CEILING_NS, nsPerCall("whole trigger message", [&](unsigned long) {
+    uint8_t mac[6];
+    if (payloadIsTrigger(p, len)) {
+      sink = sink + payloadTriggerId(p, len) + payloadMelody(p, len, PAT_PING) + payloadTarget(p, len, mac);
+    }
+  }));
+}
+
+static void test_bench_pattern_cursor() {
+  TEST_ASSERT_LESS_THAN_DOUBLE(BENCH_CEILING_NS, nsPerCall("pattern cursor, whole fanfare", [&](unsigned long) {
+    PatternCursor c;
+    PatternEdge e = patternCursorBegin(c, &PATTERNS[PAT_FANFARE]);
+    uint32_t ms = e.ms;
+    while (patternCursorAdvance(c, e)) ms += e.ms;
+    sink = sink + ms;
+  }));
+}
+
+static void test_bench_backoff() {
+  Backoff b = { 1000, 300000, 0 };
+  TEST_ASSERT_LESS_THAN_DOUBLE(BENCH_CEILING_NS, nsPerCall("backoffNextDelayMs", [&](unsigned long i) {
+    if ((i & 15) == 0) backoffReset(b);
+    sink = sink + backoffNextDelayMs(b, (uint32_t)i * 2654435761u);
+  }));
+}
+
+// a new trigger against a full ring: every entry is compared, then the oldest is replaced
+static void test_bench_dedupe() {
+  TriggerDedupe full = {};
+  char other[] = "true id=0";
+  for (uint8_t i = 0; i < TriggerDedupe::SIZE; i++) {
+    other[8] = (char)('1' + i);
+    triggerDedupeSeen(full, (const uint8_t*)other, sizeof(other) - 1, i, 10000);
+  }
+  const size_t len = strlen(BENCH);
+  const uint8_t* p = (const uint8_t*)BENCH;
+  TEST_ASSERT_LESS_THAN_DOUBLE(BENCH_CEILING_NS, nsPerCall("triggerDedupeSeen", [&](unsigned long i) {
+    TriggerDedupe d = full;
+    sink = sink + triggerDedupeSeen(d, p, (unsigned int)len, (uint32_t)i, 10000) + d.next;
+  }));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_counter_sees_allocations);
+  RUN_TEST(test_bench_payload_is_trigger);
+  RUN_TEST(test_bench_payload_fields);
+  RUN_TEST(test_bench_pattern_cursor);
+  RUN_TEST(test_bench_backoff);
+  RUN_TEST(test_bench_dedupe);
+  return UNITY_END();
+}
@@ -0,0 +1,201 @@
+// The NVS config blob: encode, decode, and everything a torn or stale record can look like.
+#include <stddef.h>
+#include <string.h>
+#include <unity.h>
+
+#include "DeviceConfig.h"
+
+void setUp() {}
+void tearDown() {}
+
+static DeviceConfig sample() {
+  DeviceConfig c = {};
+  configRememberNetwork(c, "office", "hunter2hunter2");
+  configRememberNetwork(c, "home-2.4", "correct horse battery staple");
+  copyField(c.adaUser, sizeof(c.adaUser), "someone");
+  copyField(c.adaKey, sizeof(c.adaKey), "aio_0123456789abcdef");
+  copyField(c.feedKey, sizeof(c.feedKey), "beeper");
+  c.fastConnect.magic = FAST_CONNECT_MAGIC;
+  c.fastConnect.channel = 6;
+  c.fastConnect.ip = 0x0A00000Au;
+  configEncode(c);
+  return c;
+}
+
+static void test_crc_is_standard_crc32() {
+  // the ROM's crc32_le(0, ...) on the device; blobs written there must check here and back
+  const char* check = "123456789";
+  TEST_ASSERT_EQUAL_HEX32(0xCBF43926u, crc32Update(0, (const uint8_t*)check, strlen(check)));
+  uint32_t split = crc32Update(crc32Update(0, (const uint8_t*)check, 4), (const uint8_t*)check + 4, 5);
+  TEST_ASSERT_EQUAL_HEX32(0xCBF43926u, split);
+}
+
+static void test_round_trip() {
+  DeviceConfig c = sample();
+  uint8_t blob[sizeof(DeviceConfig)];
+  memcpy(blob, &c, sizeof(c));
+
+  DeviceConfig out = {};
+  TEST_ASSERT_TRUE(configDecode(blob, sizeof(blob), out));
+  TEST_ASSERT_EQUAL_MEMORY(&c, &out, sizeof(c));
+  TEST_ASSERT_EQUAL_STRING("correct horse battery staple", out.networks[0].pass);
+  TEST_ASSERT_EQUAL_STRING("office", out.networks[1].ssid);
+  TEST_ASSERT_EQUAL_UINT8(6, out.fastConnect.channel);
+}
+
+static void test_rejects_short_or_long_reads() {
+  DeviceConfig c = sample();
+  DeviceConfig out = {};
+  TEST_ASSERT_FALSE(configDecode(&c, 0, out));
+  TEST_ASSERT_FALSE(configDecode(&c, sizeof(c) - 1, out));
+  uint8_t bigger[sizeof(DeviceConfig) + 4] = {};
+  memcpy(bigger, &c, sizeof(c));
+  TEST_ASSERT_FALSE(configDecode(bigger, sizeof(bigger), out));
+}
+
+static void test_every_flipped_byte_is_caught() {
+  DeviceConfig c = sample();
+  uint8_t blob[sizeof(DeviceConfig)];
+  for (size_t i = 0; i < sizeof(blob); i++) {
+    memcpy(blob, &c, sizeof(c));
+    blob[i] ^= 0x01;
+    DeviceConfig out = {};
+    TEST_ASSERT_FALSE(configDecode(blob, sizeof(blob), out));
+  }
+}
+
+static void test_other_version_is_left_alone() {
+  DeviceConfig c = sample();
+  c.version = CONFIG_VERSION + 1;
+  c.crc = configCrc(c);  // intact, just not a layout this firmware knows
+  DeviceConfig out = {};
+  copyField(out.adaUser, sizeof(out.adaUser), "untouched");
+  TEST_ASSERT_FALSE(configDecode(&c, sizeof(c), out));
+  TEST_ASSERT_EQUAL_STRING("untouched", out.adaUser);
+}
+
+static DeviceConfigV1 sampleV1() {
+  DeviceConfigV1 v1 = {};
+  v1.magic = CONFIG_MAGIC;
+  v1.version = 1;
+  v1.size = sizeof(v1);
+  copyField(v1.ssid, sizeof(v1.ssid), "old-net");
+  copyField(v1.pass, sizeof(v1.pass), "old-pass");
+  copyField(v1.adaUser, sizeof(v1.adaUser), "someone");
+  copyField(v1.adaKey, sizeof(v1.adaKey), "aio_key");
+  copyField(v1.feedKey, sizeof(v1.feedKey), "beeper");
+  v1.fastConnect.magic = FAST_CONNECT_MAGIC;
+  v1.fastConnect.channel = 11;
+  v1.crc = crc32Update(0, (const uint8_t*)&v1, offsetof(DeviceConfigV1, crc));
+  return v1;
+}
+
+static void test_version_1_is_converted() {
+  DeviceConfigV1 v1 = sampleV1();
+  DeviceConfig out = {};
+  TEST_ASSERT_TRUE(configDecode(&v1, sizeof(v1), out));
+  TEST_ASSERT_EQUAL_UINT16(1, out.version); // tells the caller to store the new layout
+  TEST_ASSERT_EQUAL_UINT8(1, configNetworkCount(out));
+  TEST_ASSERT_EQUAL_STRING("old-net", out.networks[0].ssid);
+  TEST_ASSERT_EQUAL_STRING("old-pass", out.networks[0].pass);
+  TEST_ASSERT_EQUAL_STRING("aio_key", out.adaKey);
+  TEST_ASSERT_EQUAL_UINT8(11, out.fastConnect.channel);
+
+  // and once stored again, it reads back as the current version
+  configEncode(out);
+  DeviceConfig again = {};
+  TEST_ASSERT_TRUE(configDecode(&out, sizeof(out), again));
+  TEST_ASSERT_EQUAL_UINT16(CONFIG_VERSION, again.version);
+  TEST_ASSERT_EQUAL_STRING("old-net", again.networks[0].ssid);
+
+  v1.pass[0] ^= 1; // torn v1 record
+  DeviceConfig untouched = {};
+  TEST_ASSERT_FALSE(configDecode(&v1, sizeof(v1), untouched));
+  TEST_ASSERT_EQUAL_UINT8(0, configNetworkCount(untouched));
+}
+
+static void test_remember_keeps_most_recent_first() {
+  DeviceConfig c = {};
+  configRememberNetwork(c, "a", "1");
+  configRememberNetwork(c, "b", "2");
+  configRememberNetwork(c, "c", "3");
+  TEST_ASSERT_EQUAL_UINT8(3, configNetworkCount(c));
+  TEST_ASSERT_EQUAL_STRING("c", c.networks[0].ssid);
+  TEST_ASSERT_EQUAL_STRING("a", c.networks[2].ssid);
+
+  // a known name moves to the front with its new password; nothing is duplicated
+  configRememberNetwork(c, "a", "new");
+  TEST_ASSERT_EQUAL_UINT8(3, configNetworkCount(c));
+  TEST_ASSERT_EQUAL_STRING("a", c.networks[0].ssid);
+  TEST_ASSERT_EQUAL_STRING("new", c.networks[0].pass);
+  TEST_ASSERT_EQUAL_STRING("c", c.networks[1].ssid);
+  TEST_ASSERT_EQUAL_STRING("b", c.networks[2].ssid);
+
+  // a full list forgets the one that worked longest ago
+  configRememberNetwork(c, "d", "4");
+  configRememberNetwork(c, "e", "5");
+  TEST_ASSERT_EQUAL_UINT8(CONFIG_MAX_NETWORKS, configNetworkCount(c));
+  TEST_ASSERT_EQUAL_STRING("e", c.networks[0].ssid);
+  TEST_ASSERT_EQUAL_STRING("c", c.networks[3].ssid);
+
+  configRememberNetwork(c, "", "ignored");
+  TEST_ASSERT_EQUAL_STRING("e", c.networks[0].ssid);
+}
+
+static void test_fast_connect_follows_the_first_network() {
+  DeviceConfig c = {};
+  configRememberNetwork(c, "a", "1");
+  configRememberNetwork(c, "b", "2");
+  c.fastConnect.magic = FAST_CONNECT_MAGIC;
+  configRememberNetwork(c, "b", "2"); // already first: the cache still fits
+  TEST_ASSERT_EQUAL_HEX32(FAST_CONNECT_MAGIC, c.fastConnect.magic);
+
+  configPromoteNetwork(c, 1);
+  TEST_ASSERT_EQUAL_STRING("a", c.networks[0].ssid);
+  TEST_ASSERT_EQUAL_STRING("b", c.networks[1].ssid);
+  TEST_ASSERT_EQUAL_HEX32(0, c.fastConnect.magic);
+
+  c.fastConnect.magic = FAST_CONNECT_MAGIC;
+  configPromoteNetwork(c, 0);
+  configPromoteNetwork(c, CONFIG_MAX_NETWORKS);
+  TEST_ASSERT_EQUAL_HEX32(FAST_CONNECT_MAGIC, c.fastConnect.magic);
+  TEST_ASSERT_EQUAL_STRING("a", c.networks[0].ssid);
+}
+
+static void test_copy_field_truncates_and_terminates() {
+  char ssid[33];
+  memset(ssid, 'x', sizeof(ssid));
+  copyField(ssid, sizeof(ssid), "a-network-name-that-is-longer-than-thirty-two-bytes");
+  TEST_ASSERT_EQUAL_UINT(32, strlen(ssid));
+  TEST_ASSERT_EQUAL('\0', ssid[32]);
+  copyField(ssid, sizeof(ssid), "");
+  TEST_ASSERT_EQUAL_STRING("", ssid);
+}
+
+static void test_network_key_tells_networks_apart() {
+  SavedNetwork a = {}, b = {}, c = {};
+  copyField(a.ssid, sizeof(a.ssid), "ab");
+  copyField(a.pass, sizeof(a.pass), "c");
+  copyField(b.ssid, sizeof(b.ssid), "a");
+  copyField(b.pass, sizeof(b.pass), "bc");
+  c = a;
+  TEST_ASSERT_EQUAL_HEX32(configNetworkKey(a), configNetworkKey(c));
+  TEST_ASSERT_NOT_EQUAL(configNetworkKey(a), configNetworkKey(b));
+  copyField(c.pass, sizeof(c.pass), "d");
+  TEST_ASSERT_NOT_EQUAL(configNetworkKey(a), configNetworkKey(c));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_crc_is_standard_crc32);
+  RUN_TEST(test_round_trip);
+  RUN_TEST(test_rejects_short_or_long_reads);
+  RUN_TEST(test_every_flipped_byte_is_caught);
+  RUN_TEST(test_other_version_is_left_alone);
+  RUN_TEST(test_version_1_is_converted);
+  RUN_TEST(test_remember_keeps_most_recent_first);
+  RUN_TEST(test_fast_connect_follows_the_first_network);
+  RUN_TEST(test_network_key_tells_networks_apart);
+  RUN_TEST(test_copy_field_truncates_and_terminates);
+  return UNITY_END();
+}
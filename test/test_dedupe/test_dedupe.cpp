@@ -0,0 +1,80 @@
+// Replayed triggers (QoS 1 redelivery, the "/get" catch-up) play once; new ones always play.
+#include <string.h>
+#include <unity.h>
+
+#include "TriggerDedupe.h"
+
+void setUp() {}
+void tearDown() {}
+
+static const uint32_t WINDOW = 10000;
+
+static bool seen(TriggerDedupe& d, const char* payload, uint32_t nowMs) {
+  return triggerDedupeSeen(d, (const uint8_t*)payload, (unsigned int)strlen(payload), nowMs, WINDOW);
+}
+
+static void test_numbered_repeats_are_dropped_for_good() {
+  TriggerDedupe d = {};
+  TEST_ASSERT_FALSE(seen(d, "true id=41", 1000));
+  TEST_ASSERT_FALSE(seen(d, "true id=42", 1200));
+  TEST_ASSERT_TRUE(seen(d, "true id=41", 1300));
+  TEST_ASSERT_TRUE(seen(d, "true id=42 ", 600000)); // long after, whitespace aside
+  TEST_ASSERT_FALSE(seen(d, "true id=43", 600100));
+}
+
+static void test_plain_repeats_only_inside_the_window() {
+  TriggerDedupe d = {};
+  TEST_ASSERT_FALSE(seen(d, "true", 1000));
+  TEST_ASSERT_TRUE(seen(d, "true", 1000 + WINDOW - 1));
+  TEST_ASSERT_FALSE(seen(d, "true", 1000 + WINDOW));
+  // a duplicate doesn't extend the window it landed in
+  TEST_ASSERT_TRUE(seen(d, "true", 1000 + WINDOW + 5000));
+  TEST_ASSERT_FALSE(seen(d, "true", 1000 + 2 * WINDOW + 1));
+}
+
+static void test_plain_and_numbered_do_not_mix() {
+  TriggerDedupe d = {};
+  TEST_ASSERT_FALSE(seen(d, "true", 1000));
+  TEST_ASSERT_FALSE(seen(d, "true id=1", 1001));
+  TEST_ASSERT_FALSE(seen(d, "true melody=chime", 1002));
+  TEST_ASSERT_TRUE(seen(d, "true", 1003));
+}
+
+static void test_ring_forgets_the_oldest() {
+  TriggerDedupe d = {};
+  char payload[24];
+  for (int i = 1; i <= TriggerDedupe::SIZE + 1; i++) {
+    strcpy(payload, "true id=");
+    payload[8] = (char)('0' + i / 10);
+    payload[9] = (char)('0' + i % 10);
+    payload[10] = '\0';
+    TEST_ASSERT_FALSE(seen(d, payload, (uint32_t)i));
+  }
+  TEST_ASSERT_EQUAL_UINT8(TriggerDedupe::SIZE, d.count);
+  TEST_ASSERT_FALSE(seen(d, "true id=01", 100)); // pushed out by the ninth
+  TEST_ASSERT_TRUE(seen(d, "true id=09", 101));
+}
+
+static void test_window_survives_millis_wrap() {
+  TriggerDedupe d = {};
+  TEST_ASSERT_FALSE(seen(d, "true", 0xFFFFFF00u));
+  TEST_ASSERT_TRUE(seen(d, "true", 0x00000100u));
+}
+
+static void test_reset_forgets_everything() {
+  TriggerDedupe d = {};
+  seen(d, "true id=7", 1);
+  triggerDedupeReset(d);
+  TEST_ASSERT_FALSE(seen(d, "true id=7", 2));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_numbered_repeats_are_dropped_for_good);
+  RUN_TEST(test_plain_repeats_only_inside_the_window);
+  RUN_TEST(test_plain_and_numbered_do_not_mix);
+  RUN_TEST(test_ring_forgets_the_oldest);
+  RUN_TEST(test_window_survives_millis_wrap);
+  RUN_TEST(test_reset_forgets_everything);
+  return UNITY_END();
+}
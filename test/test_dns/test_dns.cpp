@@ -0,0 +1,99 @@
+// Captive-portal DNS replies, checked byte for byte against hand-built queries.
+#include <string.h>
+#include <unity.h>
+
+#include "DnsAnswer.h"
+
+void setUp() {}
+void tearDown() {}
+
+static const uint8_t PORTAL_IP[4] = { 192, 168, 4, 1 };
+
+// Query for connectivitycheck.gstatic.com with the given type, RD set, plus an EDNS OPT record
+static size_t buildQuery(uint8_t* q, uint16_t qtype) {
+  static const uint8_t header[] = { 0xBE, 0xEF, 0x01, 0x00, 0, 1, 0, 0, 0, 0, 0, 1 };
+  static const uint8_t name[] = { 17, 'c', 'o', 'n', 'n', 'e', 'c', 't', 'i', 'v', 'i', 't', 'y', 'c', 'h', 'e', 'c', 'k',
+                                  7, 'g', 's', 't', 'a', 't', 'i', 'c', 3, 'c', 'o', 'm', 0 };
+  static const uint8_t opt[] = { 0, 0, 41, 0x10, 0, 0, 0, 0, 0, 0, 0 };
+  size_t n = 0;
+  memcpy(q + n, header, sizeof(header));
+  n += sizeof(header);
+  memcpy(q + n, name, sizeof(name));
+  n += sizeof(name);
+  q[n++] = (uint8_t)(qtype >> 8);
+  q[n++] = (uint8_t)qtype;
+  q[n++] = 0;
+  q[n++] = 1;  // IN
+  memcpy(q + n, opt, sizeof(opt));
+  return n + sizeof(opt);
+}
+
+static void test_a_query_gets_portal_address() {
+  uint8_t q[128], r[128];
+  size_t qLen = buildQuery(q, 1);
+  size_t questionEnd = qLen - 11;
+  size_t n = dnsAnswerA(q, qLen, PORTAL_IP, r, sizeof(r));
+  TEST_ASSERT_EQUAL_UINT(questionEnd + 16, n);
+
+  TEST_ASSERT_EQUAL_HEX32(0xBEEF, (r[0] << 8) | r[1]);  // same id
+  TEST_ASSERT_EQUAL_HEX32(0x8580, (r[2] << 8) | r[3]);  // QR AA RD RA, NOERROR
+  TEST_ASSERT_EQUAL(1, (r[4] << 8) | r[5]);             // QDCOUNT
+  TEST_ASSERT_EQUAL(1, (r[6] << 8) | r[7]);             // ANCOUNT
+  TEST_ASSERT_EQUAL(0, (r[8] << 8) | r[9]);
+  TEST_ASSERT_EQUAL(0, (r[10] << 8) | r[11]);           // EDNS record dropped
+  TEST_ASSERT_EQUAL_MEMORY(q + 12, r + 12, questionEnd - 12);
+
+  const uint8_t answer[] = { 0xC0, 0x0C, 0, 1, 0, 1, 0, 0, 0, (uint8_t)DNS_ANSWER_TTL_S, 0, 4, 192, 168, 4, 1 };
+  TEST_ASSERT_EQUAL_MEMORY(answer, r + questionEnd, sizeof(answer));
+}
+
+static void test_other_types_get_empty_answer() {
+  uint8_t q[128], r[128];
+  size_t qLen = buildQuery(q, 28);  // AAAA
+  size_t n = dnsAnswerA(q, qLen, PORTAL_IP, r, sizeof(r));
+  TEST_ASSERT_EQUAL_UINT(qLen - 11, n);
+  TEST_ASSERT_EQUAL(0, (r[6] << 8) | r[7]);
+  TEST_ASSERT_EQUAL(0, r[3] & 0x0F);  // NOERROR, not NXDOMAIN
+}
+
+static void test_ignores_what_it_should_not_answer() {
+  uint8_t q[128], r[128];
+  size_t qLen = buildQuery(q, 1);
+
+  q[2] |= 0x80;  // a response
+  TEST_ASSERT_EQUAL_UINT(0, dnsAnswerA(q, qLen, PORTAL_IP, r, sizeof(r)));
+  q[2] = 0x01 | (2 << 3);  // opcode STATUS
+  TEST_ASSERT_EQUAL_UINT(0, dnsAnswerA(q, qLen, PORTAL_IP, r, sizeof(r)));
+  q[2] = 0x01;
+  q[5] = 2;  // two questions
+  TEST_ASSERT_EQUAL_UINT(0, dnsAnswerA(q, qLen, PORTAL_IP, r, sizeof(r)));
+  q[5] = 1;
+  TEST_ASSERT_EQUAL_UINT(0, dnsAnswerA(q, 11, PORTAL_IP, r, sizeof(r)));
+  TEST_ASSERT_EQUAL_UINT(0, dnsAnswerA(q, 30, PORTAL_IP, r, sizeof(r)));  // cut inside the name
+  TEST_ASSERT_EQUAL_UINT(0, dnsAnswerA(q, qLen, PORTAL_IP, r, 20));       // no room for the reply
+}
+
+static void test_rejects_compression_pointers() {
+  uint8_t q[128], r[128];
+  size_t qLen = buildQuery(q, 1);
+  q[12] = 0xC0;  // pointer where a label length should be
+  TEST_ASSERT_EQUAL_UINT(0, dnsAnswerA(q, qLen, PORTAL_IP, r, sizeof(r)));
+}
+
+static void test_every_truncation_is_safe() {
+  uint8_t q[128], r[128];
+  size_t qLen = buildQuery(q, 1);
+  for (size_t len = 0; len < qLen - 11; len++) {
+    TEST_ASSERT_EQUAL_UINT(0, dnsAnswerA(q, len, PORTAL_IP, r, sizeof(r)));
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_a_query_gets_portal_address);
+  RUN_TEST(test_other_types_get_empty_answer);
+  RUN_TEST(test_ignores_what_it_should_not_answer);
+  RUN_TEST(test_rejects_compression_pointers);
+  RUN_TEST(test_every_truncation_is_safe);
+  return UNITY_END();
+}
@@ -0,0 +1,76 @@
+// LAN trigger datagrams: fields found in place, and anything cut short or mangled refused.
+#include <string.h>
+#include <unity.h>
+
+#include "LanDatagram.h"
+
+void setUp() {}
+void tearDown() {}
+
+static const char GOOD[] = "true seq=1700000000123 id=42 src=laptop mac=00112233445566778899aabbccddeeff";
+
+static bool parse(const char* msg, LanDatagram& d) {
+  return lanDatagramParse(msg, strlen(msg), d);
+}
+
+static void test_fields() {
+  LanDatagram d;
+  TEST_ASSERT_TRUE(parse(GOOD, d));
+  TEST_ASSERT_EQUAL_UINT64(1700000000123ULL, d.seq);
+  TEST_ASSERT_EQUAL_UINT32(42, d.triggerId);
+  TEST_ASSERT_EQUAL_UINT(6, d.srcLen);
+  TEST_ASSERT_EQUAL_INT(0, memcmp(d.src, "laptop", 6));
+  TEST_ASSERT_EQUAL_UINT(strlen("true seq=1700000000123 id=42 src=laptop"), d.signedLen);
+  TEST_ASSERT_EQUAL_HEX8(0x00, d.mac[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x77, d.mac[7]);
+  TEST_ASSERT_EQUAL_HEX8(0xff, d.mac[15]);
+}
+
+static void test_optional_fields() {
+  LanDatagram d;
+  TEST_ASSERT_TRUE(parse("true seq=7 mac=00112233445566778899AABBCCDDEEFF", d));
+  TEST_ASSERT_EQUAL_UINT64(7, d.seq);
+  TEST_ASSERT_EQUAL_UINT32(0, d.triggerId);
+  TEST_ASSERT_EQUAL_UINT(0, d.srcLen);
+  TEST_ASSERT_EQUAL_HEX8(0xaa, d.mac[10]);
+}
+
+static void test_every_truncation_is_refused() {
+  LanDatagram d;
+  for (size_t len = 0; len < sizeof(GOOD) - 1; len++) {
+    TEST_ASSERT_FALSE_MESSAGE(lanDatagramParse(GOOD, len, d), "accepted a truncated datagram");
+  }
+}
+
+static void test_unterminated_buffer() {
+  // the receive buffer has no NUL; nothing past len may be read as part of it
+  char buf[sizeof(GOOD) + 8];
+  memcpy(buf, GOOD, sizeof(GOOD) - 1);
+  memset(buf + sizeof(GOOD) - 1, '7', 9);
+  LanDatagram d;
+  TEST_ASSERT_TRUE(lanDatagramParse(buf, sizeof(GOOD) - 1, d));
+  TEST_ASSERT_EQUAL_UINT8(0xff, d.mac[15]);
+}
+
+static void test_malformed() {
+  LanDatagram d;
+  TEST_ASSERT_FALSE(parse("false seq=7 mac=00112233445566778899aabbccddeeff", d));
+  TEST_ASSERT_FALSE(parse("true id=7 mac=00112233445566778899aabbccddeeff", d));         // no seq
+  TEST_ASSERT_FALSE(parse("true seq= mac=00112233445566778899aabbccddeeff", d));
+  TEST_ASSERT_FALSE(parse("true seq=7x mac=00112233445566778899aabbccddeeff", d));
+  TEST_ASSERT_FALSE(parse("true seq=99999999999999999999 mac=00112233445566778899aabbccddeeff", d));
+  TEST_ASSERT_FALSE(parse("true seq=7 id=4z mac=00112233445566778899aabbccddeeff", d));
+  TEST_ASSERT_FALSE(parse("true seq=7 mac=0011223344556677889gaabbccddeeff", d));         // not hex
+  TEST_ASSERT_FALSE(parse("true seq=7 mac=00112233445566778899aabbccddeeff00", d));       // mac too long
+  TEST_ASSERT_FALSE(parse("true seq=7 mac=00112233445566778899aabbccddeeff id=1", d));    // mac not last
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_fields);
+  RUN_TEST(test_optional_fields);
+  RUN_TEST(test_every_truncation_is_refused);
+  RUN_TEST(test_unterminated_buffer);
+  RUN_TEST(test_malformed);
+  return UNITY_END();
+}
@@ -0,0 +1,114 @@
+// Reconnect backoff and the adaptive keepalive search, driven through whole link histories.
+#include <unity.h>
+
+#include "LinkPolicy.h"
+
+void setUp() {}
+void tearDown() {}
+
+// Same numbers as main.cpp's config section
+static const KeepAliveLimits LIMITS = { 15, 1200, 30 };
+
+static void test_backoff_doubles_then_caps() {
+  Backoff b = { 1000, 300000, 0 };
+  uint32_t expectWindow = 1000;
+  for (int i = 0; i < 40; i++) {
+    // random = 0 gives the fixed half, random = ~0 lands within the window
+    Backoff lo = b;
+    Backoff hi = b;
+    uint32_t min = backoffNextDelayMs(lo, 0);
+    uint32_t max = backoffNextDelayMs(hi, 0xFFFFFFFFu);
+    uint32_t mid = backoffNextDelayMs(b, 0x9E3779B9u);
+    TEST_ASSERT_EQUAL_UINT32(expectWindow / 2, min);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(expectWindow, max);
+    TEST_ASSERT_TRUE(mid >= min && mid <= expectWindow);
+    expectWindow = expectWindow * 2 > 300000 ? 300000 : expectWindow * 2;
+  }
+}
+
+static void test_backoff_attempt_saturates_and_resets() {
+  Backoff b = { 2000, 600000, 0 };
+  for (int i = 0; i < 1000; i++) backoffNextDelayMs(b, (uint32_t)i * 2654435761u);
+  TEST_ASSERT_EQUAL_UINT8(255, b.attempt);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(600000, backoffNextDelayMs(b, 0xFFFFFFFFu));
+  backoffReset(b);
+  TEST_ASSERT_EQUAL_UINT32(1000, backoffNextDelayMs(b, 0));
+}
+
+static void test_backoff_huge_base_does_not_overflow() {
+  Backoff b = { 0xFFFFFFFFu, 0xFFFFFFFFu, 19 };
+  TEST_ASSERT_EQUAL_UINT32(0x7FFFFFFFu, backoffNextDelayMs(b, 0));
+}
+
+static KeepAliveProbe fresh() {
+  return KeepAliveProbe{ 1, 15, 0, 60, false };
+}
+
+// Runs the probe against a NAT that drops idle mappings after natS: every value below it
+// holds, every value at or above it times out. Returns the settled keepalive.
+static uint16_t settleAgainst(KeepAliveProbe& p, uint16_t natS, int& reconnects) {
+  reconnects = 0;
+  while (!p.settled && reconnects < 64) {
+    if (p.tryingS < natS) {
+      if (keepAliveProbeHeld(p, LIMITS)) reconnects++;
+    } else {
+      keepAliveProbeTimedOut(p, LIMITS);
+      reconnects++;
+    }
+  }
+  return p.goodS;
+}
+
+static void test_probe_converges_below_nat_timeout() {
+  const uint16_t nats[] = { 31, 100, 300, 301, 599, 900, 1199 };
+  for (uint16_t nat : nats) {
+    KeepAliveProbe p = fresh();
+    int reconnects;
+    uint16_t got = settleAgainst(p, nat, reconnects);
+    TEST_ASSERT_TRUE(p.settled);
+    TEST_ASSERT_TRUE(got < nat);
+    TEST_ASSERT_EQUAL_UINT16(got, p.tryingS);
+    if (nat - LIMITS.resolutionS > LIMITS.floorS) TEST_ASSERT_TRUE(got + LIMITS.resolutionS >= nat - 1);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(12, (uint32_t)reconnects); // a handful of reconnects, not a sweep
+  }
+}
+
+static void test_probe_stops_at_max() {
+  KeepAliveProbe p = fresh();
+  int reconnects;
+  TEST_ASSERT_EQUAL_UINT16(LIMITS.maxS, settleAgainst(p, 60000, reconnects));
+}
+
+static void test_probe_restarts_when_path_changes() {
+  KeepAliveProbe p = fresh();
+  int reconnects;
+  uint16_t first = settleAgainst(p, 900, reconnects);
+  TEST_ASSERT_TRUE(first >= 840);
+
+  // new router: the settled value now times out
+  keepAliveProbeTimedOut(p, LIMITS);
+  TEST_ASSERT_FALSE(p.settled);
+  TEST_ASSERT_EQUAL_UINT16(first / 2, p.tryingS);
+  uint16_t second = settleAgainst(p, 200, reconnects);
+  TEST_ASSERT_TRUE(second < 200 && second >= 200 - 2 * LIMITS.resolutionS);
+}
+
+static void test_probe_never_goes_below_floor() {
+  KeepAliveProbe p = fresh();
+  int reconnects;
+  TEST_ASSERT_EQUAL_UINT16(LIMITS.floorS, settleAgainst(p, 16, reconnects));
+  keepAliveProbeTimedOut(p, LIMITS);  // even the floor fails: stay there
+  TEST_ASSERT_EQUAL_UINT16(LIMITS.floorS, p.tryingS);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_backoff_doubles_then_caps);
+  RUN_TEST(test_backoff_attempt_saturates_and_resets);
+  RUN_TEST(test_backoff_huge_base_does_not_overflow);
+  RUN_TEST(test_probe_converges_below_nat_timeout);
+  RUN_TEST(test_probe_stops_at_max);
+  RUN_TEST(test_probe_restarts_when_path_changes);
+  RUN_TEST(test_probe_never_goes_below_floor);
+  return UNITY_END();
+}
@@ -0,0 +1,133 @@
+// OTA requests: every field found in any order, and anything overlong, odd or overflowing refused.
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unity.h>
+
+#include "OtaRequest.h"
+
+void setUp() {}
+void tearDown() {}
+
+static const char SHA[] = "00112233445566778899aabbccddeeff00112233445566778899AABBCCDDEEFF";
+
+static std::string request(const std::string& url, const std::string& size, const std::string& sha,
+                           const std::string& sig) {
+  return "url=" + url + " version=3 size=" + size + " sha256=" + sha + " sig=" + sig;
+}
+
+static std::string good() {
+  return request("https://example.com/fw.zz", "912345", SHA, "3045022100ab");
+}
+
+static bool parse(const std::string& msg, OtaRequest& r) {
+  return otaRequestParse(msg.data(), msg.size(), r);
+}
+
+static void test_fields() {
+  OtaRequest r;
+  TEST_ASSERT_TRUE(parse(good(), r));
+  TEST_ASSERT_EQUAL_STRING("https://example.com/fw.zz", r.url);
+  TEST_ASSERT_EQUAL_UINT32(3, r.version);
+  TEST_ASSERT_EQUAL_UINT32(912345, r.size);
+  TEST_ASSERT_EQUAL_HEX8(0x00, r.sha256[0]);
+  TEST_ASSERT_EQUAL_HEX8(0xaa, r.sha256[26]);
+  TEST_ASSERT_EQUAL_HEX8(0xff, r.sha256[31]);
+  TEST_ASSERT_EQUAL_UINT8(6, r.sigLen);
+  TEST_ASSERT_EQUAL_HEX8(0x30, r.sig[0]);
+  TEST_ASSERT_EQUAL_HEX8(0xab, r.sig[5]);
+}
+
+static void test_any_order_and_whitespace() {
+  OtaRequest r;
+  std::string msg = std::string("sig=3045\tsha256=") + SHA + " size=7\r\nurl=https://h/fw.zz version=12\n";
+  TEST_ASSERT_TRUE(parse(msg, r));
+  TEST_ASSERT_EQUAL_STRING("https://h/fw.zz", r.url);
+  TEST_ASSERT_EQUAL_UINT32(12, r.version);
+  TEST_ASSERT_EQUAL_UINT32(7, r.size);
+  TEST_ASSERT_EQUAL_UINT8(2, r.sigLen);
+}
+
+static void test_signed_text() {
+  OtaRequest r;
+  TEST_ASSERT_TRUE(parse(good(), r));
+  char text[OtaRequest::SIGNED_TEXT_MAX];
+  size_t n = otaRequestSignedText(r, text);
+  const char* want = "version=3 size=912345 sha256=00112233445566778899aabbccddeeff00112233445566778899aabbccddeeff";
+  TEST_ASSERT_EQUAL_UINT(strlen(want), n);
+  TEST_ASSERT_EQUAL_STRING(want, text);
+}
+
+static void test_overlong_url() {
+  OtaRequest r;
+  std::string url = "https://h/";
+  url += std::string(OtaRequest::URL_MAX - 1 - url.size(), 'a');
+  TEST_ASSERT_TRUE(parse(request(url, "1", SHA, "30"), r)); // longest that fits with its NUL
+  TEST_ASSERT_EQUAL_UINT(OtaRequest::URL_MAX - 1, strlen(r.url));
+  TEST_ASSERT_FALSE(parse(request(url + "a", "1", SHA, "30"), r));
+  TEST_ASSERT_FALSE(parse(request("http://h/fw.zz", "1", SHA, "30"), r));
+}
+
+static void test_overlong_sig() {
+  OtaRequest r;
+  std::string sig(2 * OtaRequest::SIG_MAX, 'f');
+  TEST_ASSERT_TRUE(parse(request("https://h/", "1", SHA, sig), r));
+  TEST_ASSERT_EQUAL_UINT8(OtaRequest::SIG_MAX, r.sigLen);
+  TEST_ASSERT_FALSE(parse(request("https://h/", "1", SHA, sig + "ff"), r));
+}
+
+static void test_odd_length_hex() {
+  OtaRequest r;
+  TEST_ASSERT_FALSE(parse(request("https://h/", "1", SHA, "304"), r));
+  TEST_ASSERT_FALSE(parse(request("https://h/", "1", std::string(SHA) + "0", "30"), r));
+  TEST_ASSERT_FALSE(parse(request("https://h/", "1", std::string(SHA, 63), "30"), r));
+  TEST_ASSERT_FALSE(parse(request("https://h/", "1", SHA, "3g"), r));
+  TEST_ASSERT_FALSE(parse(request("https://h/", "1", std::string("x") + (SHA + 1), "30"), r));
+}
+
+static void test_size_overflow() {
+  OtaRequest r;
+  TEST_ASSERT_TRUE(parse(request("https://h/", "999999999", SHA, "30"), r));
+  TEST_ASSERT_EQUAL_UINT32(999999999, r.size);
+  TEST_ASSERT_FALSE(parse(request("https://h/", "4294967297", SHA, "30"), r)); // would wrap to 1
+  TEST_ASSERT_FALSE(parse(request("https://h/", "0", SHA, "30"), r));
+  TEST_ASSERT_FALSE(parse(request("https://h/", "", SHA, "30"), r));
+  TEST_ASSERT_FALSE(parse(request("https://h/", "12k", SHA, "30"), r));
+}
+
+static void test_version() {
+  OtaRequest r;
+  std::string tail = std::string(" size=1 sig=30 sha256=") + SHA;
+  TEST_ASSERT_TRUE(parse("url=https://h/ version=999999999" + tail, r));
+  TEST_ASSERT_EQUAL_UINT32(999999999, r.version);
+  TEST_ASSERT_FALSE(parse("url=https://h/ version=4294967297" + tail, r));
+  TEST_ASSERT_FALSE(parse("url=https://h/ version=0" + tail, r));
+  TEST_ASSERT_FALSE(parse("url=https://h/ version=-1" + tail, r));
+}
+
+static void test_missing_or_truncated() {
+  OtaRequest r;
+  // sha256 last: its length is fixed, so any cut leaves it short or missing
+  std::string msg = std::string("sig=3045 url=https://h/fw.zz version=2 size=7 sha256=") + SHA;
+  TEST_ASSERT_TRUE(parse(msg, r));
+  for (size_t len = 0; len < msg.size(); len++) {
+    TEST_ASSERT_FALSE_MESSAGE(otaRequestParse(msg.data(), len, r), "accepted a truncated request");
+  }
+  TEST_ASSERT_FALSE(parse(std::string("url=https://h/ version=1 size=1 sha256=") + SHA, r));
+  TEST_ASSERT_FALSE(parse(std::string("url=https://h/ size=1 sig=30 sha256=") + SHA, r));     // no version
+  TEST_ASSERT_FALSE(parse(std::string("xurl=https://h/ version=1 size=1 sig=30 sha256=") + SHA, r));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_fields);
+  RUN_TEST(test_any_order_and_whitespace);
+  RUN_TEST(test_signed_text);
+  RUN_TEST(test_overlong_url);
+  RUN_TEST(test_overlong_sig);
+  RUN_TEST(test_odd_length_hex);
+  RUN_TEST(test_size_overflow);
+  RUN_TEST(test_version);
+  RUN_TEST(test_missing_or_truncated);
+  return UNITY_END();
+}
@@ -0,0 +1,113 @@
+// Pattern timing: the table, and PatternCursor walking it exactly as the engine's timer does.
+#include <string.h>
+#include <unity.h>
+
+#include "BeepPatterns.h"
+
+void setUp() {}
+void tearDown() {}
+
+struct Played {
+  uint32_t totalMs;
+  uint32_t notes;
+  uint32_t edges;
+  uint32_t longestSilenceMs;
+  bool endsOnNote;   // last edge was a note (the engine then switches the buzzer off itself)
+};
+
+static Played play(const BeepPattern& p) {
+  Played r = {};
+  PatternCursor c;
+  PatternEdge e = patternCursorBegin(c, &p);
+  for (;;) {
+    r.edges++;
+    r.totalMs += e.ms;
+    if (e.on) r.notes++;
+    else if (e.ms > r.longestSilenceMs) r.longestSilenceMs = e.ms;
+    r.endsOnNote = e.on;
+    TEST_ASSERT_TRUE(e.ms > 0);           // a zero-length edge would re-arm the timer for nothing
+    TEST_ASSERT_TRUE(r.edges <= 2u * 255u * 255u);
+    if (!patternCursorAdvance(c, e)) break;
+  }
+  return r;
+}
+
+static void test_cursor_matches_table_duration() {
+  for (uint8_t i = 0; i < PAT_COUNT; i++) {
+    Played r = play(PATTERNS[i]);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(patternDurationMs(PATTERNS[i]), r.totalMs, PATTERNS[i].name);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE((uint32_t)PATTERNS[i].stepCount * PATTERNS[i].repeat, r.notes,
+                                     PATTERNS[i].name);
+  }
+}
+
+static void test_first_edge_is_first_note() {
+  PatternCursor c;
+  PatternEdge e = patternCursorBegin(c, &PATTERNS[PAT_CHIME]);
+  TEST_ASSERT_TRUE(e.on);
+  TEST_ASSERT_EQUAL_UINT16(NOTE_E6, e.freqHz);
+  TEST_ASSERT_EQUAL_UINT16(200, e.ms);
+}
+
+static void test_zero_silence_runs_notes_together() {
+  // alarm: hi/lo with no gap, three times: six notes and no silences at all
+  Played r = play(PATTERNS[PAT_ALARM]);
+  TEST_ASSERT_EQUAL_UINT32(6, r.notes);
+  TEST_ASSERT_EQUAL_UINT32(6, r.edges);
+  TEST_ASSERT_TRUE(r.endsOnNote);
+
+  // coin: the first note slides straight into the second
+  PatternCursor c;
+  PatternEdge e = patternCursorBegin(c, &PATTERNS[PAT_COIN]);
+  TEST_ASSERT_TRUE(patternCursorAdvance(c, e));
+  TEST_ASSERT_TRUE(e.on);
+  TEST_ASSERT_EQUAL_UINT16(NOTE_E6, e.freqHz);
+}
+
+static void test_repeats_include_trailing_silence() {
+  // needs-config: beep 50, quiet 200, three times, then done
+  PatternCursor c;
+  PatternEdge e = patternCursorBegin(c, &PATTERNS[PAT_NEEDS_CONFIG]);
+  for (int i = 0; i < 3; i++) {
+    if (i > 0) TEST_ASSERT_TRUE(patternCursorAdvance(c, e));
+    TEST_ASSERT_TRUE(e.on);
+    TEST_ASSERT_EQUAL_UINT16(50, e.ms);
+    TEST_ASSERT_TRUE(patternCursorAdvance(c, e));
+    TEST_ASSERT_FALSE(e.on);
+    TEST_ASSERT_EQUAL_UINT16(200, e.ms);
+  }
+  TEST_ASSERT_FALSE(patternCursorAdvance(c, e));
+}
+
+static void test_status_sounds_are_tellable_apart() {
+  // the ones people learn by ear differ in note count, not just pitch
+  TEST_ASSERT_EQUAL_UINT32(1, play(PATTERNS[PAT_PING]).notes);
+  TEST_ASSERT_EQUAL_UINT32(2, play(PATTERNS[PAT_RESET]).notes);
+  TEST_ASSERT_EQUAL_UINT32(3, play(PATTERNS[PAT_NEEDS_CONFIG]).notes);
+}
+
+static void test_selectable_names_unique() {
+  for (uint8_t i = 0; i < PAT_COUNT; i++) {
+    TEST_ASSERT_TRUE(PATTERNS[i].name != nullptr && PATTERNS[i].name[0] != '\0');
+    for (uint8_t j = i + 1; j < PAT_COUNT; j++) TEST_ASSERT_TRUE(strcmp(PATTERNS[i].name, PATTERNS[j].name) != 0);
+  }
+}
+
+static void test_melodies_stay_short() {
+  // a remote ping should never hold the buzzer (and the pattern queue) for long
+  for (uint8_t i = 0; i < PAT_COUNT; i++) {
+    if (PATTERNS[i].selectable) TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(1500, patternDurationMs(PATTERNS[i]), PATTERNS[i].name);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_cursor_matches_table_duration);
+  RUN_TEST(test_first_edge_is_first_note);
+  RUN_TEST(test_zero_silence_runs_notes_together);
+  RUN_TEST(test_repeats_include_trailing_silence);
+  RUN_TEST(test_status_sounds_are_tellable_apart);
+  RUN_TEST(test_selectable_names_unique);
+  RUN_TEST(test_melodies_stay_short);
+  return UNITY_END();
+}
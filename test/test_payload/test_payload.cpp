@@ -0,0 +1,135 @@
+// Payload parsing, as mqttCallback() sees it: raw broker bytes, not NUL-terminated.
+#include <string.h>
+#include <unity.h>
+
+#include "Payload.h"
+
+void setUp() {}
+void tearDown() {}
+
+// The bytes of `s` without its terminator, like PubSubClient hands them over
+static bool trigger(const char* s) {
+  return payloadIsTrigger((const uint8_t*)s, strlen(s));
+}
+
+static void test_trigger_words() {
+  TEST_ASSERT_TRUE(trigger("true"));
+  TEST_ASSERT_TRUE(trigger("TRUE"));
+  TEST_ASSERT_TRUE(trigger("  True\r\n"));
+  TEST_ASSERT_TRUE(trigger("true id=42 melody=chime"));
+  TEST_ASSERT_TRUE(trigger("{\"value\":\"true\"}"));
+  TEST_ASSERT_TRUE(trigger("1"));
+  TEST_ASSERT_TRUE(trigger(" 1\n"));
+
+  TEST_ASSERT_FALSE(trigger(""));
+  TEST_ASSERT_FALSE(trigger("false"));
+  TEST_ASSERT_FALSE(trigger("false id=42 rxb=1234 n=1")); // our own ack coming back
+  TEST_ASSERT_FALSE(trigger("tru"));
+  TEST_ASSERT_FALSE(trigger("0"));
+  TEST_ASSERT_FALSE(trigger("10"));
+  TEST_ASSERT_FALSE(trigger("1 1"));
+}
+
+static void test_trigger_stays_in_bounds() {
+  // "true" straddling the end of the payload must not be read past `length`
+  const char buf[] = "xxtrue";
+  TEST_ASSERT_FALSE(payloadIsTrigger((const uint8_t*)buf, 5));
+  TEST_ASSERT_TRUE(payloadIsTrigger((const uint8_t*)buf, 6));
+  TEST_ASSERT_FALSE(payloadIsTrigger((const uint8_t*)"1", 0));
+}
+
+static void test_trigger_id() {
+  const char* s = "true id=42";
+  TEST_ASSERT_EQUAL_UINT32(42, payloadTriggerId((const uint8_t*)s, strlen(s)));
+  s = "true id=4294967295 melody=coin";
+  TEST_ASSERT_EQUAL_UINT32(4294967295u, payloadTriggerId((const uint8_t*)s, strlen(s)));
+  s = "true";
+  TEST_ASSERT_EQUAL_UINT32(0, payloadTriggerId((const uint8_t*)s, strlen(s)));
+  s = "true rid=7";   // only a whole "id=" word counts
+  TEST_ASSERT_EQUAL_UINT32(0, payloadTriggerId((const uint8_t*)s, strlen(s)));
+  s = "true id=";
+  TEST_ASSERT_EQUAL_UINT32(0, payloadTriggerId((const uint8_t*)s, strlen(s)));
+  s = "true id=123";
+  TEST_ASSERT_EQUAL_UINT32(12, payloadTriggerId((const uint8_t*)s, strlen(s) - 1));
+}
+
+static void test_melody() {
+  const char* s = "true melody=chime";
+  TEST_ASSERT_EQUAL(PAT_CHIME, payloadMelody((const uint8_t*)s, strlen(s), PAT_PING));
+  s = "true melody=DoorBell id=3";
+  TEST_ASSERT_EQUAL(PAT_DOORBELL, payloadMelody((const uint8_t*)s, strlen(s), PAT_PING));
+  s = "true melody=kazoo";
+  TEST_ASSERT_EQUAL(PAT_COIN, payloadMelody((const uint8_t*)s, strlen(s), PAT_COIN));
+  s = "true melody=reset";  // status sounds can't be picked remotely
+  TEST_ASSERT_EQUAL(PAT_PING, payloadMelody((const uint8_t*)s, strlen(s), PAT_PING));
+  s = "true melody=chimes";
+  TEST_ASSERT_EQUAL(PAT_PING, payloadMelody((const uint8_t*)s, strlen(s), PAT_PING));
+  s = "true melody=chi";
+  TEST_ASSERT_EQUAL(PAT_PING, payloadMelody((const uint8_t*)s, strlen(s), PAT_PING));
+  s = "true melody=chime";
+  TEST_ASSERT_EQUAL(PAT_PING, payloadMelody((const uint8_t*)s, strlen(s) - 2, PAT_PING));
+}
+
+static void test_pattern_by_name_covers_every_selectable_pattern() {
+  for (uint8_t i = 0; i < PAT_COUNT; i++) {
+    const char* name = PATTERNS[i].name;
+    PatternId want = PATTERNS[i].selectable ? (PatternId)i : PAT_COUNT;
+    TEST_ASSERT_EQUAL(want, patternByName((const uint8_t*)name, strlen(name), PAT_COUNT));
+  }
+}
+
+static void test_target() {
+  uint8_t mac[6] = {};
+  const char* s = "true to=AA:bb:0c:1D:ee:ff";
+  TEST_ASSERT_TRUE(payloadTarget((const uint8_t*)s, strlen(s), mac));
+  const uint8_t want[6] = { 0xaa, 0xbb, 0x0c, 0x1d, 0xee, 0xff };
+  TEST_ASSERT_EQUAL_MEMORY(want, mac, 6);
+
+  s = "true to=aa:bb:cc:dd:ee";  // too short
+  TEST_ASSERT_FALSE(payloadTarget((const uint8_t*)s, strlen(s), mac));
+  s = "true to=aa-bb-cc-dd-ee-ff";
+  TEST_ASSERT_FALSE(payloadTarget((const uint8_t*)s, strlen(s), mac));
+  s = "true to=zz:bb:cc:dd:ee:ff";
+  TEST_ASSERT_FALSE(payloadTarget((const uint8_t*)s, strlen(s), mac));
+  s = "true";
+  TEST_ASSERT_FALSE(payloadTarget((const uint8_t*)s, strlen(s), mac));
+}
+
+static void test_trim_and_number() {
+  const char* s = "  22-7 \r\n";
+  const uint8_t* p = (const uint8_t*)s;
+  unsigned int len = strlen(s);
+  payloadTrim(p, len);
+  TEST_ASSERT_EQUAL_UINT(4, len);
+  TEST_ASSERT_EQUAL(22, payloadNumber(p, len));
+  TEST_ASSERT_EQUAL('-', p[0]);
+  p++;
+  len--;
+  TEST_ASSERT_EQUAL(7, payloadNumber(p, len));
+  TEST_ASSERT_EQUAL_UINT(0, len);
+  TEST_ASSERT_EQUAL(-1, payloadNumber(p, len));
+
+  s = "1234567";  // at most five digits are taken
+  p = (const uint8_t*)s;
+  len = strlen(s);
+  TEST_ASSERT_EQUAL(12345, payloadNumber(p, len));
+  TEST_ASSERT_EQUAL_UINT(2, len);
+
+  s = " \t ";
+  p = (const uint8_t*)s;
+  len = strlen(s);
+  payloadTrim(p, len);
+  TEST_ASSERT_EQUAL_UINT(0, len);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_trigger_words);
+  RUN_TEST(test_trigger_stays_in_bounds);
+  RUN_TEST(test_trigger_id);
+  RUN_TEST(test_melody);
+  RUN_TEST(test_pattern_by_name_covers_every_selectable_pattern);
+  RUN_TEST(test_target);
+  RUN_TEST(test_trim_and_number);
+  return UNITY_END();
+}
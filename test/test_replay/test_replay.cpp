@@ -0,0 +1,103 @@
+// Authenticated messages are accepted once per sender, and a lost mark never reopens old seqs.
+#include <string.h>
+#include <unity.h>
+
+#include "ReplayWindow.h"
+
+void setUp() {}
+void tearDown() {}
+
+static ReplayWindow fresh() {
+  ReplayWindow w;
+  memset(&w, 0xA5, sizeof(w)); // like uninitialised RTC memory
+  replayWindowReset(w);
+  return w;
+}
+
+static void test_replay_is_dropped() {
+  ReplayWindow w = fresh();
+  TEST_ASSERT_TRUE(replayWindowAccept(w, 1, 1000));
+  TEST_ASSERT_FALSE(replayWindowAccept(w, 1, 1000));
+  TEST_ASSERT_FALSE(replayWindowAccept(w, 1, 999));
+  TEST_ASSERT_TRUE(replayWindowAccept(w, 1, 1001));
+}
+
+static void test_senders_have_their_own_marks() {
+  ReplayWindow w = fresh();
+  TEST_ASSERT_TRUE(replayWindowAccept(w, 1, 5000)); // a phone whose clock runs ahead
+  TEST_ASSERT_TRUE(replayWindowAccept(w, 2, 100));  // a laptop behind it
+  TEST_ASSERT_TRUE(replayWindowAccept(w, 2, 101));
+  TEST_ASSERT_FALSE(replayWindowAccept(w, 2, 101));
+  TEST_ASSERT_TRUE(replayWindowAccept(w, 1, 5001));
+  TEST_ASSERT_EQUAL_UINT8(2, w.count);
+}
+
+static void test_pushed_out_sender_stays_stale() {
+  ReplayWindow w = fresh();
+  for (uint32_t s = 0; s < ReplayWindow::SENDERS; s++) TEST_ASSERT_TRUE(replayWindowAccept(w, s, 1000 + s));
+  // a new sender pushes out the lowest mark (sender 0 at 1000), which becomes the floor
+  TEST_ASSERT_TRUE(replayWindowAccept(w, 99, 2000));
+  TEST_ASSERT_EQUAL_UINT8(ReplayWindow::SENDERS, w.count);
+  TEST_ASSERT_EQUAL_UINT64(1000, w.floor);
+  TEST_ASSERT_FALSE(replayWindowAccept(w, 0, 1000)); // its old message again
+  TEST_ASSERT_FALSE(replayWindowAccept(w, 100, 999)); // anyone unknown below the floor
+  TEST_ASSERT_TRUE(replayWindowAccept(w, 0, 3000));
+  // the senders still tracked keep their own marks
+  TEST_ASSERT_FALSE(replayWindowAccept(w, 7, 1007));
+  TEST_ASSERT_TRUE(replayWindowAccept(w, 7, 1008));
+}
+
+// ESP-NOW marks are session:seq, with the session a gateway boot counter
+static uint64_t relayMark(uint32_t session, uint32_t seq) {
+  return ((uint64_t)session << 32) | seq;
+}
+
+static void test_gateway_sessions() {
+  ReplayWindow w = fresh();
+  const uint8_t gw[6] = { 0x24, 0x6f, 0x28, 0x01, 0x02, 0x03 };
+  uint32_t id = replaySenderId((const char*)gw, sizeof(gw));
+  TEST_ASSERT_TRUE(replayWindowAccept(w, id, relayMark(7, 1)));
+  TEST_ASSERT_FALSE(replayWindowAccept(w, id, relayMark(7, 1)));     // a repeat
+  TEST_ASSERT_TRUE(replayWindowAccept(w, id, relayMark(7, 2)));
+  TEST_ASSERT_TRUE(replayWindowAccept(w, id, relayMark(8, 1)));      // the gateway rebooted
+  TEST_ASSERT_FALSE(replayWindowAccept(w, id, relayMark(7, 3)));     // recorded before that
+  TEST_ASSERT_FALSE(replayWindowAccept(w, id, relayMark(6, 0xFFFFFFFFu)));
+}
+
+static void test_survives_a_copy() {
+  // stands in for the RTC/NVS round trip: plain bytes, no pointers
+  ReplayWindow w = fresh();
+  replayWindowAccept(w, replaySenderId("phone", 5), 42);
+  ReplayWindow kept;
+  memcpy(&kept, &w, sizeof(w));
+  TEST_ASSERT_TRUE(replayWindowValid(kept));
+  TEST_ASSERT_FALSE(replayWindowAccept(kept, replaySenderId("phone", 5), 42));
+  TEST_ASSERT_TRUE(replayWindowAccept(kept, replaySenderId("laptop", 6), 42));
+}
+
+static void test_garbage_is_not_valid() {
+  ReplayWindow w;
+  memset(&w, 0, sizeof(w));
+  TEST_ASSERT_FALSE(replayWindowValid(w));
+  w = fresh();
+  w.count = ReplayWindow::SENDERS + 1;
+  TEST_ASSERT_FALSE(replayWindowValid(w));
+}
+
+static void test_sender_ids() {
+  TEST_ASSERT_TRUE(replaySenderId("a", 1) != replaySenderId("b", 1));
+  TEST_ASSERT_EQUAL_UINT32(replaySenderId("phone", 5), replaySenderId("phone!", 5));
+  TEST_ASSERT_EQUAL_UINT32(2166136261u, replaySenderId("", 0));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_replay_is_dropped);
+  RUN_TEST(test_senders_have_their_own_marks);
+  RUN_TEST(test_pushed_out_sender_stays_stale);
+  RUN_TEST(test_gateway_sessions);
+  RUN_TEST(test_survives_a_copy);
+  RUN_TEST(test_garbage_is_not_valid);
+  RUN_TEST(test_sender_ids);
+  return UNITY_END();
+}
@@ -0,0 +1,124 @@
+// The portal's scan cache: ordering, dedupe, and JSON that survives any SSID.
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#include "ScanList.h"
+
+void setUp() {}
+void tearDown() {}
+
+static void test_strongest_first_one_per_name() {
+  ScanList l = {};
+  scanListAdd(l, "b", -70, 1, false);
+  scanListAdd(l, "a", -50, 6, false);
+  scanListAdd(l, "c", -90, 11, true);
+  scanListAdd(l, "b", -40, 11, false);  // the mesh node next door
+  scanListAdd(l, "a", -80, 1, false);   // weaker twin: ignored
+  scanListAdd(l, "", -30, 3, false);    // hidden
+  TEST_ASSERT_EQUAL_UINT8(3, l.count);
+  TEST_ASSERT_EQUAL_STRING("b", l.entries[0].ssid);
+  TEST_ASSERT_EQUAL(-40, l.entries[0].rssi);
+  TEST_ASSERT_EQUAL_UINT8(11, l.entries[0].channel);
+  TEST_ASSERT_EQUAL_STRING("a", l.entries[1].ssid);
+  TEST_ASSERT_EQUAL_UINT8(6, l.entries[1].channel);
+  TEST_ASSERT_EQUAL_STRING("c", l.entries[2].ssid);
+  TEST_ASSERT_TRUE(l.entries[2].open);
+
+  TEST_ASSERT_TRUE(scanListFind(l, "a") == &l.entries[1]);
+  TEST_ASSERT_TRUE(scanListFind(l, "A") == nullptr);
+}
+
+static void test_full_list_keeps_the_strongest() {
+  ScanList l = {};
+  char name[8];
+  for (int i = 0; i < 40; i++) {
+    snprintf(name, sizeof(name), "n%d", i);
+    scanListAdd(l, name, (int8_t)(-100 + i), 1, false);
+  }
+  TEST_ASSERT_EQUAL_UINT8(ScanList::MAX, l.count);
+  TEST_ASSERT_EQUAL_STRING("n39", l.entries[0].ssid);
+  TEST_ASSERT_EQUAL(-100 + 40 - ScanList::MAX, l.entries[ScanList::MAX - 1].rssi);
+  for (uint8_t i = 1; i < l.count; i++) TEST_ASSERT_TRUE(l.entries[i - 1].rssi >= l.entries[i].rssi);
+}
+
+static void test_long_ssid_is_kept_whole() {
+  ScanList l = {};
+  const char* longest = "0123456789abcdef0123456789abcdef"; // 32 bytes, the 802.11 maximum
+  scanListAdd(l, longest, -60, 1, false);
+  TEST_ASSERT_EQUAL_STRING(longest, l.entries[0].ssid);
+}
+
+static void test_json_shape() {
+  ScanList l = {};
+  scanListAdd(l, "home", -48, 6, false);
+  scanListAdd(l, "cafe", -81, 1, true);
+  char out[256];
+  size_t n = scanListJson(l, out, sizeof(out));
+  const char* want = "[{\"ssid\":\"home\",\"rssi\":-48,\"ch\":6,\"open\":false},"
+                     "{\"ssid\":\"cafe\",\"rssi\":-81,\"ch\":1,\"open\":true}]";
+  TEST_ASSERT_EQUAL_STRING(want, out);
+  TEST_ASSERT_EQUAL_UINT(strlen(want), n);
+
+  ScanList empty = {};
+  TEST_ASSERT_EQUAL_UINT(2, scanListJson(empty, out, sizeof(out)));
+  TEST_ASSERT_EQUAL_STRING("[]", out);
+}
+
+static void test_json_escapes_hostile_names() {
+  ScanList l = {};
+  scanListAdd(l, "a\"b\\c\n\x01", -50, 1, false);
+  char out[128];
+  scanListJson(l, out, sizeof(out));
+  TEST_ASSERT_EQUAL_STRING("[{\"ssid\":\"a\\\"b\\\\c\\u000a\\u0001\",\"rssi\":-50,\"ch\":1,\"open\":false}]", out);
+}
+
+static void test_json_truncates_to_whole_entries() {
+  ScanList l = {};
+  scanListAdd(l, "first", -40, 1, false);
+  scanListAdd(l, "second", -50, 1, false);
+  char full[256];
+  size_t fullLen = scanListJson(l, full, sizeof(full));
+  for (size_t size = 3; size <= fullLen + 1; size++) {
+    char out[256];
+    memset(out, '#', sizeof(out));
+    size_t n = scanListJson(l, out, size);
+    TEST_ASSERT_TRUE(n < size);
+    TEST_ASSERT_EQUAL('\0', out[n]);
+    TEST_ASSERT_EQUAL('#', out[size]);  // nothing written past the buffer
+    TEST_ASSERT_EQUAL('[', out[0]);
+    TEST_ASSERT_EQUAL(']', out[n - 1]);
+    // either no entries, or complete ones
+    TEST_ASSERT_TRUE(n == 2 || out[n - 2] == '}');
+  }
+}
+
+static void test_rank_saved_networks() {
+  ScanList l = {};
+  scanListAdd(l, "cafe", -40, 1, true);
+  scanListAdd(l, "office", -75, 6, false);
+  scanListAdd(l, "home", -55, 11, false);
+  const char* saved[] = { "home", "hidden", "office", "moved-out" };
+  uint8_t order[4];
+  TEST_ASSERT_EQUAL_UINT8(2, scanListRank(l, saved, 4, order));
+  TEST_ASSERT_EQUAL_UINT8(0, order[0]);  // home, -55
+  TEST_ASSERT_EQUAL_UINT8(2, order[1]);  // office, -75
+  TEST_ASSERT_EQUAL_UINT8(1, order[2]);  // not seen: as saved
+  TEST_ASSERT_EQUAL_UINT8(3, order[3]);
+
+  ScanList empty = {};
+  TEST_ASSERT_EQUAL_UINT8(0, scanListRank(empty, saved, 4, order));
+  for (uint8_t i = 0; i < 4; i++) TEST_ASSERT_EQUAL_UINT8(i, order[i]);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_strongest_first_one_per_name);
+  RUN_TEST(test_full_list_keeps_the_strongest);
+  RUN_TEST(test_long_ssid_is_kept_whole);
+  RUN_TEST(test_json_shape);
+  RUN_TEST(test_json_escapes_hostile_names);
+  RUN_TEST(test_json_truncates_to_whole_entries);
+  RUN_TEST(test_rank_saved_networks);
+  return UNITY_END();
+}
@@ -0,0 +1,111 @@
+// The diagnostics summary is whole JSON at any value width and any buffer size, or nothing.
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#include "TelemetrySummary.h"
+
+void setUp() {}
+void tearDown() {}
+
+static const char* const NAMES[] = { "assoc", "dhcp", "tls", "conn", "sub", "rxb_us", "rtt", "boot" };
+static const size_t DEVICE_BUFFER = 384; // TELEMETRY_SUMMARY_MAX in main.cpp
+
+static TelemetrySummary widest() {
+  TelemetrySummary s = {};
+  s.upS = s.heapFree = s.heapMinFree = s.heapLargest = 0xFFFFFFFFu;
+  s.wifiReconnects = s.mqttReconnects = s.triggers = s.duplicates = 0xFFFFFFFFu;
+  for (uint8_t i = 0; i < TelemetrySummary::MAX_METRICS; i++) {
+    s.metrics[i] = { NAMES[i], 0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu, 255 };
+  }
+  s.metricCount = TelemetrySummary::MAX_METRICS;
+  return s;
+}
+
+// Balanced, closed, and nothing after the closing brace
+static void assertWholeJson(const char* out, size_t n) {
+  TEST_ASSERT_EQUAL_UINT(strlen(out), n);
+  TEST_ASSERT_EQUAL('{', out[0]);
+  TEST_ASSERT_EQUAL('}', out[n - 1]);
+  int depth = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (out[i] == '{' || out[i] == '[') depth++;
+    if (out[i] == '}' || out[i] == ']') depth--;
+    TEST_ASSERT_TRUE(depth >= 0);
+    if (depth == 0) TEST_ASSERT_EQUAL_UINT(n - 1, i);
+  }
+  TEST_ASSERT_EQUAL(0, depth);
+}
+
+static void test_shape() {
+  TelemetrySummary s = {};
+  s.upS = 812;
+  s.heapFree = 182340;
+  s.heapMinFree = 170112;
+  s.heapLargest = 110580;
+  s.mqttReconnects = 2;
+  s.triggers = 14;
+  s.metrics[0] = { "rxb_us", 1830, 2210, 4100, 4100, 14 };
+  s.metricCount = 1;
+  char out[DEVICE_BUFFER];
+  size_t n = telemetrySummaryJson(s, out, sizeof(out));
+  TEST_ASSERT_EQUAL_STRING("{\"up\":812,\"heap\":[182340,170112,110580],\"rc\":[0,2],\"trig\":14,\"dup\":0,"
+                           "\"rxb_us\":[1830,2210,4100,4100,14]}", out);
+  TEST_ASSERT_EQUAL_UINT(strlen(out), n);
+}
+
+static void test_widest_values_fit_the_device_buffer_as_whole_json() {
+  TelemetrySummary s = widest();
+  char out[DEVICE_BUFFER];
+  size_t n = telemetrySummaryJson(s, out, sizeof(out));
+  TEST_ASSERT_TRUE(n > 0);
+  TEST_ASSERT_TRUE(n < sizeof(out));
+  assertWholeJson(out, n);
+  TEST_ASSERT_NOT_NULL(strstr(out, ",\"cut\":")); // not all eight metrics fit at this width
+  TEST_ASSERT_NOT_NULL(strstr(out, "\"assoc\":[4294967295,4294967295,4294967295,4294967295,255]"));
+}
+
+static void test_nothing_cut_when_there_is_room() {
+  TelemetrySummary s = widest();
+  char out[1024];
+  size_t n = telemetrySummaryJson(s, out, sizeof(out));
+  assertWholeJson(out, n);
+  TEST_ASSERT_NULL(strstr(out, "cut"));
+  TEST_ASSERT_NOT_NULL(strstr(out, "\"boot\":["));
+}
+
+static void test_every_buffer_size() {
+  TelemetrySummary s = widest();
+  char full[1024];
+  size_t fullLen = telemetrySummaryJson(s, full, sizeof(full));
+  for (size_t size = 1; size <= fullLen + 1; size++) {
+    char out[1024];
+    memset(out, '#', sizeof(out));
+    size_t n = telemetrySummaryJson(s, out, size);
+    TEST_ASSERT_EQUAL('#', out[size]); // nothing written past the buffer
+    if (n == 0) {
+      TEST_ASSERT_EQUAL('\0', out[0]);
+      continue;
+    }
+    TEST_ASSERT_TRUE(n < size);
+    assertWholeJson(out, n);
+  }
+}
+
+static void test_too_small_for_the_fixed_fields() {
+  TelemetrySummary s = widest();
+  char out[64];
+  TEST_ASSERT_EQUAL_UINT(0, telemetrySummaryJson(s, out, sizeof(out)));
+  TEST_ASSERT_EQUAL_STRING("", out);
+  TEST_ASSERT_EQUAL_UINT(0, telemetrySummaryJson(s, out, 0));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_shape);
+  RUN_TEST(test_widest_values_fit_the_device_buffer_as_whole_json);
+  RUN_TEST(test_nothing_cut_when_there_is_room);
+  RUN_TEST(test_every_buffer_size);
+  RUN_TEST(test_too_small_for_the_fixed_fields);
+  return UNITY_END();
+}